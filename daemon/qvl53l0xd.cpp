@@ -0,0 +1,197 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QSensorManager>
+#include <QSensorBackendFactory>
+#include <QSocketNotifier>
+#include <QDebug>
+
+#include "csignal"
+#include "unistd.h"
+#include "sys/signalfd.h"
+
+#include "qvl53l0x.h"
+#include "qvl53l0xbackend.h"
+#include "qvl53l0xdiscovery.h"
+#include "qvl53l0xserver.h"
+#include "qvl53l0xmetricsexporter.h"
+
+// Owns the VL53L0X sensors of the device and serves their samples to other
+// processes over a Unix domain socket, see QVL53L0XSocketBackend.
+//
+// qvl53l0xd [--socket path] [--rate hz] [--cache file] [--scan first-last] [--sensor bus,address[,rate]]...
+//           [--metrics-socket path] [--metrics-file file]
+//
+// Without --sensor every sensor discovery finds is served. The metrics of the
+// sensors are exported when either metrics option is given
+
+// the plugin is not loaded by the daemon, the hardware backend is registered
+// directly
+class BackendFactory : public QSensorBackendFactory
+{
+public:
+    QSensorBackend *createBackend(QSensor *sensor) override
+    {
+        if (sensor->identifier() == QVL53L0XBackend::id)
+            return new QVL53L0XBackend(sensor);
+
+        return 0;
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    // blocked before any thread is started, so the bus threads inherit the
+    // mask and the signals are only taken through the signalfd
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, nullptr);
+
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qvl53l0xd");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Serves VL53L0X samples over a Unix domain socket");
+    parser.addHelpOption();
+
+    QCommandLineOption socketOption("socket", "Path of the socket.", "path", QVL53L0XSocket::defaultPath);
+    QCommandLineOption sensorOption("sensor", "Sensor to serve, repeatable. 7 bit address, e.g. 0x29.", "bus,address[,rate]");
+    QCommandLineOption rateOption("rate", "Data rate of the sensors without one, in Hz.", "hz", "30");
+    QCommandLineOption cacheOption("cache", "Discovery cache file.", "file");
+    QCommandLineOption scanOption("scan", "7 bit addresses discovery scans.", "first-last", "0x08-0x6f");
+    QCommandLineOption metricsSocketOption("metrics-socket", "Serves Prometheus metrics on this socket.", "path");
+    QCommandLineOption metricsFileOption("metrics-file", "Writes Prometheus metrics to this file.", "file");
+
+    parser.addOption(socketOption);
+    parser.addOption(sensorOption);
+    parser.addOption(rateOption);
+    parser.addOption(cacheOption);
+    parser.addOption(scanOption);
+    parser.addOption(metricsSocketOption);
+    parser.addOption(metricsFileOption);
+    parser.process(app);
+
+    BackendFactory factory;
+
+    if(!QSensorManager::isBackendRegistered(QVL53L0X::sensorType, QVL53L0XBackend::id))
+        QSensorManager::registerBackend(QVL53L0X::sensorType, QVL53L0XBackend::id, &factory);
+
+    struct Sensor
+    {
+        QString bus;
+        quint8 address = 0;
+        int dataRate = 0;
+    };
+
+    QList<Sensor> sensors;
+    bool ok = false;
+    int rate = parser.value(rateOption).toInt(&ok);
+
+    if(!ok || rate <= 0)
+    {
+        qCritical() << "invalid rate" << parser.value(rateOption);
+        return 1;
+    }
+
+    for(const QString &value : parser.values(sensorOption))
+    {
+        QStringList fields = value.split(',');
+        Sensor sensor;
+        sensor.bus = fields.value(0).trimmed();
+        sensor.address = static_cast<quint8>(fields.value(1).trimmed().toUInt(&ok, 0));
+        sensor.dataRate = fields.count() > 2 ? fields.value(2).trimmed().toInt() : rate;
+
+        if(sensor.bus.isEmpty() || !ok || fields.count() > 3 || sensor.dataRate <= 0)
+        {
+            qCritical() << "invalid sensor" << value;
+            return 1;
+        }
+
+        sensors.append(sensor);
+    }
+
+    if(sensors.isEmpty())
+    {
+        QVL53L0XDiscovery discovery;
+
+        if(parser.isSet(cacheOption))
+            discovery.setCacheFile(parser.value(cacheOption));
+
+        QStringList range = parser.value(scanOption).split('-');
+        bool lastOk = false;
+        uint first = range.value(0).trimmed().toUInt(&ok, 0);
+        uint last = range.value(1).trimmed().toUInt(&lastOk, 0);
+
+        if(range.count() != 2 || !ok || !lastOk || first > last || last > QVL53L0XDiscovery::maxAddress)
+        {
+            qCritical() << "invalid scan range" << parser.value(scanOption);
+            return 1;
+        }
+
+        discovery.setScanRange(static_cast<quint8>(first), static_cast<quint8>(last));
+
+        for(const QVL53L0XDiscovery::Device &device : discovery.discover())
+        {
+            Sensor sensor;
+            sensor.bus = device.bus;
+            sensor.address = device.address;
+            sensor.dataRate = rate;
+            sensors.append(sensor);
+        }
+    }
+
+    if(sensors.isEmpty())
+    {
+        qCritical() << "no sensors found";
+        return 1;
+    }
+
+    QVL53L0XServer server;
+    QVL53L0XMetricsExporter exporter;
+
+    for(const Sensor &sensor : sensors)
+    {
+        QVL53L0X *vl53l0x = new QVL53L0X(&app);
+        vl53l0x->setIdentifier(QVL53L0XBackend::id);
+        vl53l0x->setBus(sensor.bus);
+        vl53l0x->setAddress(sensor.address);
+
+        if(!vl53l0x->connectToBackend())
+        {
+            qCritical() << "could not connect to the backend";
+            return 1;
+        }
+
+        vl53l0x->setDataRate(sensor.dataRate);
+
+        QObject::connect(vl53l0x, &QVL53L0X::initializationFinished, [sensor](bool success)
+        {
+            if(!success)
+                qCritical() << "could not start the sensor at" << sensor.bus << Qt::hex << static_cast<int>(sensor.address);
+        });
+
+        server.addSensor(vl53l0x);
+        exporter.addSensor(vl53l0x);
+        vl53l0x->start();
+    }
+
+    if(!server.listen(parser.value(socketOption)))
+        return 1;
+
+    if(parser.isSet(metricsSocketOption) && !exporter.listen(parser.value(metricsSocketOption)))
+        return 1;
+
+    if(parser.isSet(metricsFileOption))
+        exporter.setFile(parser.value(metricsFileOption));
+
+    // the socket is removed by the server on the way out
+    int signalFd = signalfd(-1, &shutdownSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    QSocketNotifier signalNotifier(signalFd, QSocketNotifier::Read);
+    QObject::connect(&signalNotifier, &QSocketNotifier::activated, &app, &QCoreApplication::quit);
+
+    int result = app.exec();
+    ::close(signalFd);
+
+    return result;
+}
@@ -1,5 +1,6 @@
 #include "qvl53l0x.h"
 #include "qvl53l0x_p.h"
+#include "qvl53l0xbackend.h"
 
 IMPLEMENT_READING(QVL53L0XReading)
 
@@ -37,3 +38,531 @@ void QVL53L0X::setAddress(quint8 address)
     m_address = address;
     emit addressChanged();
 }
+
+bool QVL53L0X::longRange() const
+{
+    return m_longRange;
+}
+
+void QVL53L0X::setLongRange(bool longRange)
+{
+    if (m_longRange == longRange)
+        return;
+
+    m_longRange = longRange;
+    emit longRangeChanged();
+}
+
+bool QVL53L0X::fractionalRanging() const
+{
+    return m_fractionalRanging;
+}
+
+void QVL53L0X::setFractionalRanging(bool fractionalRanging)
+{
+    if (m_fractionalRanging == fractionalRanging)
+        return;
+
+    m_fractionalRanging = fractionalRanging;
+    emit fractionalRangingChanged();
+}
+
+QString QVL53L0X::captureFile() const
+{
+    return m_captureFile;
+}
+
+void QVL53L0X::setCaptureFile(const QString &captureFile)
+{
+    if (m_captureFile == captureFile)
+        return;
+
+    m_captureFile = captureFile;
+    emit captureFileChanged();
+}
+
+QString QVL53L0X::replayFile() const
+{
+    return m_replayFile;
+}
+
+void QVL53L0X::setReplayFile(const QString &replayFile)
+{
+    if (m_replayFile == replayFile)
+        return;
+
+    m_replayFile = replayFile;
+    emit replayFileChanged();
+}
+
+qreal QVL53L0X::replaySpeed() const
+{
+    return m_replaySpeed;
+}
+
+void QVL53L0X::setReplaySpeed(qreal replaySpeed)
+{
+    if (qFuzzyCompare(m_replaySpeed, replaySpeed) || replaySpeed < 0)
+        return;
+
+    m_replaySpeed = replaySpeed;
+    emit replaySpeedChanged();
+}
+
+QString QVL53L0X::sharedMemoryName() const
+{
+    return m_sharedMemoryName;
+}
+
+void QVL53L0X::setSharedMemoryName(const QString &sharedMemoryName)
+{
+    if (m_sharedMemoryName == sharedMemoryName)
+        return;
+
+    m_sharedMemoryName = sharedMemoryName;
+    emit sharedMemoryNameChanged();
+}
+
+bool QVL53L0X::oversampling() const
+{
+    return m_oversampling;
+}
+
+void QVL53L0X::setOversampling(bool oversampling)
+{
+    if (m_oversampling == oversampling)
+        return;
+
+    m_oversampling = oversampling;
+    emit oversamplingChanged();
+}
+
+int QVL53L0X::calibrationInterval() const
+{
+    return m_calibrationInterval;
+}
+
+void QVL53L0X::setCalibrationInterval(int calibrationInterval)
+{
+    if (m_calibrationInterval == calibrationInterval || calibrationInterval < 0)
+        return;
+
+    m_calibrationInterval = calibrationInterval;
+    emit calibrationIntervalChanged();
+}
+
+QDateTime QVL53L0X::lastCalibration() const
+{
+    return m_lastCalibration;
+}
+
+void QVL53L0X::setLastCalibration(const QDateTime &lastCalibration)
+{
+    if (m_lastCalibration == lastCalibration)
+        return;
+
+    m_lastCalibration = lastCalibration;
+    emit lastCalibrationChanged();
+}
+
+// recalibrates VHV and phase between the next measurements,
+// e.g. when the temperature has changed by more than 8C
+void QVL53L0X::calibrate()
+{
+    emit calibrationRequested();
+}
+
+qreal QVL53L0X::deadband() const
+{
+    return m_deadband;
+}
+
+void QVL53L0X::setDeadband(qreal deadband)
+{
+    if (qFuzzyCompare(m_deadband, deadband) || deadband < 0)
+        return;
+
+    m_deadband = deadband;
+    emit deadbandChanged();
+}
+
+int QVL53L0X::heartbeat() const
+{
+    return m_heartbeat;
+}
+
+void QVL53L0X::setHeartbeat(int heartbeat)
+{
+    if (m_heartbeat == heartbeat || heartbeat < 0)
+        return;
+
+    m_heartbeat = heartbeat;
+    emit heartbeatChanged();
+}
+
+int QVL53L0X::realtimePriority() const
+{
+    return m_realtimePriority;
+}
+
+void QVL53L0X::setRealtimePriority(int realtimePriority)
+{
+    if (m_realtimePriority == realtimePriority || realtimePriority < 0 || realtimePriority > 99)
+        return;
+
+    m_realtimePriority = realtimePriority;
+    emit realtimePriorityChanged();
+}
+
+QList<int> QVL53L0X::cpuAffinity() const
+{
+    return m_cpuAffinity;
+}
+
+void QVL53L0X::setCpuAffinity(const QList<int> &cpuAffinity)
+{
+    if (m_cpuAffinity == cpuAffinity)
+        return;
+
+    m_cpuAffinity = cpuAffinity;
+    emit cpuAffinityChanged();
+}
+
+bool QVL53L0X::lockMemory() const
+{
+    return m_lockMemory;
+}
+
+void QVL53L0X::setLockMemory(bool lockMemory)
+{
+    if (m_lockMemory == lockMemory)
+        return;
+
+    m_lockMemory = lockMemory;
+    emit lockMemoryChanged();
+}
+
+bool QVL53L0X::lowPower() const
+{
+    return m_lowPower;
+}
+
+void QVL53L0X::setLowPower(bool lowPower)
+{
+    if (m_lowPower == lowPower)
+        return;
+
+    m_lowPower = lowPower;
+    emit lowPowerChanged();
+}
+
+qreal QVL53L0X::sigmaLimit() const
+{
+    return m_sigmaLimit;
+}
+
+void QVL53L0X::setSigmaLimit(qreal sigmaLimit)
+{
+    if (qFuzzyCompare(m_sigmaLimit, sigmaLimit) || sigmaLimit < 0)
+        return;
+
+    m_sigmaLimit = sigmaLimit;
+    emit sigmaLimitChanged();
+}
+
+qreal QVL53L0X::signalRateLimit() const
+{
+    return m_signalRateLimit;
+}
+
+// Q9.7 on the device
+void QVL53L0X::setSignalRateLimit(qreal signalRateLimit)
+{
+    if (qFuzzyCompare(m_signalRateLimit, signalRateLimit) || signalRateLimit < 0 || signalRateLimit > 511.99)
+        return;
+
+    m_signalRateLimit = signalRateLimit;
+    emit signalRateLimitChanged();
+}
+
+bool QVL53L0X::rejectInvalidRanges() const
+{
+    return m_rejectInvalidRanges;
+}
+
+void QVL53L0X::setRejectInvalidRanges(bool rejectInvalidRanges)
+{
+    if (m_rejectInvalidRanges == rejectInvalidRanges)
+        return;
+
+    m_rejectInvalidRanges = rejectInvalidRanges;
+    emit rejectInvalidRangesChanged();
+}
+
+int QVL53L0X::i2cTimeout() const
+{
+    return m_i2cTimeout;
+}
+
+void QVL53L0X::setI2cTimeout(int i2cTimeout)
+{
+    if (m_i2cTimeout == i2cTimeout || i2cTimeout < 0)
+        return;
+
+    m_i2cTimeout = i2cTimeout;
+    emit i2cTimeoutChanged();
+}
+
+int QVL53L0X::i2cRetries() const
+{
+    return m_i2cRetries;
+}
+
+void QVL53L0X::setI2cRetries(int i2cRetries)
+{
+    if (m_i2cRetries == i2cRetries || i2cRetries < -1)
+        return;
+
+    m_i2cRetries = i2cRetries;
+    emit i2cRetriesChanged();
+}
+
+int QVL53L0X::busSpeed() const
+{
+    return m_busSpeed;
+}
+
+void QVL53L0X::setBusSpeed(int busSpeed)
+{
+    if (m_busSpeed == busSpeed || busSpeed < 0)
+        return;
+
+    m_busSpeed = busSpeed;
+    emit busSpeedChanged();
+}
+
+// above 1 the bus can't carry the data rates of its sensors
+qreal QVL53L0X::busOccupancy() const
+{
+    return m_busOccupancy;
+}
+
+int QVL53L0X::historySize() const
+{
+    return m_historySize;
+}
+
+// changing the size drops the samples kept so far
+void QVL53L0X::setHistorySize(int historySize)
+{
+    if (m_historySize == historySize || historySize < 0)
+        return;
+
+    m_historySize = historySize;
+    emit historySizeChanged();
+}
+
+bool QVL53L0X::adaptiveRate() const
+{
+    return m_adaptiveRate;
+}
+
+void QVL53L0X::setAdaptiveRate(bool adaptiveRate)
+{
+    if (m_adaptiveRate == adaptiveRate)
+        return;
+
+    m_adaptiveRate = adaptiveRate;
+    emit adaptiveRateChanged();
+}
+
+int QVL53L0X::minimumDataRate() const
+{
+    return m_minimumDataRate;
+}
+
+void QVL53L0X::setMinimumDataRate(int minimumDataRate)
+{
+    if (m_minimumDataRate == minimumDataRate || minimumDataRate < 1)
+        return;
+
+    m_minimumDataRate = minimumDataRate;
+    emit minimumDataRateChanged();
+}
+
+int QVL53L0X::maximumDataRate() const
+{
+    return m_maximumDataRate;
+}
+
+void QVL53L0X::setMaximumDataRate(int maximumDataRate)
+{
+    if (m_maximumDataRate == maximumDataRate || maximumDataRate < 1)
+        return;
+
+    m_maximumDataRate = maximumDataRate;
+    emit maximumDataRateChanged();
+}
+
+qreal QVL53L0X::motionThreshold() const
+{
+    return m_motionThreshold;
+}
+
+void QVL53L0X::setMotionThreshold(qreal motionThreshold)
+{
+    if (qFuzzyCompare(m_motionThreshold, motionThreshold) || motionThreshold <= 0)
+        return;
+
+    m_motionThreshold = motionThreshold;
+    emit motionThresholdChanged();
+}
+
+bool QVL53L0X::kinematics() const
+{
+    return m_kinematics;
+}
+
+void QVL53L0X::setKinematics(bool kinematics)
+{
+    if (m_kinematics == kinematics)
+        return;
+
+    m_kinematics = kinematics;
+    emit kinematicsChanged();
+}
+
+int QVL53L0X::kinematicsWindow() const
+{
+    return m_kinematicsWindow;
+}
+
+void QVL53L0X::setKinematicsWindow(int kinematicsWindow)
+{
+    if (m_kinematicsWindow == kinematicsWindow || kinematicsWindow < 2)
+        return;
+
+    m_kinematicsWindow = kinematicsWindow;
+    emit kinematicsWindowChanged();
+}
+
+qreal QVL53L0X::approachThreshold() const
+{
+    return m_approachThreshold;
+}
+
+void QVL53L0X::setApproachThreshold(qreal approachThreshold)
+{
+    if (qFuzzyCompare(m_approachThreshold, approachThreshold) || approachThreshold <= 0)
+        return;
+
+    m_approachThreshold = approachThreshold;
+    emit approachThresholdChanged();
+}
+
+QVL53L0X::Motion QVL53L0X::motion() const
+{
+    return m_motion;
+}
+
+QString QVL53L0X::tuningFile() const
+{
+    return m_tuningFile;
+}
+
+void QVL53L0X::setTuningFile(const QString &tuningFile)
+{
+    if (m_tuningFile == tuningFile)
+        return;
+
+    m_tuningFile = tuningFile;
+    emit tuningFileChanged();
+}
+
+QString QVL53L0X::tuningProfile() const
+{
+    return m_tuningProfile;
+}
+
+void QVL53L0X::setTuningProfile(const QString &tuningProfile)
+{
+    if (m_tuningProfile == tuningProfile)
+        return;
+
+    m_tuningProfile = tuningProfile;
+    emit tuningProfileChanged();
+}
+
+QString QVL53L0X::socketPath() const
+{
+    return m_socketPath;
+}
+
+void QVL53L0X::setSocketPath(const QString &socketPath)
+{
+    if (m_socketPath == socketPath)
+        return;
+
+    m_socketPath = socketPath;
+    emit socketPathChanged();
+}
+
+int QVL53L0X::batchInterval() const
+{
+    return m_batchInterval;
+}
+
+void QVL53L0X::setBatchInterval(int batchInterval)
+{
+    if (m_batchInterval == batchInterval || batchInterval < 0)
+        return;
+
+    m_batchInterval = batchInterval;
+    emit batchIntervalChanged();
+}
+
+// Copies the latest samples into buffer in one go, oldest first, and returns
+// how many were copied. With a cursor the copy starts after the samples
+// returned by the previous call and the cursor is advanced, samples the
+// history has dropped in between are skipped. Sensor thread only
+qsizetype QVL53L0X::samples(QVL53L0XSample *buffer, qsizetype count, quint64 *cursor) const
+{
+    if(!m_backend)
+        return 0;
+
+    return m_backend->copySamples(buffer, count, cursor);
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+qsizetype QVL53L0X::samples(QSpan<QVL53L0XSample> buffer, quint64 *cursor) const
+{
+    return samples(buffer.data(), buffer.size(), cursor);
+}
+#endif
+
+// counters of the hardware backend for monitoring, nullptr without one
+const QVL53L0XMetrics *QVL53L0X::metrics() const
+{
+    if(!m_backend)
+        return nullptr;
+
+    return &m_backend->metrics();
+}
+
+void QVL53L0X::setBusOccupancy(qreal busOccupancy)
+{
+    if (qFuzzyCompare(m_busOccupancy, busOccupancy))
+        return;
+
+    m_busOccupancy = busOccupancy;
+    emit busOccupancyChanged();
+}
+
+void QVL53L0X::setMotion(Motion motion)
+{
+    if (m_motion == motion)
+        return;
+
+    m_motion = motion;
+    emit motionChanged(m_motion);
+}
@@ -4,18 +4,39 @@
 #include <QObject>
 #include <QSensor>
 #include <QString>
+#include <QDateTime>
+#include <QList>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+#include <QSpan>
+#endif
 
 #include "qvl53l0x_global.h"
 #include "qvl53l0xreading.h"
+#include "qvl53l0xsample.h"
 
 QT_BEGIN_NAMESPACE
 
+class QVL53L0XBackend;
+class QVL53L0XMetrics;
+
 class QVL53L_X_EXPORT QVL53L0X : public QSensor
 {
     Q_OBJECT
+    friend class QVL53L0XBackend;
+    friend class QVL53L0XGroup;
 public:
     static inline char const * const sensorType = "QVL53L0X";
 
+    // direction of the target, from the kinematics velocity and approachThreshold
+    enum Motion
+    {
+        Stationary = 0,
+        Approaching = 1,
+        Retreating = 2
+    };
+    Q_ENUM(Motion)
+
     explicit QVL53L0X(QObject *parent = nullptr);
 
     QVL53L0XReading *reading() const;
@@ -26,16 +47,239 @@ public:
     quint8 address() const;
     void setAddress(quint8 address);
 
+    bool longRange() const;
+    void setLongRange(bool longRange);
+
+    bool fractionalRanging() const;
+    void setFractionalRanging(bool fractionalRanging);
+
+    QString captureFile() const;
+    void setCaptureFile(const QString &captureFile);
+
+    QString replayFile() const;
+    void setReplayFile(const QString &replayFile);
+
+    qreal replaySpeed() const;
+    void setReplaySpeed(qreal replaySpeed);
+
+    QString sharedMemoryName() const;
+    void setSharedMemoryName(const QString &sharedMemoryName);
+
+    bool oversampling() const;
+    void setOversampling(bool oversampling);
+
+    int calibrationInterval() const;
+    void setCalibrationInterval(int calibrationInterval);
+
+    QDateTime lastCalibration() const;
+
+    qreal deadband() const;
+    void setDeadband(qreal deadband);
+
+    int heartbeat() const;
+    void setHeartbeat(int heartbeat);
+
+    int realtimePriority() const;
+    void setRealtimePriority(int realtimePriority);
+
+    QList<int> cpuAffinity() const;
+    void setCpuAffinity(const QList<int> &cpuAffinity);
+
+    bool lockMemory() const;
+    void setLockMemory(bool lockMemory);
+
+    bool lowPower() const;
+    void setLowPower(bool lowPower);
+
+    qreal sigmaLimit() const;
+    void setSigmaLimit(qreal sigmaLimit);
+
+    qreal signalRateLimit() const;
+    void setSignalRateLimit(qreal signalRateLimit);
+
+    bool rejectInvalidRanges() const;
+    void setRejectInvalidRanges(bool rejectInvalidRanges);
+
+    int i2cTimeout() const;
+    void setI2cTimeout(int i2cTimeout);
+
+    int i2cRetries() const;
+    void setI2cRetries(int i2cRetries);
+
+    int busSpeed() const;
+    void setBusSpeed(int busSpeed);
+
+    qreal busOccupancy() const;
+
+    int historySize() const;
+    void setHistorySize(int historySize);
+
+    bool adaptiveRate() const;
+    void setAdaptiveRate(bool adaptiveRate);
+
+    int minimumDataRate() const;
+    void setMinimumDataRate(int minimumDataRate);
+
+    int maximumDataRate() const;
+    void setMaximumDataRate(int maximumDataRate);
+
+    qreal motionThreshold() const;
+    void setMotionThreshold(qreal motionThreshold);
+
+    bool kinematics() const;
+    void setKinematics(bool kinematics);
+
+    int kinematicsWindow() const;
+    void setKinematicsWindow(int kinematicsWindow);
+
+    qreal approachThreshold() const;
+    void setApproachThreshold(qreal approachThreshold);
+
+    Motion motion() const;
+
+    QString tuningFile() const;
+    void setTuningFile(const QString &tuningFile);
+
+    QString tuningProfile() const;
+    void setTuningProfile(const QString &tuningProfile);
+
+    QString socketPath() const;
+    void setSocketPath(const QString &socketPath);
+
+    int batchInterval() const;
+    void setBatchInterval(int batchInterval);
+
+    qsizetype samples(QVL53L0XSample *buffer, qsizetype count, quint64 *cursor = nullptr) const;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+    qsizetype samples(QSpan<QVL53L0XSample> buffer, quint64 *cursor = nullptr) const;
+#endif
+
+    const QVL53L0XMetrics *metrics() const;
+
+    Q_INVOKABLE void calibrate();
+
 signals:
+    void initializationFinished(bool success);
     void busChanged();
     void addressChanged();
+    void longRangeChanged();
+    void fractionalRangingChanged();
+    void captureFileChanged();
+    void replayFileChanged();
+    void replaySpeedChanged();
+    void sharedMemoryNameChanged();
+    void oversamplingChanged();
+    void calibrationIntervalChanged();
+    void lastCalibrationChanged();
+    void calibrationRequested();
+    void deadbandChanged();
+    void heartbeatChanged();
+    void realtimePriorityChanged();
+    void cpuAffinityChanged();
+    void lockMemoryChanged();
+    void lowPowerChanged();
+    void sigmaLimitChanged();
+    void signalRateLimitChanged();
+    void rejectInvalidRangesChanged();
+    void i2cTimeoutChanged();
+    void i2cRetriesChanged();
+    void busSpeedChanged();
+    void busOccupancyChanged();
+    void historySizeChanged();
+    void adaptiveRateChanged();
+    void minimumDataRateChanged();
+    void maximumDataRateChanged();
+    void motionThresholdChanged();
+    void kinematicsChanged();
+    void kinematicsWindowChanged();
+    void approachThresholdChanged();
+    void motionChanged(QVL53L0X::Motion motion);
+    void tuningFileChanged();
+    void tuningProfileChanged();
+    void socketPathChanged();
+    void batchIntervalChanged();
 
 private:
+    void setLastCalibration(const QDateTime &lastCalibration);
+    void setBusOccupancy(qreal busOccupancy);
+    void setMotion(Motion motion);
+
     QString m_bus = "/dev/i2c-1"; //i2c bus path
-    quint8 m_address = 0x52; //i2c device address
+    quint8 m_address = 0x29; //7 bit i2c device address, 0x52 in the 8 bit notation of the datasheet
+    bool m_longRange = false; //lower signal limit and longer vcsel periods
+    bool m_fractionalRanging = false; //0.25mm range resolution
+    QString m_captureFile; //records raw results and configuration changes when set
+    QString m_replayFile; //capture played back by the replay backend
+    qreal m_replaySpeed = 1.0; //replay speed multiplier, 0 replays as fast as possible
+    QString m_sharedMemoryName; //readings are published to (or consumed from) this shared memory ring
+    bool m_oversampling = false; //range back to back and report averaged ranges at dataRate
+    int m_calibrationInterval = 0; //seconds between VHV/phase recalibrations, 0 disables them
+    QDateTime m_lastCalibration; //set by the backend
+    qreal m_deadband = 0; //mm, readings within the deadband of the last emitted one are skipped
+    int m_heartbeat = 0; //ms, longest time without a reading while skipping, 0 disables it
+    int m_realtimePriority = 0; //SCHED_FIFO priority of the bus thread (1-99), 0 keeps the default policy
+    QList<int> m_cpuAffinity; //CPUs the bus thread may run on, empty allows all of them
+    bool m_lockMemory = false; //locks the process memory (mlockall) so polling never page faults
+    bool m_lowPower = false; //timed ranging on the device clock, coarse host timers and standby while stopped
+    qreal m_sigmaLimit = 0; //mm, ranges with a larger sigma estimate fail with SigmaFail, 0 disables the check. Same scale as the API's sigma final range limit (18 mm default)
+    qreal m_signalRateLimit = 0; //MCPS, device side return signal limit, 0 keeps the ranging mode's default
+    bool m_rejectInvalidRanges = false; //ranges that fail a limit check are dropped instead of emitted
+    int m_i2cTimeout = 0; //ms, I2C_TIMEOUT of the adapter (10 ms steps), 0 keeps the adapter default
+    int m_i2cRetries = -1; //I2C_RETRIES of the adapter, -1 keeps the adapter default
+    int m_busSpeed = 0; //Hz, SCL clock of the bus for the load planner, 0 reads it from the device tree
+    qreal m_busOccupancy = 0; //share of the bus reserved by the polling sensors on it, set by the backend
+    int m_historySize = 256; //samples kept for samples(), 0 keeps none
+    bool m_adaptiveRate = false; //the backend sets dataRate between the minimum and maximum by the observed motion
+    int m_minimumDataRate = 1; //Hz, adaptive rate of a static scene
+    int m_maximumDataRate = 30; //Hz, adaptive rate at or above the motion threshold
+    qreal m_motionThreshold = 100; //mm/s, target speed that selects the maximum adaptive rate
+    bool m_kinematics = false; //the backend adds velocity, acceleration and time to contact to the readings
+    int m_kinematicsWindow = 8; //ranges the kinematics are fitted over
+    qreal m_approachThreshold = 50; //mm/s, speed towards or away from the sensor that changes the motion
+    Motion m_motion = Stationary; //set by the backend
+    QString m_tuningFile; //tuning profiles, see QVL53L0XTuning::load()
+    QString m_tuningProfile; //profile of the tuning file the device is tuned with, empty for ST's default tuning
+    QString m_socketPath = "/run/qvl53l0x.sock"; //sensor daemon the socket backend subscribes to
+    int m_batchInterval = 0; //ms the sensor daemon may hold samples back to send them together, 0 sends each on its own
+    QVL53L0XBackend *m_backend = nullptr; //set while a hardware backend is connected
 
     Q_PROPERTY(QString bus READ bus WRITE setBus NOTIFY busChanged FINAL)
     Q_PROPERTY(quint8 address READ address WRITE setAddress NOTIFY addressChanged FINAL)
+    Q_PROPERTY(bool longRange READ longRange WRITE setLongRange NOTIFY longRangeChanged FINAL)
+    Q_PROPERTY(bool fractionalRanging READ fractionalRanging WRITE setFractionalRanging NOTIFY fractionalRangingChanged FINAL)
+    Q_PROPERTY(QString captureFile READ captureFile WRITE setCaptureFile NOTIFY captureFileChanged FINAL)
+    Q_PROPERTY(QString replayFile READ replayFile WRITE setReplayFile NOTIFY replayFileChanged FINAL)
+    Q_PROPERTY(qreal replaySpeed READ replaySpeed WRITE setReplaySpeed NOTIFY replaySpeedChanged FINAL)
+    Q_PROPERTY(QString sharedMemoryName READ sharedMemoryName WRITE setSharedMemoryName NOTIFY sharedMemoryNameChanged FINAL)
+    Q_PROPERTY(bool oversampling READ oversampling WRITE setOversampling NOTIFY oversamplingChanged FINAL)
+    Q_PROPERTY(int calibrationInterval READ calibrationInterval WRITE setCalibrationInterval NOTIFY calibrationIntervalChanged FINAL)
+    Q_PROPERTY(QDateTime lastCalibration READ lastCalibration NOTIFY lastCalibrationChanged FINAL)
+    Q_PROPERTY(qreal deadband READ deadband WRITE setDeadband NOTIFY deadbandChanged FINAL)
+    Q_PROPERTY(int heartbeat READ heartbeat WRITE setHeartbeat NOTIFY heartbeatChanged FINAL)
+    Q_PROPERTY(int realtimePriority READ realtimePriority WRITE setRealtimePriority NOTIFY realtimePriorityChanged FINAL)
+    Q_PROPERTY(QList<int> cpuAffinity READ cpuAffinity WRITE setCpuAffinity NOTIFY cpuAffinityChanged FINAL)
+    Q_PROPERTY(bool lockMemory READ lockMemory WRITE setLockMemory NOTIFY lockMemoryChanged FINAL)
+    Q_PROPERTY(bool lowPower READ lowPower WRITE setLowPower NOTIFY lowPowerChanged FINAL)
+    Q_PROPERTY(qreal sigmaLimit READ sigmaLimit WRITE setSigmaLimit NOTIFY sigmaLimitChanged FINAL)
+    Q_PROPERTY(qreal signalRateLimit READ signalRateLimit WRITE setSignalRateLimit NOTIFY signalRateLimitChanged FINAL)
+    Q_PROPERTY(bool rejectInvalidRanges READ rejectInvalidRanges WRITE setRejectInvalidRanges NOTIFY rejectInvalidRangesChanged FINAL)
+    Q_PROPERTY(int i2cTimeout READ i2cTimeout WRITE setI2cTimeout NOTIFY i2cTimeoutChanged FINAL)
+    Q_PROPERTY(int i2cRetries READ i2cRetries WRITE setI2cRetries NOTIFY i2cRetriesChanged FINAL)
+    Q_PROPERTY(int busSpeed READ busSpeed WRITE setBusSpeed NOTIFY busSpeedChanged FINAL)
+    Q_PROPERTY(qreal busOccupancy READ busOccupancy NOTIFY busOccupancyChanged FINAL)
+    Q_PROPERTY(int historySize READ historySize WRITE setHistorySize NOTIFY historySizeChanged FINAL)
+    Q_PROPERTY(bool adaptiveRate READ adaptiveRate WRITE setAdaptiveRate NOTIFY adaptiveRateChanged FINAL)
+    Q_PROPERTY(int minimumDataRate READ minimumDataRate WRITE setMinimumDataRate NOTIFY minimumDataRateChanged FINAL)
+    Q_PROPERTY(int maximumDataRate READ maximumDataRate WRITE setMaximumDataRate NOTIFY maximumDataRateChanged FINAL)
+    Q_PROPERTY(qreal motionThreshold READ motionThreshold WRITE setMotionThreshold NOTIFY motionThresholdChanged FINAL)
+    Q_PROPERTY(bool kinematics READ kinematics WRITE setKinematics NOTIFY kinematicsChanged FINAL)
+    Q_PROPERTY(int kinematicsWindow READ kinematicsWindow WRITE setKinematicsWindow NOTIFY kinematicsWindowChanged FINAL)
+    Q_PROPERTY(qreal approachThreshold READ approachThreshold WRITE setApproachThreshold NOTIFY approachThresholdChanged FINAL)
+    Q_PROPERTY(Motion motion READ motion NOTIFY motionChanged FINAL)
+    Q_PROPERTY(QString tuningFile READ tuningFile WRITE setTuningFile NOTIFY tuningFileChanged FINAL)
+    Q_PROPERTY(QString tuningProfile READ tuningProfile WRITE setTuningProfile NOTIFY tuningProfileChanged FINAL)
+    Q_PROPERTY(QString socketPath READ socketPath WRITE setSocketPath NOTIFY socketPathChanged FINAL)
+    Q_PROPERTY(int batchInterval READ batchInterval WRITE setBatchInterval NOTIFY batchIntervalChanged FINAL)
 };
 
 QT_END_NAMESPACE
@@ -1,16 +1,51 @@
 #ifndef QVL53L_X_P_H
 #define QVL53L_X_P_H
 
+#include <QtNumeric>
+
 #include "qvl53l0x_global.h"
+#include "qvl53l0xreading.h"
 
 QT_BEGIN_NAMESPACE
 
 class QVL53L_X_EXPORT QVL53L0XReadingPrivate
 {
 public:
-    QVL53L0XReadingPrivate() : distance(0.0) { }
+    QVL53L0XReadingPrivate() :
+        distance(0),
+        preciseDistance(0.0),
+        rangeStatus(QVL53L0XReading::NoUpdate),
+        meanDistance(0.0),
+        medianDistance(0.0),
+        distanceVariance(0.0),
+        sampleCount(0),
+        signalRate(0.0),
+        ambientRate(0.0),
+        sigma(0.0),
+        velocity(0.0),
+        acceleration(0.0),
+        timeToContact(qInf())
+    { }
+
+    quint32 distance; //mm
+    qreal preciseDistance; //mm, quarter mm resolution with fractional ranging
+    QVL53L0XReading::RangeStatus rangeStatus;
+
+    //oversampling statistics, a single sample without oversampling
+    qreal meanDistance;
+    qreal medianDistance;
+    qreal distanceVariance; //mm^2
+    int sampleCount;
+
+    //return signal quality of the measurement
+    qreal signalRate; //MCPS
+    qreal ambientRate; //MCPS
+    qreal sigma; //mm, estimated range uncertainty
 
-    qreal distance;
+    //kinematics of the target, left at rest unless QVL53L0X::kinematics is set
+    qreal velocity; //mm/s, negative while approaching
+    qreal acceleration; //mm/s^2
+    qreal timeToContact; //s, infinite unless approaching
 };
 
 QT_END_NAMESPACE
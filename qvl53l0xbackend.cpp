@@ -1,76 +1,467 @@
 #include "qvl53l0xbackend.h"
+#include "qvl53l0xbus.h"
+#include "qvl53l0xsimulator.h"
+
+#include <QVarLengthArray>
+#include <QtMath>
+#include <QtNumeric>
+
+#include <algorithm>
+#include <cstring>
+
+#include "unistd.h"
+#include "sys/eventfd.h"
+#include "sys/mman.h"
+
+// Decode VCSEL (vertical cavity surface emitting laser) pulse period in PCLKs
+// from register value, based on VL53L0X_decode_vcsel_period()
+#define decodeVcselPeriod(reg_val)      (((reg_val) + 1) << 1)
+
+// Encode VCSEL pulse period register value from period in PCLKs,
+// based on VL53L0X_encode_vcsel_period()
+#define encodeVcselPeriod(period_pclks) (((period_pclks) >> 1) - 1)
+
+// Calculate macro period in *nanoseconds* from VCSEL period in PCLKs,
+// based on VL53L0X_calc_macro_period_ps()
+// PLL_period_ps = 1655; macro_period_vclks = 2304
+#define calcMacroPeriod(vcsel_period_pclks) ((((quint32)2304 * (vcsel_period_pclks) * 1655) + 500) / 1000)
 
 QVL53L0XBackend::QVL53L0XBackend(QSensor *sensor) : QSensorBackend(sensor)
 {
-    m_pollTimer = new QTimer(this);
-    QObject::connect(m_pollTimer, SIGNAL(timeout()), this, SLOT(poll()));
+    m_oversamplingTimer = new QTimer(this);
+    QObject::connect(m_oversamplingTimer, SIGNAL(timeout()), this, SLOT(reportOversampling()));
+
+    m_recoveryTimer = new QTimer(this);
+    m_recoveryTimer->setSingleShot(true);
+    QObject::connect(m_recoveryTimer, SIGNAL(timeout()), this, SLOT(recover()));
+
+    // the bus thread signals new events through the eventfd, see queueEvent()
+    m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(m_eventFd >= 0)
+    {
+        m_eventNotifier = new QSocketNotifier(m_eventFd, QSocketNotifier::Read, this);
+        QObject::connect(m_eventNotifier, &QSocketNotifier::activated, this, &QVL53L0XBackend::drain);
+    }
+    else
+        reportError("COULD NOT CREATE EVENT FD");
+
+    // lets a QVL53L0XGroup find the backend of its sensors
+    if(QVL53L0X *vl53l0x = qobject_cast<QVL53L0X*>(sensor))
+        vl53l0x->m_backend = this;
 
     reportEvent("QVL53L0X BACKEND CREATED");
 
     setReading<QVL53L0XReading>(&m_reading);
     reading();
 
-    addDataRate(1, 30);
+    // the default timing budget allows 30 measurements per second, a slow bus
+    // less. The share other sensors take is enforced by planDataRate()
+    QVL53L0X *vl53l0x = qobject_cast<QVL53L0X*>(sensor);
+    quint32 speed = vl53l0x && vl53l0x->busSpeed() > 0 ? vl53l0x->busSpeed() : QVL53L0XBus::detectSpeed(vl53l0x ? vl53l0x->bus() : QString());
+    int maxRate = static_cast<int>(speed * QVL53L0XBus::maxOccupancy / busLoad(1));
+
+    addDataRate(1, qBound(1, maxRate, static_cast<int>(1000000 / defaultTimingBudget)));
 }
 
 QVL53L0XBackend::~QVL53L0XBackend()
 {
-    if(m_pollTimer)
+    if(QVL53L0X *vl53l0x = qobject_cast<QVL53L0X*>(sensor()))
+        vl53l0x->m_backend = nullptr;
+
+    //make sure the bus thread is done with this backend
+    if(m_busController)
+    {
+        m_busController->cancel(this);
+        QVL53L0XBus::release(m_busController);
+    }
+
+    if(m_oversamplingTimer)
     {
-        if(m_pollTimer->isActive())
-            m_pollTimer->stop();
+        if(m_oversamplingTimer->isActive())
+            m_oversamplingTimer->stop();
 
-        delete m_pollTimer;
+        delete m_oversamplingTimer;
     }
 
-    QSensorBackend::~QSensorBackend();
+    if(m_recoveryTimer)
+        delete m_recoveryTimer;
+
+    if(m_eventNotifier)
+        delete m_eventNotifier;
+
+    if(m_eventFd >= 0)
+        close(m_eventFd);
+
+    unlockMemory();
 }
 
 void QVL53L0XBackend::start()
 {
-    if(m_pollTimer && m_pollTimer->isActive())
+    m_active = true;
+
+    if(m_polling || m_initializing)
         return;
 
-    if(!m_initialized && !initialize())
+    if(!m_initialized)
     {
-        reportError("COULD NOT INITIALIZE SENSOR");
-        handleFault();
+        if(!configure())
+        {
+            reportError("COULD NOT INITIALIZE SENSOR");
+            handleFault();
+            return;
+        }
+
+        // bring up runs on the bus thread, polling starts once it has finished
+        if(!m_busController || m_busController->path() != m_bus)
+        {
+            if(m_busController)
+                QObject::disconnect(m_busController, nullptr, this, nullptr);
+
+            QVL53L0XBus::release(m_busController);
+            m_busController = QVL53L0XBus::acquire(m_bus);
+
+            QObject::connect(m_busController, &QVL53L0XBus::occupancyChanged, this, &QVL53L0XBackend::onBusOccupancyChanged);
+        }
+
+        onSensorSchedulingChanged();
+        onSensorBusSpeedChanged();
+
+        m_initializing = true;
+        m_initializationState = InitializationState::Static;
+        m_busController->initialize(this);
+
         return;
     }
 
-    m_pollTimer->setInterval(1000 / sensor()->dataRate());
-    m_pollTimer->start();
+    startPolling();
+}
+
+// the measurements are taken by the bus thread, the sensor thread decodes and
+// emits them as they arrive, see drain()
+void QVL53L0XBackend::startPolling()
+{
+    // low power lets the device time the measurements, oversampling needs them
+    // back to back. Grouped sensors are triggered one shot at a time by the group
+    m_rangeContinuously = !m_grouped && (m_oversampling || m_lowPower);
+
+    int rate = planDataRate(sensor()->dataRate());
+
+    // only reported back, onSesnorDataRateChanged() does nothing while not polling
+    if(rate != sensor()->dataRate())
+        sensor()->setDataRate(rate);
+
+    m_pollInterval = 1000 / rate;
+    m_intermeasurementPeriod = m_oversampling ? 0 : m_pollInterval;
+
+    if(m_oversampling && !m_grouped)
+    {
+        // the bus thread polls twice per measurement, one sample per poll at
+        // most, so the buffer never has to grow
+        int interval = qMax<int>(1, m_measurementTimingBudget / 2000);
+        m_samples.assign(m_pollInterval / interval + 2, 0.0);
+        m_sampleCount = 0;
+
+        // the bus thread keeps its own schedule, the timer only reports the
+        // oversampled range once per data rate period
+        m_oversamplingTimer->setInterval(m_pollInterval);
+        m_oversamplingTimer->start();
+    }
+
+    // the target may have moved while stopped
+    m_kinematics.reset();
+
+    m_polling = true;
+    m_busController->startPolling(this);
 }
 
 void QVL53L0XBackend::stop()
 {
-    if(!m_pollTimer || !m_pollTimer->isActive())
+    m_active = false;
+    m_recoveryTimer->stop();
+
+    if(!m_polling)
+        return;
+
+    m_polling = false;
+
+    // no more oversampling reports, the polls are stopped on the bus thread
+    m_oversamplingTimer->stop();
+
+    // blocks until the bus thread has stopped ranging
+    m_busController->stopPolling(this);
+
+    drain();
+}
+
+// Sensor thread, scheduled by handleFault(). Stops polling, brings the device
+// up again and resumes polling once it is initialized
+void QVL53L0XBackend::recover()
+{
+    if(!m_active || m_initializing)
         return;
 
-    m_pollTimer->stop();
+    reportEvent(QString("RECOVERING AFTER %1 FAULTS").arg(m_faultCount));
+    m_metrics.recordRestart();
+
+    if(m_polling)
+    {
+        m_polling = false;
+        m_oversamplingTimer->stop();
+
+        // blocks until the bus thread has stopped ranging
+        m_busController->stopPolling(this);
+    }
+
+    // the bus thread is done with the device, the next initialization starts from scratch
+    m_calibrationState = CalibrationState::Idle;
+    m_initialized = false;
+
+    start();
 }
 
 bool QVL53L0XBackend::isFeatureSupported(QSensor::Feature feature) const
 {
-    return false;
+    return feature == QSensor::SkipDuplicates;
 }
 
-bool QVL53L0XBackend::initialize()
+// reads the sensor configuration, called on the sensor thread before initialization
+bool QVL53L0XBackend::configure()
 {
     QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
-    quint8 data = 0;
 
     if(!sensor)
         return false;
 
     m_bus = sensor->bus();
     m_address = sensor->address();
+    m_longRange = sensor->longRange();
+    m_fractionalRanging = sensor->fractionalRanging();
+    m_oversampling = sensor->oversampling();
+    m_lowPower = sensor->lowPower();
+    m_calibrationInterval = sensor->calibrationInterval() * 1000;
+    m_skipDuplicates = sensor->skipDuplicates();
+    m_deadband = sensor->deadband();
+    m_heartbeat = static_cast<quint64>(sensor->heartbeat()) * 1000;
+    m_sigmaLimit = sensor->sigmaLimit();
+    m_signalRateLimit = sensor->signalRateLimit();
+    m_rejectInvalidRanges = sensor->rejectInvalidRanges();
+    m_i2cTimeout = sensor->i2cTimeout();
+    m_i2cRetries = sensor->i2cRetries();
+
+    onSensorLockMemoryChanged();
+    onSensorHistorySizeChanged();
+    onSensorAdaptiveRateChanged();
+    onSensorKinematicsChanged();
+    onSensorTuningFileChanged();
+
+    if(m_configured)
+        return true;
 
     QObject::connect(sensor, &QVL53L0X::busChanged, this, &QVL53L0XBackend::onSensorBusChanged);
     QObject::connect(sensor, &QVL53L0X::addressChanged, this, &QVL53L0XBackend::onSensorAddressChanged);
     QObject::connect(sensor, &QVL53L0X::dataRateChanged, this, &QVL53L0XBackend::onSesnorDataRateChanged);
+    QObject::connect(sensor, &QVL53L0X::longRangeChanged, this, &QVL53L0XBackend::onSensorRangingModeChanged);
+    QObject::connect(sensor, &QVL53L0X::fractionalRangingChanged, this, &QVL53L0XBackend::onSensorRangingModeChanged);
+    QObject::connect(sensor, &QVL53L0X::captureFileChanged, this, &QVL53L0XBackend::onSensorCaptureFileChanged);
+    QObject::connect(sensor, &QVL53L0X::sharedMemoryNameChanged, this, &QVL53L0XBackend::onSensorSharedMemoryNameChanged);
+    QObject::connect(sensor, &QVL53L0X::oversamplingChanged, this, &QVL53L0XBackend::onSensorOversamplingChanged);
+    QObject::connect(sensor, &QVL53L0X::lowPowerChanged, this, &QVL53L0XBackend::onSensorLowPowerChanged);
+    QObject::connect(sensor, &QVL53L0X::calibrationIntervalChanged, this, &QVL53L0XBackend::onSensorCalibrationIntervalChanged);
+    QObject::connect(sensor, &QVL53L0X::calibrationRequested, this, &QVL53L0XBackend::onSensorCalibrationRequested);
+    QObject::connect(sensor, &QVL53L0X::skipDuplicatesChanged, this, &QVL53L0XBackend::onSensorDuplicateSuppressionChanged);
+    QObject::connect(sensor, &QVL53L0X::deadbandChanged, this, &QVL53L0XBackend::onSensorDuplicateSuppressionChanged);
+    QObject::connect(sensor, &QVL53L0X::heartbeatChanged, this, &QVL53L0XBackend::onSensorDuplicateSuppressionChanged);
+    QObject::connect(sensor, &QVL53L0X::realtimePriorityChanged, this, &QVL53L0XBackend::onSensorSchedulingChanged);
+    QObject::connect(sensor, &QVL53L0X::cpuAffinityChanged, this, &QVL53L0XBackend::onSensorSchedulingChanged);
+    QObject::connect(sensor, &QVL53L0X::lockMemoryChanged, this, &QVL53L0XBackend::onSensorLockMemoryChanged);
+    QObject::connect(sensor, &QVL53L0X::sigmaLimitChanged, this, &QVL53L0XBackend::onSensorLimitChecksChanged);
+    QObject::connect(sensor, &QVL53L0X::signalRateLimitChanged, this, &QVL53L0XBackend::onSensorLimitChecksChanged);
+    QObject::connect(sensor, &QVL53L0X::rejectInvalidRangesChanged, this, &QVL53L0XBackend::onSensorLimitChecksChanged);
+    QObject::connect(sensor, &QVL53L0X::i2cTimeoutChanged, this, &QVL53L0XBackend::onSensorAdapterSettingsChanged);
+    QObject::connect(sensor, &QVL53L0X::i2cRetriesChanged, this, &QVL53L0XBackend::onSensorAdapterSettingsChanged);
+    QObject::connect(sensor, &QVL53L0X::busSpeedChanged, this, &QVL53L0XBackend::onSensorBusSpeedChanged);
+    QObject::connect(sensor, &QVL53L0X::historySizeChanged, this, &QVL53L0XBackend::onSensorHistorySizeChanged);
+    QObject::connect(sensor, &QVL53L0X::adaptiveRateChanged, this, &QVL53L0XBackend::onSensorAdaptiveRateChanged);
+    QObject::connect(sensor, &QVL53L0X::minimumDataRateChanged, this, &QVL53L0XBackend::onSensorAdaptiveRateChanged);
+    QObject::connect(sensor, &QVL53L0X::maximumDataRateChanged, this, &QVL53L0XBackend::onSensorAdaptiveRateChanged);
+    QObject::connect(sensor, &QVL53L0X::motionThresholdChanged, this, &QVL53L0XBackend::onSensorAdaptiveRateChanged);
+    QObject::connect(sensor, &QVL53L0X::kinematicsChanged, this, &QVL53L0XBackend::onSensorKinematicsChanged);
+    QObject::connect(sensor, &QVL53L0X::kinematicsWindowChanged, this, &QVL53L0XBackend::onSensorKinematicsChanged);
+    QObject::connect(sensor, &QVL53L0X::approachThresholdChanged, this, &QVL53L0XBackend::onSensorKinematicsChanged);
+    QObject::connect(sensor, &QVL53L0X::tuningFileChanged, this, &QVL53L0XBackend::onSensorTuningFileChanged);
+    QObject::connect(sensor, &QVL53L0X::tuningProfileChanged, this, &QVL53L0XBackend::onSensorTuningProfileChanged);
+
+    onSensorCaptureFileChanged();
+    onSensorSharedMemoryNameChanged();
+
+    m_configured = true;
+
+    return true;
+}
+
+// blocking initialization on the calling thread
+bool QVL53L0XBackend::initialize()
+{
+    if(!configure())
+        return false;
+
+    m_initializationState = InitializationState::Static;
+
+    forever
+    {
+        switch(initializeStep())
+        {
+        case InitializationResult::Finished:
+            return true;
+        case InitializationResult::Failed:
+            return false;
+        case InitializationResult::Waiting:
+            break;
+        }
+    }
+}
+
+// runs the initialization up to the next reference calibration, which the
+// device performs on its own while the bus is used for other sensors
+QVL53L0XBackend::InitializationResult QVL53L0XBackend::initializeStep()
+{
+    bool done = false;
+
+    switch(m_initializationState)
+    {
+    case InitializationState::Static:
+        if(!startI2C() || !initializeStatic())
+            return InitializationResult::Failed;
+
+        // VL53L0X_PerformRefCalibration() begin (VL53L0X_perform_ref_calibration())
+
+        // -- VL53L0X_perform_vhv_calibration() begin
+        if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0x01))
+            return InitializationResult::Failed;
+
+        if(!startSingleRefCalibration(0x40))
+            return InitializationResult::Failed;
+
+        m_calibrationTimer.start();
+        m_initializationState = InitializationState::WaitVhvCalibration;
+
+        return InitializationResult::Waiting;
+
+    case InitializationState::WaitVhvCalibration:
+        if(!checkSingleRefCalibration(done))
+            return InitializationResult::Failed;
+
+        if(!done)
+        {
+            if(!waitExpired(m_calibrationTimer))
+                return InitializationResult::Waiting;
+
+            reportError("VHV CALIBRATION TIMED OUT");
+            m_errno = ETIMEDOUT;
+            return InitializationResult::Failed;
+        }
+
+        // -- VL53L0X_perform_vhv_calibration() end
+
+        // -- VL53L0X_perform_phase_calibration() begin
+        if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0x02))
+            return InitializationResult::Failed;
+
+        if(!startSingleRefCalibration(0x00))
+            return InitializationResult::Failed;
+
+        m_calibrationTimer.start();
+        m_initializationState = InitializationState::WaitPhaseCalibration;
+
+        return InitializationResult::Waiting;
+
+    case InitializationState::WaitPhaseCalibration:
+        if(!checkSingleRefCalibration(done))
+            return InitializationResult::Failed;
+
+        if(!done)
+        {
+            if(!waitExpired(m_calibrationTimer))
+                return InitializationResult::Waiting;
+
+            reportError("PHASE CALIBRATION TIMED OUT");
+            m_errno = ETIMEDOUT;
+            return InitializationResult::Failed;
+        }
+
+        // -- VL53L0X_perform_phase_calibration() end
+
+        // "restore the previous Sequence Config"
+        if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0xE8))
+            return InitializationResult::Failed;
+
+        // VL53L0X_PerformRefCalibration() end
+
+        // apply long range and fractional ranging if they were requested before start
+        if(!applyRangingMode())
+            return InitializationResult::Failed;
+
+        endI2C();
+
+        m_lastCalibrationTimer.start();
+        m_initialized = true;
+        m_initializationState = InitializationState::Done;
+
+        return InitializationResult::Finished;
+
+    case InitializationState::Done:
+        return InitializationResult::Finished;
+    }
+
+    return InitializationResult::Failed;
+}
+
+// called on the bus thread, the result is handled on the sensor thread
+void QVL53L0XBackend::reportInitialization(bool success)
+{
+    QMetaObject::invokeMethod(this, [this, success]()
+    {
+        onInitializationFinished(success);
+    }, Qt::QueuedConnection);
+}
+
+void QVL53L0XBackend::onInitializationFinished(bool success)
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    m_initializing = false;
+
+    if(!success)
+    {
+        reportError("COULD NOT INITIALIZE SENSOR");
+        endI2C();
+        handleFault();
+    }
+
+    // initialization includes a full reference calibration
+    if(success)
+        recalibrated();
+
+    if(sensor)
+        emit sensor->initializationFinished(success);
+
+    // the bus may have changed while the sensor was coming up
+    if(success && sensor && sensor->bus() != m_bus)
+    {
+        onSensorBusChanged();
+        return;
+    }
+
+    // stop() may have been called while the sensor was coming up
+    if(success && m_active)
+        startPolling();
+}
 
-    startI2C();
+// VL53L0X_DataInit() and VL53L0X_StaticInit()
+bool QVL53L0XBackend::initializeStatic()
+{
+    quint8 data = 0;
 
     if(!confirmChipID())
     {
@@ -157,168 +548,17 @@ bool QVL53L0XBackend::initialize()
     if(!writeRegisterData((quint8)Register::GLOBAL_CONFIG_SPAD_ENABLES_REF_0, spadMap, 6))
         return false;
 
-    // DefaultTuningSettings from vl53l0x_tuning.h
-    if(!writeRegisterByte(0xFF, 0x01))
-        return false;
-    if(!writeRegisterByte(0x00, 0x00))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x00))
-        return false;
-    if(!writeRegisterByte(0x09, 0x00))
-        return false;
-    if(!writeRegisterByte(0x10, 0x00))
-        return false;
-    if(!writeRegisterByte(0x11, 0x00))
-        return false;
-    if(!writeRegisterByte(0x24, 0x01))
-        return false;
-    if(!writeRegisterByte(0x25, 0xFF))
-        return false;
-    if(!writeRegisterByte(0x75, 0x00))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x01))
-        return false;
-    if(!writeRegisterByte(0x4E, 0x2C))
-        return false;
-    if(!writeRegisterByte(0x48, 0x00))
-        return false;
-    if(!writeRegisterByte(0x30, 0x20))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x00))
-        return false;
-    if(!writeRegisterByte(0x30, 0x09))
-        return false;
-    if(!writeRegisterByte(0x54, 0x00))
-        return false;
-    if(!writeRegisterByte(0x31, 0x04))
-        return false;
-    if(!writeRegisterByte(0x32, 0x03))
-        return false;
-    if(!writeRegisterByte(0x40, 0x83))
-        return false;
-    if(!writeRegisterByte(0x46, 0x25))
-        return false;
-    if(!writeRegisterByte(0x60, 0x00))
-        return false;
-    if(!writeRegisterByte(0x27, 0x00))
-        return false;
-    if(!writeRegisterByte(0x50, 0x06))
-        return false;
-    if(!writeRegisterByte(0x51, 0x00))
-        return false;
-    if(!writeRegisterByte(0x52, 0x96))
-        return false;
-    if(!writeRegisterByte(0x56, 0x08))
-        return false;
-    if(!writeRegisterByte(0x57, 0x30))
-        return false;
-    if(!writeRegisterByte(0x61, 0x00))
-        return false;
-    if(!writeRegisterByte(0x62, 0x00))
-        return false;
-    if(!writeRegisterByte(0x64, 0x00))
-        return false;
-    if(!writeRegisterByte(0x65, 0x00))
-        return false;
-    if(!writeRegisterByte(0x66, 0xA0))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x01))
-        return false;
-    if(!writeRegisterByte(0x22, 0x32))
-        return false;
-    if(!writeRegisterByte(0x47, 0x14))
-        return false;
-    if(!writeRegisterByte(0x49, 0xFF))
-        return false;
-    if(!writeRegisterByte(0x4A, 0x00))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x00))
-        return false;
-    if(!writeRegisterByte(0x7A, 0x0A))
-        return false;
-    if(!writeRegisterByte(0x7B, 0x00))
-        return false;
-    if(!writeRegisterByte(0x78, 0x21))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x01))
-        return false;
-    if(!writeRegisterByte(0x23, 0x34))
-        return false;
-    if(!writeRegisterByte(0x42, 0x00))
-        return false;
-    if(!writeRegisterByte(0x44, 0xFF))
-        return false;
-    if(!writeRegisterByte(0x45, 0x26))
-        return false;
-    if(!writeRegisterByte(0x46, 0x05))
-        return false;
-    if(!writeRegisterByte(0x40, 0x40))
-        return false;
-    if(!writeRegisterByte(0x0E, 0x06))
-        return false;
-    if(!writeRegisterByte(0x20, 0x1A))
-        return false;
-    if(!writeRegisterByte(0x43, 0x40))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x00))
-        return false;
-    if(!writeRegisterByte(0x34, 0x03))
-        return false;
-    if(!writeRegisterByte(0x35, 0x44))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x01))
-        return false;
-    if(!writeRegisterByte(0x31, 0x04))
-        return false;
-    if(!writeRegisterByte(0x4B, 0x09))
-        return false;
-    if(!writeRegisterByte(0x4C, 0x05))
-        return false;
-    if(!writeRegisterByte(0x4D, 0x04))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x00))
-        return false;
-    if(!writeRegisterByte(0x44, 0x00))
-        return false;
-    if(!writeRegisterByte(0x45, 0x20))
-        return false;
-    if(!writeRegisterByte(0x47, 0x08))
-        return false;
-    if(!writeRegisterByte(0x48, 0x28))
-        return false;
-    if(!writeRegisterByte(0x67, 0x00))
-        return false;
-    if(!writeRegisterByte(0x70, 0x04))
-        return false;
-    if(!writeRegisterByte(0x71, 0x01))
-        return false;
-    if(!writeRegisterByte(0x72, 0xFE))
-        return false;
-    if(!writeRegisterByte(0x76, 0x00))
-        return false;
-    if(!writeRegisterByte(0x77, 0x00))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x01))
-        return false;
-    if(!writeRegisterByte(0x0D, 0x01))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x00))
-        return false;
-    if(!writeRegisterByte(0x80, 0x01))
-        return false;
-    if(!writeRegisterByte(0x01, 0xF8))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x01))
-        return false;
-    if(!writeRegisterByte(0x8E, 0x01))
-        return false;
-    if(!writeRegisterByte(0x00, 0x01))
-        return false;
-    if(!writeRegisterByte(0xFF, 0x00))
-        return false;
-    if(!writeRegisterByte(0x80, 0x00))
+    // -- VL53L0X_load_tuning_settings() begin, ST's DefaultTuningSettings
+    // unless the sensor selects another profile. The full profile supersedes
+    // a pending switch
+    if(m_changes & TuningChange)
+        m_tuning = m_pendingTuning;
+
+    if(!writeTuning(m_tuning))
         return false;
 
+    m_changes &= ~TuningChange;
+
     // -- VL53L0X_load_tuning_settings() end
 
     // "Set interrupt config to new sample ready"
@@ -347,44 +587,37 @@ bool QVL53L0XBackend::initialize()
 
     // -- VL53L0X_SetSequenceStepEnable() end
 
-    // VL53L0X_StaticInit() end
-
-    // VL53L0X_PerformRefCalibration() begin (VL53L0X_perform_ref_calibration())
-
-    // -- VL53L0X_perform_vhv_calibration() begin
-    if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0x01))
-        return false;
-
-    if (!performSingleRefCalibration(0x40))
-        return false;
-
-    // -- VL53L0X_perform_vhv_calibration() end
-
-    // -- VL53L0X_perform_phase_calibration() begin
-    if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0x02))
-        return false;
-
-    if (!performSingleRefCalibration(0x00))
+    // "Recalculate timing budget"
+    if(!getMeasurementTimingBudget(m_measurementTimingBudget))
         return false;
 
-    // -- VL53L0X_perform_phase_calibration() end
-
-    // "restore the previous Sequence Config"
-    if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0xE8))
+    if(!setMeasurementTimingBudget(m_measurementTimingBudget))
         return false;
 
-    // VL53L0X_PerformRefCalibration() end
-
-    endI2C();
-
-    m_initialized = true;
+    // VL53L0X_StaticInit() end
 
     return true;
 }
 
 bool QVL53L0XBackend::startI2C()
 {
-    if(m_i2c < 0)
+    // simulated buses are served by a QVL53L0XSimulator instead of i2c-dev
+    if(m_bus.startsWith(QVL53L0XSimulator::busPrefix))
+    {
+        if(!(m_simulator = QVL53L0XSimulator::find(m_bus, m_address)))
+        {
+            reportError("DEVICE NOT FOUND");
+            m_errno = ENXIO;
+
+            return false;
+        }
+
+        reportEvent("I2C STARTED");
+
+        return true;
+    }
+
+    if(m_i2c < 0)
     {
         if((m_i2c = open(m_bus.toStdString().c_str(), O_RDWR)) < 0)
         {
@@ -405,6 +638,8 @@ bool QVL53L0XBackend::startI2C()
         return false;
     }
 
+    applyAdapterSettings();
+
     reportEvent("I2C STARTED");
 
     return true;
@@ -412,6 +647,8 @@ bool QVL53L0XBackend::startI2C()
 
 bool QVL53L0XBackend::endI2C()
 {
+    m_simulator = nullptr;
+
     if(m_i2c < 0)
         return true;
 
@@ -429,9 +666,55 @@ bool QVL53L0XBackend::endI2C()
     return true;
 }
 
+// I2C_TIMEOUT and I2C_RETRIES apply to the whole adapter, so to every device
+// on the bus. Adapters that don't support them keep their defaults
+void QVL53L0XBackend::applyAdapterSettings()
+{
+    // I2C_TIMEOUT is in units of 10 ms
+    if(m_i2cTimeout > 0 && ioctl(m_i2c, I2C_TIMEOUT, (m_i2cTimeout + 9) / 10) < 0)
+        reportError(QString("COULD NOT SET ADAPTER TIMEOUT (%1)").arg(strerror(errno)));
+
+    if(m_i2cRetries >= 0 && ioctl(m_i2c, I2C_RETRIES, m_i2cRetries) < 0)
+        reportError(QString("COULD NOT SET ADAPTER RETRIES (%1)").arg(strerror(errno)));
+}
+
+// Microseconds to wait for the device to finish a measurement or calibration.
+// Half a timing budget past the expected end, and where the data rate leaves
+// room, no longer than one poll interval so a late result never delays the next poll
+quint32 QVL53L0XBackend::waitBudget() const
+{
+    quint32 budget = m_measurementTimingBudget > 0 ? m_measurementTimingBudget : defaultTimingBudget;
+    quint32 wait = budget + budget / 2;
+
+    if(m_pollInterval > 0)
+        wait = qMin(wait, qMax(budget + 1000, static_cast<quint32>(m_pollInterval) * 1000));
+
+    return wait;
+}
+
+bool QVL53L0XBackend::waitExpired(const QElapsedTimer &timer) const
+{
+    return timer.nsecsElapsed() / 1000 >= waitBudget();
+}
+
+// every register access goes through here, the simulator stands in for i2c-dev on simulated buses
+int QVL53L0XBackend::transfer(struct i2c_rdwr_ioctl_data *payload)
+{
+    int result = m_simulator ? m_simulator->transfer(payload) : ioctl(m_i2c, I2C_RDWR, payload);
+
+    // errno is left as it is for the caller
+    if(result < 0)
+        m_metrics.recordError(errno);
+
+    return result;
+}
+
+// The register accessors are on the polling path, they use stack buffers only
+// and trace register access during bring up only, so a running sensor does
+// not allocate or log per measurement
 bool QVL53L0XBackend::readRegisterByte(quint8 reg, quint8 *data)
 {
-    quint8 *buffer = new quint8[1] { *data };
+    quint8 buffer[1] = { *data };
 
     struct i2c_msg messages[]
     {
@@ -455,22 +738,24 @@ bool QVL53L0XBackend::readRegisterByte(quint8 reg, quint8 *data)
         .nmsgs = 2
     };
 
-    if(ioctl(m_i2c, I2C_RDWR, &payload) < 0)
+    if(transfer(&payload) < 0)
     {
-        reportError(QString("COULD NOT READ REGISTER %1").arg(reg, 2, 16, '0'));
         m_errno = errno;
+        reportError(QString("COULD NOT READ REGISTER %1").arg(reg, 2, 16, '0'));
         return false;
     }
 
     *data = buffer[0];
-    reportEvent(QString("READ FROM REGISTER %1: %2").arg(reg, 2, 16, '0').arg(static_cast<quint8>(buffer[0]), 2, 16, '0'));
+
+    if(m_backendDebug && !m_initialized)
+        reportEvent(QString("READ FROM REGISTER %1: %2").arg(reg, 2, 16, '0').arg(static_cast<quint8>(buffer[0]), 2, 16, '0'));
 
     return true;
 }
 
 bool QVL53L0XBackend::readRegisterWord(quint8 reg, quint16 *data)
 {
-    quint8 *buffer = new quint8[2];
+    quint8 buffer[2] = {};
 
     if(!readRegisterData(reg, buffer, 2))
         return false;
@@ -504,21 +789,22 @@ bool QVL53L0XBackend::readRegisterData(quint8 reg, quint8 *data, quint8 length)
         .nmsgs = 2
     };
 
-    if(ioctl(m_i2c, I2C_RDWR, &payload) < 0)
+    if(transfer(&payload) < 0)
     {
-        reportError(QString("COULD NOT WRITE REGISTER %1").arg(reg, 2, 16, '0'));
         m_errno = errno;
+        reportError(QString("COULD NOT READ REGISTER %1").arg(reg, 2, 16, '0'));
         return false;
     }
 
-    reportEvent(QString("READ FROM REGISTER %1").arg(reg, 2, 16, '0'));
+    if(m_backendDebug && !m_initialized)
+        reportEvent(QString("READ FROM REGISTER %1").arg(reg, 2, 16, '0'));
 
     return true;
 }
 
 bool QVL53L0XBackend::writeRegisterByte(quint8 reg, quint8 data)
 {
-    quint8 *buffer = new quint8[2]
+    quint8 buffer[2]
     {
         reg,
         data
@@ -540,23 +826,22 @@ bool QVL53L0XBackend::writeRegisterByte(quint8 reg, quint8 data)
         .nmsgs = 1
     };
 
-    if(ioctl(m_i2c, I2C_RDWR, &payload) < 0)
+    if(transfer(&payload) < 0)
     {
-        delete [] buffer;
-        reportError(QString("COULD NOT WRITE REGISTER %1").arg(reg, 2, 16, '0'));
         m_errno = errno;
+        reportError(QString("COULD NOT WRITE REGISTER %1").arg(reg, 2, 16, '0'));
         return false;
     }
 
-    reportEvent(QString("WROTE TO REGISTER %1").arg(reg, 2, 16, '0'));
+    if(m_backendDebug && !m_initialized)
+        reportEvent(QString("WROTE TO REGISTER %1").arg(reg, 2, 16, '0'));
 
-    delete [] buffer;
     return true;
 }
 
 bool QVL53L0XBackend::writeRegisterWord(quint8 reg, quint16 data)
 {
-    quint8 *buffer = new quint8[3]
+    quint8 buffer[3]
     {
         reg,
         static_cast<quint8>((data >> 8) & 0xFF),
@@ -579,24 +864,36 @@ bool QVL53L0XBackend::writeRegisterWord(quint8 reg, quint16 data)
         .nmsgs = 1
     };
 
-    if(ioctl(m_i2c, I2C_RDWR, &payload) < 0)
+    if(transfer(&payload) < 0)
     {
-        delete [] buffer;
-        reportError(QString("COULD NOT WRITE REGISTER %1").arg(reg, 2, 16, '0'));
         m_errno = errno;
+        reportError(QString("COULD NOT WRITE REGISTER %1").arg(reg, 2, 16, '0'));
         return false;
     }
 
-    delete [] buffer;
-
-    reportEvent(QString("WROTE TO REGISTER %1").arg(reg, 2, 16, '0'));
+    if(m_backendDebug && !m_initialized)
+        reportEvent(QString("WROTE TO REGISTER %1").arg(reg, 2, 16, '0'));
 
     return true;
 }
 
+bool QVL53L0XBackend::writeRegisterLong(quint8 reg, quint32 data)
+{
+    quint8 buffer[4]
+    {
+        static_cast<quint8>((data >> 24) & 0xFF),
+        static_cast<quint8>((data >> 16) & 0xFF),
+        static_cast<quint8>((data >> 8) & 0xFF),
+        static_cast<quint8>(data & 0xFF)
+    };
+
+    return writeRegisterData(reg, buffer, 4);
+}
+
 bool QVL53L0XBackend::writeRegisterData(quint8 reg, quint8 *buffer, quint16 length)
 {
-    quint8 *data = new quint8[length + 1];
+    // register data blocks are a few bytes, QVarLengthArray keeps them on the stack
+    QVarLengthArray<quint8, 16> data(length + 1);
     data[0] = reg;
     memcpy(&data[1], buffer, length);
 
@@ -605,8 +902,8 @@ bool QVL53L0XBackend::writeRegisterData(quint8 reg, quint8 *buffer, quint16 leng
         {
             .addr = m_address,
             .flags = 0,
-            .len = length + 1,
-            .buf = data
+            .len = static_cast<__u16>(length + 1),
+            .buf = data.data()
         }
     };
 
@@ -616,26 +913,32 @@ bool QVL53L0XBackend::writeRegisterData(quint8 reg, quint8 *buffer, quint16 leng
         .nmsgs = 1
     };
 
-    if(ioctl(m_i2c, I2C_RDWR, &payload) < 0)
+    if(transfer(&payload) < 0)
     {
-        reportError(QString("COULD NOT WRITE REGISTER %1").arg(reg, 2, 16, '0'));
         m_errno = errno;
+        reportError(QString("COULD NOT WRITE REGISTER %1").arg(reg, 2, 16, '0'));
         return false;
     }
 
-    reportEvent(QString("WROTE TO REGISTER %1").arg(reg, 2, 16, '0'));
+    if(m_backendDebug && !m_initialized)
+        reportEvent(QString("WROTE TO REGISTER %1").arg(reg, 2, 16, '0'));
 
     return true;
 }
 
+// a wrong address fails here instead of later as register errors
 bool QVL53L0XBackend::confirmChipID()
 {
-    // quint8 data = 0;
+    quint8 data = 0;
 
-    // if(!readRegisterByte((quint8)Register::IDENTIFICATION_MODEL_ID, &data))
-    //     return false;
+    if(!readRegisterByte((quint8)Register::IDENTIFICATION_MODEL_ID, &data))
+        return false;
 
-    // return data == m_chipId;
+    if(data != m_chipId)
+    {
+        m_errno = ENODEV;
+        return false;
+    }
 
     return true;
 }
@@ -673,14 +976,18 @@ bool QVL53L0XBackend::getSpadInfo(quint8 &count, bool &isAperture)
     if(!writeRegisterByte(0x83, 0x00))
         return false;
 
-    qreal start = QDateTime::currentMSecsSinceEpoch();
+    QElapsedTimer timer;
+    timer.start();
 
     data = 0;
     while(data == 0x00)
     {
-        //timeout
-        if((QDateTime::currentMSecsSinceEpoch() - start) >= 25)
+        if(waitExpired(timer))
+        {
+            m_errno = ETIMEDOUT;
             return false;
+        }
+
         if(!readRegisterByte(0x83, &data))
             return false;
     }
@@ -719,7 +1026,9 @@ bool QVL53L0XBackend::getSpadInfo(quint8 &count, bool &isAperture)
     return true;
 }
 
-bool QVL53L0XBackend::readDistance()
+// starts a single shot measurement without waiting for it, the result is
+// picked up with readContinuous()
+bool QVL53L0XBackend::startRanging()
 {
     if(!writeRegisterByte(0x80, 0x01))
         return false;
@@ -739,146 +1048,2167 @@ bool QVL53L0XBackend::readDistance()
     if(!writeRegisterByte((quint8)Register::SYSRANGE_START, 0x01))
         return false;
 
-    // "Wait until start bit has been cleared"
-    qreal start = QDateTime::currentMSecsSinceEpoch();
-    quint8 data = 0x01;
+    return true;
+}
+
+// Bus thread, checks on the measurement poll() has started without waiting
+// for it. Returns false while it is still running, wait is set to the
+// milliseconds until it is worth checking again
+bool QVL53L0XBackend::collectMeasurement(int &wait)
+{
+    quint32 budget = m_measurementTimingBudget > 0 ? m_measurementTimingBudget : defaultTimingBudget;
+    qint64 elapsed = m_measurementTimer.nsecsElapsed() / 1000;
+    bool ready = false;
 
-    while (data & 0x01)
+    // the device can't be done before the timing budget has passed, the bus is left to the others until then
+    if(elapsed < budget)
     {
-        if ((QDateTime::currentMSecsSinceEpoch() - start) >= 25)
-            return false;
+        wait = static_cast<int>((budget - elapsed + 999) / 1000);
+        return false;
+    }
 
-        if(!readRegisterByte((quint8)Register::SYSRANGE_START, &data))
-            return false;
+    if(!readContinuous(ready))
+    {
+        m_measuring = false;
+        queueFault();
+        return true;
     }
 
-    data = 0;
-    start = QDateTime::currentMSecsSinceEpoch();
+    if(!ready)
+    {
+        if(waitExpired(m_measurementTimer))
+        {
+            m_errno = ETIMEDOUT;
+            m_measuring = false;
+            m_metrics.recordTimeout();
+            queueFault();
+            return true;
+        }
+
+        wait = 1;
+        return false;
+    }
+
+    m_measuring = false;
+
+    if(!beginRecalibration())
+    {
+        queueFault();
+        return true;
+    }
+
+    queueResult();
+
+    return true;
+}
+
+bool QVL53L0XBackend::startContinuous()
+{
+    if(!writeRegisterByte(0x80, 0x01))
+        return false;
+    if(!writeRegisterByte(0xFF, 0x01))
+        return false;
+    if(!writeRegisterByte(0x00, 0x00))
+        return false;
+    if(!writeRegisterByte(0x91, m_stopByte))
+        return false;
+    if(!writeRegisterByte(0x00, 0x01))
+        return false;
+    if(!writeRegisterByte(0xFF, 0x00))
+        return false;
+    if(!writeRegisterByte(0x80, 0x00))
+        return false;
 
-    while ((data & 0x07) == 0)
+    if(m_intermeasurementPeriod > 0)
     {
-        if ((QDateTime::currentMSecsSinceEpoch() - start) >= 25)
+        if(!writeIntermeasurementPeriod())
             return false;
 
-        if(!readRegisterByte((quint8)Register::RESULT_INTERRUPT_STATUS, &data))
+        // VL53L0X_REG_SYSRANGE_MODE_TIMED
+        if(!writeRegisterByte((quint8)Register::SYSRANGE_START, 0x04))
+            return false;
+    }
+    else
+    {
+        // VL53L0X_REG_SYSRANGE_MODE_BACKTOBACK
+        if(!writeRegisterByte((quint8)Register::SYSRANGE_START, 0x02))
             return false;
     }
 
-    // assumptions: Linearity Corrective Gain is 1000 (default);
-    // fractional ranging is not enabled
-    quint16 range = 0;
+    m_continuous = true;
+    m_changes &= ~IntermeasurementChange;
 
-    if(!readRegisterWord((quint8)Register::RESULT_RANGE_STATUS + 10, &range))
+    return true;
+}
+
+// VL53L0X_SetInterMeasurementPeriodMilliSeconds(), the period is programmed
+// in ticks of the internal oscillator. Timed ranging picks a new period up
+// with the next measurement, it does not have to be stopped for it
+bool QVL53L0XBackend::writeIntermeasurementPeriod()
+{
+    quint16 oscCalibrateValue = 0;
+    quint32 period = m_intermeasurementPeriod;
+
+    if(!readRegisterWord((quint8)Register::OSC_CALIBRATE_VAL, &oscCalibrateValue))
         return false;
 
-    if(!writeRegisterByte((quint8)Register::SYSTEM_INTERRUPT_CLEAR, 0x01))
+    if(oscCalibrateValue != 0)
+        period *= oscCalibrateValue;
+
+    if(!writeRegisterLong((quint8)Register::SYSTEM_INTERMEASUREMENT_PERIOD, period))
+        return false;
+
+    return true;
+}
+
+bool QVL53L0XBackend::stopContinuous()
+{
+    // VL53L0X_REG_SYSRANGE_MODE_SINGLESHOT
+    if(!writeRegisterByte((quint8)Register::SYSRANGE_START, 0x01))
+        return false;
+
+    if(!writeRegisterByte(0xFF, 0x01))
+        return false;
+    if(!writeRegisterByte(0x00, 0x00))
+        return false;
+    if(!writeRegisterByte(0x91, 0x00))
+        return false;
+    if(!writeRegisterByte(0x00, 0x01))
+        return false;
+    if(!writeRegisterByte(0xFF, 0x00))
         return false;
 
-    m_distance = range;
+    m_continuous = false;
 
     return true;
 }
 
-void QVL53L0XBackend::poll()
+// non blocking, ready is only set when a new result was read into m_result
+bool QVL53L0XBackend::readContinuous(bool &ready)
 {
-    //start i2c
-    if(!startI2C() || !readDistance() || !endI2C())
+    QElapsedTimer latency;
+    latency.start();
+
+    quint8 data = 0;
+    ready = false;
+
+    bool read = readRegisterByte((quint8)Register::RESULT_INTERRUPT_STATUS, &data);
+
+    if(read && (data & 0x07) != 0)
     {
-        m_errno = errno; //errno is not set by endI2C()
-        handleFault();
-        return;
+        read = readRegisterData((quint8)Register::RESULT_RANGE_STATUS, m_result, 12) &&
+            writeRegisterByte((quint8)Register::SYSTEM_INTERRUPT_CLEAR, 0x01);
+
+        ready = read;
     }
 
-    m_reading.setDistance(m_distance);
-    newReadingAvailable();
+    // the poll latency, with and without a result
+    m_metrics.recordPoll(latency.nsecsElapsed());
+
+    return read;
 }
 
-void QVL53L0XBackend::handleFault()
+// Bits a transfer puts on the bus: 9 clocks per byte with its ACK, the
+// address byte of each message and a clock for each (repeated) START and the STOP
+quint64 QVL53L0XBackend::transferBits(int written, int read)
 {
-    //TODO
+    quint64 bits = 1 + 9 * (1 + written);
+
+    if(read > 0)
+        bits += 1 + 9 * (1 + read);
+
+    return bits + 1;
 }
 
-bool QVL53L0XBackend::setSignalRateLimit(qreal limit)
+// Bits per second the poll path puts on the bus at the given data rate, the
+// load planner's cost model. Recalibrations are rare enough to be left to
+// the headroom the bus keeps, see QVL53L0XBus::maxOccupancy
+quint64 QVL53L0XBackend::busLoad(int rate) const
 {
-    if ((limit < 0 ) || (limit > 511.99)) { return false; }
+    quint64 status = transferBits(1, 1); //RESULT_INTERRUPT_STATUS
+    quint64 result = transferBits(1, 12) + transferBits(2, 0); //result block and SYSTEM_INTERRUPT_CLEAR
 
-    // Q9.7 fixed point format (9 integer bits, 7 fractional bits)
-    quint16 data = limit * (1 << 7);
+    // back to back ranging is polled twice per measurement, whatever the data rate
+    if(m_oversampling && !m_grouped)
+    {
+        quint32 budget = m_measurementTimingBudget > 0 ? m_measurementTimingBudget : defaultTimingBudget;
+        return (2000000 / budget) * status + (1000000 / budget) * result;
+    }
 
-    if(!writeRegisterWord((quint8)Register::FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT, data))
+    // timed ranging, one poll per measurement
+    if(m_lowPower && !m_grouped)
+        return rate * (status + result);
+
+    // single shot, the start sequence of startRanging() and usually two status reads
+    return rate * (8 * transferBits(2, 0) + 2 * status + result);
+}
+
+// Sensor thread, admission control for a data rate. Reserves the bus load of
+// the rate on the bus, or of the highest rate the other sensors on the bus
+// leave room for, and returns the rate reserved. Below 1 Hz nothing is
+// refused, the oversubscription shows in busOccupancy and is reported
+int QVL53L0XBackend::planDataRate(int rate)
+{
+    if(!m_busController || rate <= 0)
+        return rate;
+
+    quint64 available = m_busController->available(this);
+    int planned = rate;
+
+    while(planned > 1 && busLoad(planned) > available)
+        planned--;
+
+    m_busController->reserve(this, busLoad(planned));
+
+    if(planned != rate)
+        reportError(QString("DATA RATE %1 HZ OVERSUBSCRIBES THE BUS, DEGRADED TO %2 HZ").arg(rate).arg(planned));
+
+    if(busLoad(planned) > available)
+        reportError(QString("BUS OVERSUBSCRIBED (%1%)").arg(qRound(m_busController->occupancy() * 100)));
+
+    return planned;
+}
+
+// runs on the bus thread before the first poll()
+bool QVL53L0XBackend::beginPolling()
+{
+    // the bus stays open while polling
+    if(!startI2C() || (m_rangeContinuously && !startContinuous()))
+    {
+        reportError("COULD NOT START POLLING");
+        queueFault();
         return false;
+    }
 
     return true;
 }
 
-void QVL53L0XBackend::reportEvent(QString message)
+// runs on the bus thread after the last poll()
+void QVL53L0XBackend::endPolling()
 {
-    //report event if backendDebug is true
-    if(m_backendDebug)
-        qDebug() << QString("** %1 - (QVL53L0X@%2:0x%3)").arg(message, m_bus).arg(m_address, 2, 16);
+    // a single shot measurement still running finishes on its own
+    m_measuring = false;
+
+    if(m_continuous && !stopContinuous())
+        queueFault();
+
+    // VL53L0X_SetPowerMode(VL53L0X_POWERMODE_STANDBY_LEVEL1), the device idles
+    // in software standby until the next start()
+    if(m_lowPower && !writeRegisterByte((quint8)Register::POWER_MANAGEMENT_GO1_POWER_FORCE, 0x00))
+        queueFault();
+
+    endI2C();
 }
 
-void QVL53L0XBackend::reportError(QString message)
+int QVL53L0XBackend::pollInterval() const
 {
-    qDebug() << QString("!! ERROR: %1 - (QBMP280@%2:0x%3)").arg(message, m_bus).arg(m_address, 2, 16) << errno;
+    // continuous ranging is polled twice per measurement so no result is missed
+    if(m_oversampling)
+        return qMax<int>(1, m_measurementTimingBudget / 2000);
+
+    return m_pollInterval;
 }
 
-void QVL53L0XBackend::newLine()
+// In low power mode the device times the measurements, the result stays
+// latched until it is read, so the host wakeups can be coalesced with others
+Qt::TimerType QVL53L0XBackend::pollTimerType() const
 {
-    //add newline if backendDebug is true
-    if(m_backendDebug)
-        qDebug() << "";
+    if(!m_lowPower || m_oversampling)
+        return Qt::PreciseTimer;
+
+    // VeryCoarseTimer rounds to whole seconds
+    return m_pollInterval >= 1000 ? Qt::VeryCoarseTimer : Qt::CoarseTimer;
 }
 
-void QVL53L0XBackend::onSensorBusChanged()
+// Runs on the bus thread. Only talks to the device and queues the result,
+// decoding, capturing and emitting happen on the sensor thread in drain()
+void QVL53L0XBackend::poll()
 {
-    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+    if(m_rangeContinuously)
+    {
+        pollContinuous();
+        return;
+    }
 
-    if(!sensor)
+    // still measuring, the data rate is higher than the device can range
+    if(m_measuring)
         return;
 
-    m_bus = sensor->bus();
+    bool calibrating = false;
+
+    // configuration changes and recalibrations are applied between measurements
+    if(!finishRecalibration(calibrating))
+    {
+        queueFault();
+        return;
+    }
+
+    // the calibration is collected by the next poll
+    if(calibrating)
+        return;
+
+    if((m_changes && !applyChanges()) || !startRanging())
+    {
+        queueFault();
+        return;
+    }
+
+    // the bus thread moves on to the other sensors on the bus while this one
+    // measures, the result is picked up by collectMeasurement()
+    m_measuring = true;
+    m_measurementTimer.start();
+    m_busController->collect(this);
 }
 
-void QVL53L0XBackend::onSensorAddressChanged()
+// non blocking, the device ranges on its own, see startContinuous()
+void QVL53L0XBackend::pollContinuous()
 {
-    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+    bool ready = false;
 
-    if(!sensor)
+    if(m_calibrationState != CalibrationState::Idle || isRecalibrationDue())
+    {
+        pollRecalibration();
         return;
+    }
 
-    m_address = sensor->address();
+    // configuration changes only pause continuous ranging when they need a
+    // calibration, see applyChanges()
+    if((m_changes && !applyChanges()) || !readContinuous(ready))
+    {
+        queueFault();
+        return;
+    }
+
+    if(ready)
+        queueResult();
 }
 
-void QVL53L0XBackend::onSesnorDataRateChanged()
+// Calibrations need single shot mode, so recalibrations pause continuous
+// ranging. The VHV and phase calibrations are begun and collected over several
+// polls like in single shot mode, the bus thread serves the other sensors in
+// between. Ranging restarts once both are done.
+void QVL53L0XBackend::pollRecalibration()
 {
-    stop();
-    start();
+    bool calibrating = false;
+
+    if(m_continuous && !stopContinuous())
+    {
+        queueFault();
+        return;
+    }
+
+    if(!finishRecalibration(calibrating) || (!calibrating && !beginRecalibration()))
+    {
+        queueFault();
+        return;
+    }
+
+    // begun or still running, collected by a later poll
+    if(m_calibrationState != CalibrationState::Idle)
+        return;
+
+    if(!startContinuous())
+        queueFault();
 }
 
-// based on VL53L0X_perform_single_ref_calibration()
-bool QVL53L0XBackend::performSingleRefCalibration(quint8 vhvInitByte)
+// Hands an event to the sensor thread without allocating or locking. When the
+// sensor thread falls behind by a whole queue the event is dropped and counted.
+void QVL53L0XBackend::queueEvent(const Event &event)
+{
+    if(!m_events.push(event))
+    {
+        m_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    quint64 one = 1;
+
+    // EAGAIN only when the counter is saturated, the sensor thread is woken anyway
+    if(m_eventFd >= 0 && ::write(m_eventFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        reportError(QString("COULD NOT WAKE THE SENSOR THREAD (%1)").arg(strerror(errno)));
+}
+
+void QVL53L0XBackend::queueResult()
 {
-    if(!writeRegisterByte((quint8)Register::SYSRANGE_START, 0x01 | vhvInitByte))
-        return false;        // VL53L0X_REG_SYSRANGE_MODE_START_STOP
+    Event event;
+    event.type = Event::Result;
+    event.fractionalRanging = m_fractionalRanging;
+    event.sigmaTiming = m_sigmaTiming;
+    event.timestamp = timestamp();
+    memcpy(event.result, m_result, sizeof(event.result));
 
-    qreal start = QDateTime::currentMSecsSinceEpoch();
-    quint8 data = 0;
+    m_metrics.recordResult(decodeRangeStatus(m_result));
 
-    while((data & 0x07) == 0)
-    {
-        if((QDateTime::currentMSecsSinceEpoch() - start) >= 25)
-            return false;
+    queueEvent(event);
+}
 
-        if(!readRegisterByte((quint8)Register::RESULT_INTERRUPT_STATUS, &data))
-            return false;
+void QVL53L0XBackend::queueFault()
+{
+    Event event;
+    event.type = Event::Fault;
+    event.error = m_errno;
+    event.timestamp = timestamp();
+
+    queueEvent(event);
+}
+
+// sensor thread, handles everything the bus thread has queued since the last call
+void QVL53L0XBackend::drain()
+{
+    quint64 count = 0;
+
+    // EAGAIN when an earlier drain already took the events of this wakeup
+    if(m_eventFd >= 0 && ::read(m_eventFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        reportError(QString("COULD NOT READ THE EVENT COUNTER (%1)").arg(strerror(errno)));
+
+    Event event;
+
+    while(m_events.pop(event))
+    {
+        switch(event.type)
+        {
+        case Event::Result:
+            if(m_faultCount > 0)
+            {
+                reportEvent(QString("RECOVERED AFTER %1 FAULTS IN %2 MS").arg(m_faultCount).arg(m_faultTimer.elapsed()));
+                m_faultCount = 0;
+                m_recoveries = 0;
+                m_metrics.recordRecovery();
+            }
+
+            if(m_capture.isOpen())
+                m_capture.writeResult(event.timestamp, event.result);
+
+            recordSample(event.timestamp, event.result, event.fractionalRanging, event.sigmaTiming);
+
+            // fed every valid range, oversampled ones included
+            if(!m_grouped && decodeRangeStatus(event.result) == QVL53L0XReading::RangeValid)
+            {
+                qreal range = decodeRange(event.result, event.fractionalRanging);
+
+                if(m_adaptiveRate)
+                    adaptDataRate(event.timestamp, range);
+
+                if(m_kinematicsEnabled)
+                    m_kinematics.update(event.timestamp, range);
+            }
+
+            if(m_oversampling)
+            {
+                qreal signalRate = decodeSignalRate(event.result);
+                qreal ambientRate = decodeAmbientRate(event.result);
+                qreal sigma = estimateSigma(signalRate, ambientRate, event.sigmaTiming);
+
+                m_lastRangeStatus = checkLimits(decodeRangeStatus(event.result), sigma);
+
+                // samples with a bad range status are dropped, reported by reportOversampling()
+                if(m_lastRangeStatus != QVL53L0XReading::RangeValid || m_sampleCount >= m_samples.size())
+                    break;
+
+                m_samples[m_sampleCount++] = decodeRange(event.result, event.fractionalRanging);
+
+                // the report carries the signal quality of the last valid sample
+                m_reading.setSignalRate(signalRate);
+                m_reading.setAmbientRate(ambientRate);
+                m_reading.setSigma(sigma);
+                break;
+            }
+
+            m_reading.setTimestamp(event.timestamp);
+            decodeResult(event.result, event.fractionalRanging, event.sigmaTiming, &m_reading);
+            m_reading.setRangeStatus(checkLimits(m_reading.rangeStatus(), m_reading.sigma()));
+
+            if(m_rejectInvalidRanges && m_reading.rangeStatus() != QVL53L0XReading::RangeValid)
+                break;
+
+            publishReading();
+            break;
+
+        case Event::RangingModeChanged:
+            captureConfiguration(QVL53L0XCapture::LongRange, event.longRange);
+            captureConfiguration(QVL53L0XCapture::FractionalRanging, event.fractionalRanging);
+            captureConfiguration(QVL53L0XCapture::TimingBudget, event.timingBudget);
+            captureConfiguration(QVL53L0XCapture::VcselDuration, event.sigmaTiming.vcselDuration);
+            captureConfiguration(QVL53L0XCapture::IntegrationTime, event.sigmaTiming.integrationTime);
+
+            reportEvent(QString("RANGING MODE SET (LONG RANGE: %1, FRACTIONAL: %2, TIMING BUDGET: %3 US)").arg(event.longRange).arg(event.fractionalRanging).arg(event.timingBudget));
+            break;
+
+        case Event::Calibrated:
+            recalibrated();
+            break;
+
+        case Event::Fault:
+            m_errno = event.error;
+            handleFault();
+            break;
+        }
     }
 
-    if(!writeRegisterByte((quint8)Register::SYSRANGE_START, 0x01))
-        return false;
+    quint32 dropped = m_droppedEvents.exchange(0, std::memory_order_relaxed);
 
-    if(!writeRegisterByte((quint8)Register::SYSRANGE_START, 0x00))
-        return false;
+    if(dropped > 0)
+        reportError(QString("DROPPED %1 EVENTS").arg(dropped));
+}
 
-    return true;
+// ST's high accuracy, default and high speed presets. The longest one that
+// leaves the poll interval some room for the transfers
+quint32 QVL53L0XBackend::timingBudgetPreset(int rate)
+{
+    quint32 interval = 1000000 / qMax(1, rate);
+
+    for(quint32 budget : { 200000u, 33000u })
+    {
+        if(budget + 5000 <= interval)
+            return budget;
+    }
+
+    return 20000;
+}
+
+// Sensor thread. Follows the speed of the target and moves dataRate, and the
+// timing budget with it, between the minimum and maximum rate: up as soon as
+// the target speeds up, down once it has been slower for adaptiveHoldTime so
+// a short pause does not cost the samples of the next movement
+void QVL53L0XBackend::adaptDataRate(quint64 timestamp, qreal range)
+{
+    if(m_motionTimestamp == 0 || timestamp <= m_motionTimestamp)
+    {
+        m_smoothedRange = range;
+        m_motionTimestamp = timestamp;
+        return;
+    }
+
+    // exponential moving averages, smoothing the range first keeps the
+    // ranging noise of a static scene from reading as motion
+    qreal elapsed = (timestamp - m_motionTimestamp) / 1000000.0;
+    qreal smoothed = m_smoothedRange + (range - m_smoothedRange) * 0.3;
+
+    m_motion += (qAbs(smoothed - m_smoothedRange) / elapsed - m_motion) * 0.3;
+    m_smoothedRange = smoothed;
+    m_motionTimestamp = timestamp;
+
+    int minimum = qMin(m_minimumDataRate, m_maximumDataRate);
+    int target = minimum + qRound((m_maximumDataRate - minimum) * qMin<qreal>(1, m_motion / m_motionThreshold));
+
+    if(target >= m_adaptiveTarget || !m_stillTimer.isValid())
+        m_stillTimer.start();
+
+    // steps of an eighth of the range, so the poll is not retimed every sample
+    int step = qMax(1, (m_maximumDataRate - minimum) / 8);
+
+    if(qAbs(target - m_adaptiveTarget) < step && target != minimum && target != m_maximumDataRate)
+        return;
+
+    if(target == m_adaptiveTarget || (target < m_adaptiveTarget && m_stillTimer.elapsed() < adaptiveHoldTime))
+        return;
+
+    m_adaptiveTarget = target;
+
+    quint32 budget = timingBudgetPreset(target);
+
+    updateIO([this, budget]()
+    {
+        m_requestedTimingBudget = budget;
+        m_changes = budget != m_measurementTimingBudget ? (m_changes | TimingBudgetChange) : (m_changes & ~TimingBudgetChange);
+    });
+
+    sensor()->setDataRate(target);
+}
+
+// Sensor thread, keeps every measurement in the history, whether it is
+// emitted, averaged or rejected
+void QVL53L0XBackend::recordSample(quint64 timestamp, const quint8 *result, bool fractionalRanging, const SigmaTiming &timing)
+{
+    if(m_history.empty())
+        return;
+
+    QVL53L0XSample &sample = m_history[m_historyHead++ % m_history.size()];
+    quint16 range = static_cast<quint16>((result[10] << 8) | result[11]);
+    QVL53L0XReading::RangeStatus status = decodeRangeStatus(result);
+
+    // the sigma estimate is only needed for the sigma check
+    if(m_sigmaLimit > 0)
+        status = checkLimits(status, estimateSigma(decodeSignalRate(result), decodeAmbientRate(result), timing));
+
+    sample.timestamp = timestamp;
+    sample.range = fractionalRanging ? range : static_cast<quint16>(range * 4);
+    sample.signalRate = static_cast<quint16>((result[6] << 8) | result[7]);
+    sample.ambientRate = static_cast<quint16>((result[8] << 8) | result[9]);
+    sample.rangeStatus = static_cast<quint8>(status);
+    sample.reserved = 0;
+}
+
+// at most two copies, the ring wraps at most once
+qsizetype QVL53L0XBackend::copySamples(QVL53L0XSample *buffer, qsizetype count, quint64 *cursor) const
+{
+    quint64 capacity = m_history.size();
+
+    if(!buffer || count <= 0 || capacity == 0)
+        return 0;
+
+    quint64 oldest = m_historyHead > capacity ? m_historyHead - capacity : 0;
+    quint64 first = cursor ? qBound(oldest, *cursor, m_historyHead) : oldest;
+    quint64 copied = qMin<quint64>(m_historyHead - first, static_cast<quint64>(count));
+
+    // without a cursor the latest samples are the interesting ones
+    if(!cursor)
+        first = m_historyHead - copied;
+
+    quint64 start = first % capacity;
+    quint64 head = qMin(copied, capacity - start);
+
+    memcpy(buffer, &m_history[start], head * sizeof(QVL53L0XSample));
+    memcpy(buffer + head, m_history.data(), (copied - head) * sizeof(QVL53L0XSample));
+
+    if(cursor)
+        *cursor = first + copied;
+
+    return static_cast<qsizetype>(copied);
+}
+
+// read by the exporter, the counters are atomic
+const QVL53L0XMetrics &QVL53L0XBackend::metrics() const
+{
+    return m_metrics;
+}
+
+void QVL53L0XBackend::reportOversampling()
+{
+    m_reading.setTimestamp(timestamp());
+    m_reading.setSampleCount(m_sampleCount);
+
+    // nothing valid in this interval, report the reason and keep the last range
+    if(m_sampleCount == 0)
+    {
+        if(m_rejectInvalidRanges)
+            return;
+
+        m_reading.setRangeStatus(m_lastRangeStatus);
+        m_reading.setDistanceVariance(0);
+        publishReading();
+        return;
+    }
+
+    qreal sum = 0;
+
+    for(size_t i = 0; i < m_sampleCount; i++)
+        sum += m_samples[i];
+
+    qreal mean = sum / m_sampleCount;
+    qreal squares = 0;
+
+    for(size_t i = 0; i < m_sampleCount; i++)
+        squares += (m_samples[i] - mean) * (m_samples[i] - mean);
+
+    // partial sort in place, the buffer is refilled after the report anyway
+    auto first = m_samples.begin();
+    auto last = first + m_sampleCount;
+    auto middle = first + m_sampleCount / 2;
+
+    std::nth_element(first, middle, last);
+    qreal median = *middle;
+
+    if(m_sampleCount % 2 == 0)
+        median = (median + *std::max_element(first, middle)) / 2;
+
+    m_reading.setDistance(qRound(mean));
+    m_reading.setPreciseDistance(mean);
+    m_reading.setMeanDistance(mean);
+    m_reading.setMedianDistance(median);
+    m_reading.setDistanceVariance(m_sampleCount > 1 ? squares / (m_sampleCount - 1) : 0);
+    m_reading.setRangeStatus(QVL53L0XReading::RangeValid);
+
+    m_sampleCount = 0;
+
+    publishReading();
+}
+
+void QVL53L0XBackend::publishReading()
+{
+    if(m_kinematicsEnabled)
+        updateKinematics();
+
+    // shared memory consumers get every reading and decide on their own
+    if(m_sharedMemory.isOpen())
+        m_sharedMemory.publish(&m_reading);
+
+    if(isDuplicate())
+        return;
+
+    newReadingAvailable();
+}
+
+// Sensor thread, copies the kinematics into the reading and moves the
+// sensor's motion on. A motion is entered at approachThreshold and left below
+// half of it, so a speed around the threshold does not flip it every reading
+void QVL53L0XBackend::updateKinematics()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    m_reading.setVelocity(m_kinematics.velocity());
+    m_reading.setAcceleration(m_kinematics.acceleration());
+    m_reading.setTimeToContact(m_kinematics.timeToContact());
+
+    if(!sensor || !m_kinematics.isValid())
+        return;
+
+    qreal velocity = m_kinematics.velocity();
+    QVL53L0X::Motion motion = sensor->motion();
+
+    if(velocity <= -m_approachThreshold)
+        motion = QVL53L0X::Approaching;
+    else if(velocity >= m_approachThreshold)
+        motion = QVL53L0X::Retreating;
+    else if(motion == QVL53L0X::Approaching && velocity > -m_approachThreshold / 2)
+        motion = QVL53L0X::Stationary;
+    else if(motion == QVL53L0X::Retreating && velocity < m_approachThreshold / 2)
+        motion = QVL53L0X::Stationary;
+
+    sensor->setMotion(motion);
+}
+
+// decides whether the reading is worth a readingChanged(), records it as the last emitted one if so
+bool QVL53L0XBackend::isDuplicate()
+{
+    if(!m_skipDuplicates && m_deadband <= 0)
+        return false;
+
+    bool changed = m_reading.rangeStatus() != m_lastEmittedRangeStatus;
+    qreal delta = qAbs(m_reading.preciseDistance() - m_lastEmittedDistance);
+
+    // without a deadband only readings with the exact same range are skipped
+    if(m_deadband > 0)
+        changed |= delta > m_deadband;
+    else
+        changed |= delta > 0;
+
+    // the heartbeat lets consumers tell a static scene from a dead sensor
+    bool silent = m_heartbeat > 0 && m_reading.timestamp() - m_lastEmittedTimestamp >= m_heartbeat;
+
+    if(!changed && !silent && m_lastEmittedTimestamp != 0)
+        return true;
+
+    m_lastEmittedDistance = m_reading.preciseDistance();
+    m_lastEmittedRangeStatus = m_reading.rangeStatus();
+    m_lastEmittedTimestamp = m_reading.timestamp();
+
+    return false;
+}
+
+// decodes the RESULT_RANGE_STATUS block, based on VL53L0X_GetRangingMeasurementData()
+void QVL53L0XBackend::decodeResult(const quint8 *result, bool fractionalRanging, const SigmaTiming &timing, QVL53L0XReading *reading)
+{
+    qreal range = decodeRange(result, fractionalRanging);
+    qreal signalRate = decodeSignalRate(result);
+    qreal ambientRate = decodeAmbientRate(result);
+
+    reading->setDistance(static_cast<quint32>(range));
+    reading->setPreciseDistance(range);
+    reading->setRangeStatus(decodeRangeStatus(result));
+    reading->setSignalRate(signalRate);
+    reading->setAmbientRate(ambientRate);
+    reading->setSigma(estimateSigma(signalRate, ambientRate, timing));
+
+    // a single sample, oversampling replaces these with the statistics of the interval
+    reading->setMeanDistance(range);
+    reading->setMedianDistance(range);
+    reading->setDistanceVariance(0);
+    reading->setSampleCount(1);
+}
+
+// range in mm
+qreal QVL53L0XBackend::decodeRange(const quint8 *result, bool fractionalRanging)
+{
+    // assumptions: Linearity Corrective Gain is 1000 (default)
+    // with fractional ranging enabled the range is reported in quarter mm
+    quint16 range = static_cast<quint16>((result[10] << 8) | result[11]);
+
+    return fractionalRanging ? range / 4.0 : range;
+}
+
+// return signal rate in MCPS, Q9.7 fixed point
+qreal QVL53L0XBackend::decodeSignalRate(const quint8 *result)
+{
+    return static_cast<quint16>((result[6] << 8) | result[7]) / 128.0;
+}
+
+// ambient rate in MCPS, Q9.7 fixed point
+qreal QVL53L0XBackend::decodeAmbientRate(const quint8 *result)
+{
+    return static_cast<quint16>((result[8] << 8) | result[9]) / 128.0;
+}
+
+// Range uncertainty in mm, based on VL53L0X_calc_sigma_estimate(). The
+// effective pulse width, widened by the ambient light, is spread over the
+// events returned while the VCSEL fires, combined with the reference sigma
+// of the integration time. Crosstalk compensation is left out, which makes
+// the API's pulse width multiplier 1
+qreal QVL53L0XBackend::estimateSigma(qreal signalRate, qreal ambientRate, const SigmaTiming &timing)
+{
+    const qreal pulseWidth = 8;                 //ns, cPulseEffectiveWidth_centi_ns
+    const qreal ambientWidth = 6;               //ns, cAmbientEffectiveWidth_centi_ns
+    const qreal ambientRatioMax = 102.4;        //cAmbToSignalRatioMax
+    const qreal speedOfLight = 0.2997;          //m/ns, VL53L0X_SPEED_OF_LIGHT_IN_AIR
+    const qreal sigmaReturnMax = 0.9375;        //m, cSigmaEstRtnMax
+    const qreal defaultIntegrationTime = 33;    //ms, cDfltFinalRangeIntegrationTimeMilliSecs
+    const qreal sigmaMax = 655.53;              //mm, cSigmaEstMax
+
+    if(signalRate <= 0 || timing.vcselDuration == 0 || timing.integrationTime == 0)
+        return sigmaMax;
+
+    // MCPS * us
+    qreal events = qMax<qreal>(1, signalRate * timing.vcselDuration);
+    qreal ambient = qMin(ambientRate / signalRate, ambientRatioMax) * ambientWidth;
+    qreal width = qSqrt(pulseWidth * pulseWidth + ambient * ambient);
+    qreal sigmaReturn = qMin(sigmaReturnMax, width / (2 * qSqrt(12 * events)) * speedOfLight);
+
+    // cSigmaEstRef, the API keeps it in 16.16 fixed point after scaling it by 256 / 1000
+    qreal integrationTime = timing.integrationTime / 1000.0;
+    qreal sigmaReference = qSqrt((defaultIntegrationTime + integrationTime / 2) / integrationTime) * 0.256 / 65536;
+
+    return qMin(sigmaMax, 1000 * qSqrt(sigmaReturn * sigmaReturn + sigmaReference * sigmaReference));
+}
+
+// based on VL53L0X_get_pal_range_status(), without the host side limit checks
+QVL53L0XReading::RangeStatus QVL53L0XBackend::decodeRangeStatus(const quint8 *result)
+{
+    switch((result[0] & 0x78) >> 3)
+    {
+    case 1:
+    case 2:
+    case 3:
+        return QVL53L0XReading::HardwareFail;
+    case 4:
+        return QVL53L0XReading::SignalFail;
+    case 6:
+    case 9:
+        return QVL53L0XReading::PhaseFail;
+    case 8:
+    case 10:
+        return QVL53L0XReading::MinRangeFail;
+    case 11:
+        return QVL53L0XReading::RangeValid;
+    default:
+        return QVL53L0XReading::NoUpdate;
+    }
+}
+
+// host side part of the limit checks, the device has already applied the signal rate limit
+QVL53L0XReading::RangeStatus QVL53L0XBackend::checkLimits(QVL53L0XReading::RangeStatus status, qreal sigma) const
+{
+    if(status == QVL53L0XReading::RangeValid && m_sigmaLimit > 0 && sigma > m_sigmaLimit)
+        return QVL53L0XReading::SigmaFail;
+
+    return status;
+}
+
+// microseconds since epoch, used for reading and capture timestamps
+quint64 QVL53L0XBackend::timestamp()
+{
+    return static_cast<quint64>(QDateTime::currentMSecsSinceEpoch()) * 1000;
+}
+
+// Sensor thread. A failed poll is reported and skipped, faultTolerance of them
+// in a row, or a failed bring up, restart the sensor with recover(). Restarts
+// that fail again back off up to maxRecoveryDelay
+void QVL53L0XBackend::handleFault()
+{
+    if(m_faultCount++ == 0)
+        m_faultTimer.start();
+
+    sensorError(m_errno);
+
+    if(!m_active || m_initializing || m_recoveryTimer->isActive())
+        return;
+
+    if(m_polling && m_faultCount < faultTolerance)
+        return;
+
+    int delay = qMin(maxRecoveryDelay, 10 << qMin(m_recoveries, 10));
+    m_recoveries++;
+
+    m_recoveryTimer->start(delay);
+}
+
+bool QVL53L0XBackend::setSignalRateLimit(qreal limit)
+{
+    if ((limit < 0 ) || (limit > 511.99)) { return false; }
+
+    // Q9.7 fixed point format (9 integer bits, 7 fractional bits)
+    quint16 data = limit * (1 << 7);
+
+    if(!writeRegisterWord((quint8)Register::FINAL_RANGE_CONFIG_MIN_COUNT_RATE_RTN_LIMIT, data))
+        return false;
+
+    return true;
+}
+
+// based on VL53L0X_set_measurement_timing_budget_micro_seconds()
+bool QVL53L0XBackend::setMeasurementTimingBudget(quint32 budget)
+{
+    SequenceStepEnables enables;
+    SequenceStepTimeouts timeouts;
+
+    const quint16 startOverhead      = 1910;
+    const quint16 endOverhead        = 960;
+    const quint16 msrcOverhead       = 660;
+    const quint16 tccOverhead        = 590;
+    const quint16 dssOverhead        = 690;
+    const quint16 preRangeOverhead   = 660;
+    const quint16 finalRangeOverhead = 550;
+
+    quint32 usedBudget = startOverhead + endOverhead;
+
+    if(!getSequenceStepEnables(enables))
+        return false;
+    if(!getSequenceStepTimeouts(enables, timeouts))
+        return false;
+
+    if(enables.tcc)
+        usedBudget += (timeouts.msrcDssTccMicroseconds + tccOverhead);
+
+    if(enables.dss)
+        usedBudget += 2 * (timeouts.msrcDssTccMicroseconds + dssOverhead);
+    else if(enables.msrc)
+        usedBudget += (timeouts.msrcDssTccMicroseconds + msrcOverhead);
+
+    if(enables.preRange)
+        usedBudget += (timeouts.preRangeMicroseconds + preRangeOverhead);
+
+    if(enables.finalRange)
+    {
+        usedBudget += finalRangeOverhead;
+
+        // "Note that the final range timeout is determined by the timing
+        // budget and the sum of all other timeouts within the sequence.
+        // If there is no room for the final range timeout, then an error
+        // will be set. Otherwise the remaining time will be applied to
+        // the final range."
+        if(usedBudget > budget)
+        {
+            reportError("REQUESTED TIMING BUDGET TOO SMALL");
+            return false;
+        }
+
+        quint32 finalRangeTimeoutMclks = timeoutMicrosecondsToMclks(budget - usedBudget, timeouts.finalRangeVcselPeriodPclks);
+
+        timeouts.finalRangeMclks = finalRangeTimeoutMclks;
+        timeouts.finalRangeMicroseconds = timeoutMclksToMicroseconds(finalRangeTimeoutMclks, timeouts.finalRangeVcselPeriodPclks);
+
+        // "For the final range timeout, the pre-range timeout must be added."
+        if(enables.preRange)
+            finalRangeTimeoutMclks += timeouts.preRangeMclks;
+
+        if(!writeRegisterWord((quint8)Register::FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI, encodeTimeout(finalRangeTimeoutMclks)))
+            return false;
+
+        m_measurementTimingBudget = budget;
+        m_sigmaTiming = sigmaTiming(timeouts);
+    }
+
+    return true;
+}
+
+// based on VL53L0X_get_measurement_timing_budget_micro_seconds()
+bool QVL53L0XBackend::getMeasurementTimingBudget(quint32 &budget)
+{
+    SequenceStepEnables enables;
+    SequenceStepTimeouts timeouts;
+
+    const quint16 startOverhead      = 1910;
+    const quint16 endOverhead        = 960;
+    const quint16 msrcOverhead       = 660;
+    const quint16 tccOverhead        = 590;
+    const quint16 dssOverhead        = 690;
+    const quint16 preRangeOverhead   = 660;
+    const quint16 finalRangeOverhead = 550;
+
+    budget = startOverhead + endOverhead;
+
+    if(!getSequenceStepEnables(enables))
+        return false;
+    if(!getSequenceStepTimeouts(enables, timeouts))
+        return false;
+
+    if(enables.tcc)
+        budget += (timeouts.msrcDssTccMicroseconds + tccOverhead);
+
+    if(enables.dss)
+        budget += 2 * (timeouts.msrcDssTccMicroseconds + dssOverhead);
+    else if(enables.msrc)
+        budget += (timeouts.msrcDssTccMicroseconds + msrcOverhead);
+
+    if(enables.preRange)
+        budget += (timeouts.preRangeMicroseconds + preRangeOverhead);
+
+    if(enables.finalRange)
+        budget += (timeouts.finalRangeMicroseconds + finalRangeOverhead);
+
+    return true;
+}
+
+// based on VL53L0X_set_vcsel_pulse_period()
+bool QVL53L0XBackend::setVcselPulsePeriod(VcselPeriodType type, quint8 periodPclks)
+{
+    quint8 vcselPeriod = encodeVcselPeriod(periodPclks);
+    quint8 sequenceConfig = 0;
+
+    SequenceStepEnables enables;
+    SequenceStepTimeouts timeouts;
+
+    if(!getSequenceStepEnables(enables))
+        return false;
+    if(!getSequenceStepTimeouts(enables, timeouts))
+        return false;
+
+    if(type == VcselPeriodType::PreRange)
+    {
+        // "Set phase check limits"
+        switch(periodPclks)
+        {
+        case 12:
+            if(!writeRegisterByte((quint8)Register::PRE_RANGE_CONFIG_VALID_PHASE_HIGH, 0x18))
+                return false;
+            break;
+        case 14:
+            if(!writeRegisterByte((quint8)Register::PRE_RANGE_CONFIG_VALID_PHASE_HIGH, 0x30))
+                return false;
+            break;
+        case 16:
+            if(!writeRegisterByte((quint8)Register::PRE_RANGE_CONFIG_VALID_PHASE_HIGH, 0x40))
+                return false;
+            break;
+        case 18:
+            if(!writeRegisterByte((quint8)Register::PRE_RANGE_CONFIG_VALID_PHASE_HIGH, 0x50))
+                return false;
+            break;
+        default:
+            reportError("INVALID PRE RANGE VCSEL PERIOD");
+            return false;
+        }
+
+        if(!writeRegisterByte((quint8)Register::PRE_RANGE_CONFIG_VALID_PHASE_LOW, 0x08))
+            return false;
+
+        // apply new VCSEL period
+        if(!writeRegisterByte((quint8)Register::PRE_RANGE_CONFIG_VCSEL_PERIOD, vcselPeriod))
+            return false;
+
+        // update timeouts
+        quint16 preRangeTimeoutMclks = timeoutMicrosecondsToMclks(timeouts.preRangeMicroseconds, periodPclks);
+
+        if(!writeRegisterWord((quint8)Register::PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI, encodeTimeout(preRangeTimeoutMclks)))
+            return false;
+
+        quint16 msrcTimeoutMclks = timeoutMicrosecondsToMclks(timeouts.msrcDssTccMicroseconds, periodPclks);
+
+        if(!writeRegisterByte((quint8)Register::MSRC_CONFIG_TIMEOUT_MACROP, (msrcTimeoutMclks > 256) ? 255 : (msrcTimeoutMclks - 1)))
+            return false;
+    }
+    else
+    {
+        // "Set phase check limits" and the matching phase calibration settings
+        quint8 phaseHigh = 0;
+        quint8 vcselWidth = 0;
+        quint8 phaseCalTimeout = 0;
+        quint8 phaseCalLimit = 0;
+
+        switch(periodPclks)
+        {
+        case 8:
+            phaseHigh = 0x10;
+            vcselWidth = 0x02;
+            phaseCalTimeout = 0x0C;
+            phaseCalLimit = 0x30;
+            break;
+        case 10:
+            phaseHigh = 0x28;
+            vcselWidth = 0x03;
+            phaseCalTimeout = 0x09;
+            phaseCalLimit = 0x20;
+            break;
+        case 12:
+            phaseHigh = 0x38;
+            vcselWidth = 0x03;
+            phaseCalTimeout = 0x08;
+            phaseCalLimit = 0x20;
+            break;
+        case 14:
+            phaseHigh = 0x48;
+            vcselWidth = 0x03;
+            phaseCalTimeout = 0x07;
+            phaseCalLimit = 0x20;
+            break;
+        default:
+            reportError("INVALID FINAL RANGE VCSEL PERIOD");
+            return false;
+        }
+
+        if(!writeRegisterByte((quint8)Register::FINAL_RANGE_CONFIG_VALID_PHASE_HIGH, phaseHigh))
+            return false;
+        if(!writeRegisterByte((quint8)Register::FINAL_RANGE_CONFIG_VALID_PHASE_LOW, 0x08))
+            return false;
+        if(!writeRegisterByte((quint8)Register::GLOBAL_CONFIG_VCSEL_WIDTH, vcselWidth))
+            return false;
+        if(!writeRegisterByte((quint8)Register::ALGO_PHASECAL_CONFIG_TIMEOUT, phaseCalTimeout))
+            return false;
+        if(!writeRegisterByte(0xFF, 0x01))
+            return false;
+        if(!writeRegisterByte((quint8)Register::ALGO_PHASECAL_LIM, phaseCalLimit))
+            return false;
+        if(!writeRegisterByte(0xFF, 0x00))
+            return false;
+
+        // apply new VCSEL period
+        if(!writeRegisterByte((quint8)Register::FINAL_RANGE_CONFIG_VCSEL_PERIOD, vcselPeriod))
+            return false;
+
+        // update timeouts, "for the final range timeout, the pre-range timeout must be added"
+        quint32 finalRangeTimeoutMclks = timeoutMicrosecondsToMclks(timeouts.finalRangeMicroseconds, periodPclks);
+
+        if(enables.preRange)
+            finalRangeTimeoutMclks += timeouts.preRangeMclks;
+
+        if(!writeRegisterWord((quint8)Register::FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI, encodeTimeout(finalRangeTimeoutMclks)))
+            return false;
+    }
+
+    // "Finally, the timing budget must be re-applied"
+    if(!setMeasurementTimingBudget(m_measurementTimingBudget))
+        return false;
+
+    // "Perform the phase calibration. This is needed after changing on vcsel period."
+    if(!readRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, &sequenceConfig))
+        return false;
+    if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0x02))
+        return false;
+    if(!performSingleRefCalibration(0x00))
+        return false;
+    if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, sequenceConfig))
+        return false;
+
+    return true;
+}
+
+// based on VL53L0X_get_vcsel_pulse_period()
+bool QVL53L0XBackend::getVcselPulsePeriod(VcselPeriodType type, quint8 &periodPclks)
+{
+    quint8 data = 0;
+    Register reg = type == VcselPeriodType::PreRange ? Register::PRE_RANGE_CONFIG_VCSEL_PERIOD : Register::FINAL_RANGE_CONFIG_VCSEL_PERIOD;
+
+    if(!readRegisterByte((quint8)reg, &data))
+        return false;
+
+    periodPclks = decodeVcselPeriod(data);
+
+    return true;
+}
+
+// based on VL53L0X_GetSequenceStepEnables()
+bool QVL53L0XBackend::getSequenceStepEnables(SequenceStepEnables &enables)
+{
+    quint8 sequenceConfig = 0;
+
+    if(!readRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, &sequenceConfig))
+        return false;
+
+    enables.tcc          = (sequenceConfig >> 4) & 0x1;
+    enables.dss          = (sequenceConfig >> 3) & 0x1;
+    enables.msrc         = (sequenceConfig >> 2) & 0x1;
+    enables.preRange     = (sequenceConfig >> 6) & 0x1;
+    enables.finalRange   = (sequenceConfig >> 7) & 0x1;
+
+    return true;
+}
+
+// based on get_sequence_step_timeout(), but gets all timeouts instead of
+// just the requested one, and also stores intermediate values
+bool QVL53L0XBackend::getSequenceStepTimeouts(const SequenceStepEnables &enables, SequenceStepTimeouts &timeouts)
+{
+    quint8 data = 0;
+    quint16 timeout = 0;
+    quint8 period = 0;
+
+    if(!getVcselPulsePeriod(VcselPeriodType::PreRange, period))
+        return false;
+
+    timeouts.preRangeVcselPeriodPclks = period;
+
+    if(!readRegisterByte((quint8)Register::MSRC_CONFIG_TIMEOUT_MACROP, &data))
+        return false;
+
+    timeouts.msrcDssTccMclks = data + 1;
+    timeouts.msrcDssTccMicroseconds = timeoutMclksToMicroseconds(timeouts.msrcDssTccMclks, timeouts.preRangeVcselPeriodPclks);
+
+    if(!readRegisterWord((quint8)Register::PRE_RANGE_CONFIG_TIMEOUT_MACROP_HI, &timeout))
+        return false;
+
+    timeouts.preRangeMclks = decodeTimeout(timeout);
+    timeouts.preRangeMicroseconds = timeoutMclksToMicroseconds(timeouts.preRangeMclks, timeouts.preRangeVcselPeriodPclks);
+
+    if(!getVcselPulsePeriod(VcselPeriodType::FinalRange, period))
+        return false;
+
+    timeouts.finalRangeVcselPeriodPclks = period;
+
+    if(!readRegisterWord((quint8)Register::FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI, &timeout))
+        return false;
+
+    timeouts.finalRangeMclks = decodeTimeout(timeout);
+
+    if(enables.preRange)
+        timeouts.finalRangeMclks -= timeouts.preRangeMclks;
+
+    timeouts.finalRangeMicroseconds = timeoutMclksToMicroseconds(timeouts.finalRangeMclks, timeouts.finalRangeVcselPeriodPclks);
+
+    return true;
+}
+
+bool QVL53L0XBackend::applyRangingMode(bool rewrite)
+{
+    // long range lowers the return signal rate limit to 0.1 MCPS and
+    // extends the laser pulse periods to 18 (pre range) and 14 (final range) PCLKs.
+    // A signal rate limit set on the sensor replaces the mode's default
+    qreal signalRateLimit = m_signalRateLimit > 0 ? m_signalRateLimit : (m_longRange ? 0.1 : 0.25);
+    quint8 preRangePeriod = m_longRange ? 18 : 14;
+    quint8 finalRangePeriod = m_longRange ? 14 : 10;
+    quint8 currentPreRangePeriod = 0;
+    quint8 currentFinalRangePeriod = 0;
+
+    if(!getVcselPulsePeriod(VcselPeriodType::PreRange, currentPreRangePeriod) ||
+        !getVcselPulsePeriod(VcselPeriodType::FinalRange, currentFinalRangePeriod))
+        return false;
+
+    // only touch the vcsel periods when they change, each change needs a
+    // phase calibration and with it single shot mode. A rewrite sets them
+    // again, after a tuning has overwritten the registers derived from them
+    bool writePreRange = rewrite || currentPreRangePeriod != preRangePeriod;
+    bool writeFinalRange = rewrite || currentFinalRangePeriod != finalRangePeriod;
+    bool periodsChanged = writePreRange || writeFinalRange;
+    bool resume = periodsChanged && m_continuous;
+
+    if(resume && !stopContinuous())
+        return false;
+
+    if(!setSignalRateLimit(signalRateLimit))
+        return false;
+
+    if(writePreRange && !setVcselPulsePeriod(VcselPeriodType::PreRange, preRangePeriod))
+        return false;
+
+    if(writeFinalRange && !setVcselPulsePeriod(VcselPeriodType::FinalRange, finalRangePeriod))
+        return false;
+
+    // SYSTEM_RANGE_CONFIG bit 0 enables fractional (0.25mm) ranging
+    if(!writeRegisterByte((quint8)Register::SYSTEM_RANGE_CONFIG, m_fractionalRanging ? 0x01 : 0x00))
+        return false;
+
+    if(resume && !startContinuous())
+        return false;
+
+    m_changes &= ~RangingModeChange;
+
+    queueRangingModeChanged();
+
+    return true;
+}
+
+// captured and reported by the sensor thread
+void QVL53L0XBackend::queueRangingModeChanged()
+{
+    Event event;
+    event.type = Event::RangingModeChanged;
+    event.longRange = m_longRange;
+    event.fractionalRanging = m_fractionalRanging;
+    event.timingBudget = m_measurementTimingBudget;
+    event.sigmaTiming = m_sigmaTiming;
+    event.timestamp = timestamp();
+
+    queueEvent(event);
+}
+
+// VL53L0X_SetDeviceAddress(), the register takes the 7 bit address the
+// transfers use. The device answers on the new address right away,
+// calibration and configuration are kept
+bool QVL53L0XBackend::applyAddress()
+{
+    if(!writeRegisterByte((quint8)Register::I2C_SLAVE_DEVICE_ADDRESS, m_pendingAddress & 0x7F))
+        return false;
+
+    m_address = m_pendingAddress;
+    m_changes &= ~AddressChange;
+
+    if(m_i2c >= 0 && ioctl(m_i2c, I2C_SLAVE, m_address) < 0)
+    {
+        reportError("DEVICE NOT FOUND");
+        m_errno = errno;
+
+        return false;
+    }
+
+    reportEvent("DEVICE READDRESSED");
+
+    return true;
+}
+
+// Bus thread. Switches the tuning profile in single shot mode, then sets
+// again what the profile may have overwritten: the sequence config, the
+// ranging mode and with it the timing budget. The reference calibration is
+// redone by the next poll
+bool QVL53L0XBackend::applyTuning()
+{
+    quint8 sequenceConfig = 0;
+
+    // against the image on the device, profiles selected in between that
+    // never reached it don't matter
+    QVL53L0XTuning change = m_pendingTuning.difference(m_tuning);
+
+    m_changes &= ~TuningChange;
+
+    if(change.isEmpty())
+        return true;
+
+    if((m_continuous && !stopContinuous()) ||
+        !readRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, &sequenceConfig) ||
+        !writeTuning(change) ||
+        !writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, sequenceConfig) ||
+        !applyRangingMode(true) ||
+        (m_rangeContinuously && !m_continuous && !startContinuous()))
+        return false;
+
+    m_tuning = m_pendingTuning;
+    m_calibrationRequested = true;
+
+    reportEvent(QString("TUNING SET TO %1 (%2 WRITES)").arg(m_tuning.name()).arg(change.blocks().size()));
+
+    return true;
+}
+
+// The blocks of the image are complete messages, they are sent as they are,
+// up to I2C_RDWR_IOCTL_MAX_MSGS per transfer
+bool QVL53L0XBackend::writeTuning(QVL53L0XTuning &tuning)
+{
+    const std::vector<QVL53L0XTuning::Block> &blocks = tuning.blocks();
+    struct i2c_msg messages[I2C_RDWR_IOCTL_MAX_MSGS];
+
+    for(size_t first = 0; first < blocks.size(); first += I2C_RDWR_IOCTL_MAX_MSGS)
+    {
+        size_t count = qMin<size_t>(blocks.size() - first, I2C_RDWR_IOCTL_MAX_MSGS);
+
+        for(size_t i = 0; i < count; i++)
+        {
+            messages[i].addr = m_address;
+            messages[i].flags = 0;
+            messages[i].len = blocks[first + i].length;
+            messages[i].buf = tuning.data(blocks[first + i]);
+        }
+
+        struct i2c_rdwr_ioctl_data payload =
+        {
+            .msgs = messages,
+            .nmsgs = static_cast<__u32>(count)
+        };
+
+        if(transfer(&payload) < 0)
+        {
+            m_errno = errno;
+            reportError(QString("COULD NOT WRITE TUNING %1").arg(tuning.name()));
+            return false;
+        }
+    }
+
+    if(m_backendDebug && !m_initialized)
+        reportEvent(QString("WROTE TUNING %1 (%2 WRITES)").arg(tuning.name()).arg(blocks.size()));
+
+    return true;
+}
+
+// Bus thread, between two measurements. Writes only what has changed since
+// the device was set up, flags that could not be applied stay set and are
+// retried by the next poll
+bool QVL53L0XBackend::applyChanges()
+{
+    // everything after the readdressing talks to the new address
+    if((m_changes & AddressChange) && !applyAddress())
+        return false;
+
+    if((m_changes & TuningChange) && !applyTuning())
+        return false;
+
+    if((m_changes & RangingModeChange) && !applyRangingMode())
+        return false;
+
+    if(m_changes & TimingBudgetChange)
+    {
+        // the device takes a new timing budget in single shot mode only
+        if((m_continuous && !stopContinuous()) ||
+            !setMeasurementTimingBudget(m_requestedTimingBudget) ||
+            (m_rangeContinuously && !m_continuous && !startContinuous()))
+            return false;
+
+        m_changes &= ~TimingBudgetChange;
+        queueRangingModeChanged();
+
+        // back to back ranging is polled by the timing budget
+        m_busController->reschedule(this);
+    }
+
+    if(m_changes & IntermeasurementChange)
+    {
+        // single shot and back to back ranging have no intermeasurement period
+        if(m_continuous && m_intermeasurementPeriod > 0 && !writeIntermeasurementPeriod())
+            return false;
+
+        m_changes &= ~IntermeasurementChange;
+    }
+
+    return true;
+}
+
+void QVL53L0XBackend::reportEvent(QString message)
+{
+    //report event if backendDebug is true
+    if(m_backendDebug)
+        qDebug() << QString("** %1 - (QVL53L0X@%2:0x%3)").arg(message, m_bus).arg(m_address, 2, 16);
+}
+
+void QVL53L0XBackend::reportError(QString message)
+{
+    qDebug() << QString("!! ERROR: %1 - (QBMP280@%2:0x%3)").arg(message, m_bus).arg(m_address, 2, 16) << errno;
+}
+
+void QVL53L0XBackend::newLine()
+{
+    //add newline if backendDebug is true
+    if(m_backendDebug)
+        qDebug() << "";
+}
+
+void QVL53L0XBackend::onSensorBusChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    // picked up once the running bring up has finished, see onInitializationFinished()
+    if(!sensor || sensor->bus() == m_bus || m_initializing)
+        return;
+
+    if(!m_initialized)
+    {
+        m_bus = sensor->bus();
+        return;
+    }
+
+    // the device on the new bus is another device, so it is brought up from
+    // scratch on the thread of the new bus
+    if(m_polling)
+    {
+        m_polling = false;
+        m_oversamplingTimer->stop();
+
+        // blocks until the bus thread has stopped ranging
+        m_busController->stopPolling(this);
+        drain();
+    }
+
+    m_calibrationState = CalibrationState::Idle;
+    m_initialized = false;
+    m_bus = sensor->bus();
+
+    if(m_active)
+        start();
+}
+
+void QVL53L0XBackend::onSensorAddressChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    quint8 address = sensor->address();
+
+    // a polled device is readdressed by the next poll, otherwise the next
+    // bring up talks to the device on the new address
+    updateIO([this, address]()
+    {
+        if(m_busController && m_busController->isPolling(this))
+        {
+            m_pendingAddress = address;
+            m_changes = address != m_address ? (m_changes | AddressChange) : (m_changes & ~AddressChange);
+        }
+        else
+            m_address = address;
+    });
+
+    captureConfiguration(QVL53L0XCapture::Address, address);
+}
+
+// A polled sensor keeps ranging at the new rate, the bus thread retimes its
+// poll and the intermeasurement period without restarting or recalibrating
+void QVL53L0XBackend::onSesnorDataRateChanged()
+{
+    captureConfiguration(QVL53L0XCapture::DataRate, sensor()->dataRate());
+
+    // picked up by the next startPolling()
+    if(!m_polling || sensor()->dataRate() <= 0)
+        return;
+
+    int rate = planDataRate(sensor()->dataRate());
+
+    // handled again with the rate the bus can carry
+    if(rate != sensor()->dataRate())
+    {
+        sensor()->setDataRate(rate);
+        return;
+    }
+
+    int interval = 1000 / rate;
+
+    if(m_oversampling && !m_grouped)
+    {
+        // the buffer only grows, the samples collected so far stay valid
+        size_t size = interval / qMax<int>(1, m_measurementTimingBudget / 2000) + 2;
+
+        if(size > m_samples.size())
+            m_samples.resize(size, 0.0);
+
+        m_oversamplingTimer->setInterval(interval);
+    }
+
+    updateIO([this, interval]()
+    {
+        m_pollInterval = interval;
+
+        if(!m_oversampling)
+        {
+            m_intermeasurementPeriod = interval;
+            m_changes |= IntermeasurementChange;
+        }
+
+        m_busController->reschedule(this);
+    });
+}
+
+void QVL53L0XBackend::onSensorRangingModeChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    bool longRange = sensor->longRange();
+    bool fractionalRanging = sensor->fractionalRanging();
+
+    // applied by the next poll, between measurements
+    updateIO([this, longRange, fractionalRanging]()
+    {
+        m_longRange = longRange;
+        m_fractionalRanging = fractionalRanging;
+        m_changes |= RangingModeChange;
+    });
+}
+
+void QVL53L0XBackend::onSensorCaptureFileChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    m_capture.close();
+
+    if(sensor->captureFile().isEmpty())
+        return;
+
+    if(!m_capture.open(sensor->captureFile()))
+    {
+        reportError(QString("COULD NOT OPEN CAPTURE FILE %1").arg(sensor->captureFile()));
+        return;
+    }
+
+    // snapshot of the configuration the following results were taken with
+    captureConfiguration(QVL53L0XCapture::Address, m_address);
+    captureConfiguration(QVL53L0XCapture::DataRate, sensor->dataRate());
+    captureConfiguration(QVL53L0XCapture::LongRange, m_longRange);
+    captureConfiguration(QVL53L0XCapture::FractionalRanging, m_fractionalRanging);
+    captureConfiguration(QVL53L0XCapture::TimingBudget, m_measurementTimingBudget);
+    captureConfiguration(QVL53L0XCapture::VcselDuration, m_sigmaTiming.vcselDuration);
+    captureConfiguration(QVL53L0XCapture::IntegrationTime, m_sigmaTiming.integrationTime);
+
+    reportEvent(QString("CAPTURING TO %1").arg(sensor->captureFile()));
+}
+
+void QVL53L0XBackend::onSensorOversamplingChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    // grouped sensors range single shot either way
+    bool active = m_polling && !m_grouped;
+
+    // switching between single shot and continuous ranging needs a restart
+    if(active)
+        stop();
+
+    m_oversampling = sensor->oversampling();
+
+    if(active)
+        start();
+}
+
+void QVL53L0XBackend::onSensorLowPowerChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    // grouped sensors range single shot either way
+    bool active = m_polling && !m_grouped;
+
+    // switching between single shot and timed ranging needs a restart
+    if(active)
+        stop();
+
+    m_lowPower = sensor->lowPower();
+
+    if(active)
+        start();
+}
+
+void QVL53L0XBackend::onSensorCalibrationIntervalChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    qint64 interval = sensor->calibrationInterval() * 1000;
+
+    updateIO([this, interval]()
+    {
+        m_calibrationInterval = interval;
+    });
+}
+
+void QVL53L0XBackend::onSensorCalibrationRequested()
+{
+    // picked up by the next poll
+    updateIO([this]()
+    {
+        m_calibrationRequested = true;
+    });
+}
+
+void QVL53L0XBackend::onSensorDuplicateSuppressionChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    m_skipDuplicates = sensor->skipDuplicates();
+    m_deadband = sensor->deadband();
+    m_heartbeat = static_cast<quint64>(sensor->heartbeat()) * 1000;
+}
+
+void QVL53L0XBackend::onSensorLimitChecksChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    m_sigmaLimit = sensor->sigmaLimit();
+    m_rejectInvalidRanges = sensor->rejectInvalidRanges();
+
+    qreal signalRateLimit = sensor->signalRateLimit();
+
+    // the signal rate limit is written with the ranging mode, by the next poll
+    updateIO([this, signalRateLimit]()
+    {
+        if(qFuzzyCompare(m_signalRateLimit, signalRateLimit))
+            return;
+
+        m_signalRateLimit = signalRateLimit;
+        m_changes |= RangingModeChange;
+    });
+}
+
+void QVL53L0XBackend::onSensorAdapterSettingsChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    int timeout = sensor->i2cTimeout();
+    int retries = sensor->i2cRetries();
+
+    // applied right away while the bus is open, otherwise by the next startI2C()
+    updateIO([this, timeout, retries]()
+    {
+        m_i2cTimeout = timeout;
+        m_i2cRetries = retries;
+
+        if(m_i2c >= 0)
+            applyAdapterSettings();
+    });
+}
+
+void QVL53L0XBackend::onSensorBusSpeedChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    // shared by the sensors on the bus, the last speed set applies to all of them
+    if(!sensor || !m_busController)
+        return;
+
+    m_busController->setSpeed(sensor->busSpeed());
+}
+
+void QVL53L0XBackend::onBusOccupancyChanged(qreal occupancy)
+{
+    if(QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor()))
+        sensor->setBusOccupancy(occupancy);
+}
+
+void QVL53L0XBackend::onSensorSchedulingChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor || !m_busController)
+        return;
+
+    m_busController->setScheduling(sensor->realtimePriority(), sensor->cpuAffinity());
+}
+
+// Process wide, keeps the polling path from page faulting. The lock is shared
+// by every backend that asked for it, the last one to let go unlocks memory
+void QVL53L0XBackend::onSensorLockMemoryChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor || sensor->lockMemory() == m_memoryLocked)
+        return;
+
+    if(!sensor->lockMemory())
+    {
+        unlockMemory();
+        return;
+    }
+
+    QMutexLocker locker(&m_memoryLocksMutex);
+
+    if(m_memoryLocks == 0 && mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+    {
+        m_errno = errno;
+        reportError("COULD NOT LOCK MEMORY");
+        return;
+    }
+
+    m_memoryLocks++;
+    m_memoryLocked = true;
+    reportEvent("MEMORY LOCKED");
+}
+
+void QVL53L0XBackend::unlockMemory()
+{
+    QMutexLocker locker(&m_memoryLocksMutex);
+
+    if(!m_memoryLocked)
+        return;
+
+    m_memoryLocked = false;
+
+    if(--m_memoryLocks == 0)
+        munlockall();
+}
+
+// enabling the adaptive rate starts out at the maximum rate
+void QVL53L0XBackend::onSensorAdaptiveRateChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    bool enabled = sensor->adaptiveRate() && !m_adaptiveRate;
+
+    m_adaptiveRate = sensor->adaptiveRate();
+    m_minimumDataRate = sensor->minimumDataRate();
+    m_maximumDataRate = sensor->maximumDataRate();
+    m_motionThreshold = sensor->motionThreshold();
+
+    if(!enabled)
+        return;
+
+    m_motion = 0;
+    m_motionTimestamp = 0;
+    m_stillTimer.invalidate();
+    m_adaptiveTarget = m_maximumDataRate;
+
+    sensor->setDataRate(m_maximumDataRate);
+}
+
+// a new window or a restart starts the estimate over, the readings are back
+// at rest while the kinematics are off
+void QVL53L0XBackend::onSensorKinematicsChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    m_kinematicsEnabled = sensor->kinematics();
+    m_approachThreshold = sensor->approachThreshold();
+
+    if(m_kinematics.window() != sensor->kinematicsWindow())
+        m_kinematics.setWindow(sensor->kinematicsWindow());
+
+    if(m_kinematicsEnabled)
+        return;
+
+    m_kinematics.reset();
+    m_reading.setVelocity(0);
+    m_reading.setAcceleration(0);
+    m_reading.setTimeToContact(qInf());
+
+    sensor->setMotion(QVL53L0X::Stationary);
+}
+
+// the profiles are validated and compiled here, once per file
+void QVL53L0XBackend::onSensorTuningFileChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    QStringList errors;
+    m_tuningProfiles.clear();
+
+    if(!sensor->tuningFile().isEmpty())
+        m_tuningProfiles = QVL53L0XTuning::load(sensor->tuningFile(), &errors);
+
+    for(const QString &error : errors)
+        reportError(error);
+
+    onSensorTuningProfileChanged();
+}
+
+// Hands the profile to the bus thread along with the registers that differ
+// from the last one, a profile that is not in the file keeps the tuning
+void QVL53L0XBackend::onSensorTuningProfileChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    QVL53L0XTuning tuning = QVL53L0XTuning::defaultTuning();
+
+    if(!sensor->tuningProfile().isEmpty())
+    {
+        auto profile = std::find_if(m_tuningProfiles.cbegin(), m_tuningProfiles.cend(), [sensor](const QVL53L0XTuning &candidate)
+        {
+            return candidate.name() == sensor->tuningProfile();
+        });
+
+        if(profile == m_tuningProfiles.cend())
+        {
+            reportError(QString("TUNING PROFILE %1 NOT FOUND").arg(sensor->tuningProfile()));
+            return;
+        }
+
+        tuning = *profile;
+    }
+
+    if(tuning.difference(m_selectedTuning).isEmpty())
+        return;
+
+    m_selectedTuning = tuning;
+
+    // applied by the next poll, or in full by the bring up. A later switch
+    // replaces this one, the bus thread writes what differs from the device
+    updateIO([this, tuning]()
+    {
+        m_pendingTuning = tuning;
+        m_changes |= TuningChange;
+    });
+}
+
+// the only place the history is allocated
+void QVL53L0XBackend::onSensorHistorySizeChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor || static_cast<size_t>(sensor->historySize()) == m_history.size())
+        return;
+
+    m_history.assign(sensor->historySize(), QVL53L0XSample());
+    m_historyHead = 0;
+}
+
+void QVL53L0XBackend::onSensorSharedMemoryNameChanged()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor)
+        return;
+
+    m_sharedMemory.close();
+
+    if(sensor->sharedMemoryName().isEmpty())
+        return;
+
+    if(!m_sharedMemory.open(sensor->sharedMemoryName()))
+    {
+        reportError(QString("COULD NOT OPEN SHARED MEMORY %1").arg(sensor->sharedMemoryName()));
+        return;
+    }
+
+    reportEvent(QString("PUBLISHING TO %1").arg(sensor->sharedMemoryName()));
+}
+
+void QVL53L0XBackend::captureConfiguration(QVL53L0XCapture::ConfigurationKey key, quint32 value)
+{
+    if(m_capture.isOpen())
+        m_capture.writeConfiguration(timestamp(), key, value);
+}
+
+bool QVL53L0XBackend::isRecalibrationDue() const
+{
+    if(m_calibrationRequested)
+        return true;
+
+    return m_calibrationInterval > 0 && m_lastCalibrationTimer.isValid() && m_lastCalibrationTimer.hasExpired(m_calibrationInterval);
+}
+
+// Background recalibration in single shot mode. The VHV and phase calibrations
+// are started right after a measurement and collected before the next one, so
+// the device calibrates in the idle time between two polls. Each calibration
+// needs its own sequence config, which is restored before the next measurement.
+bool QVL53L0XBackend::beginRecalibration()
+{
+    switch(m_calibrationState)
+    {
+    case CalibrationState::Idle:
+        if(!isRecalibrationDue())
+            return true;
+
+        m_calibrationRequested = false;
+
+        if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0x01))
+            return false;
+        if(!startSingleRefCalibration(0x40))
+            return false;
+
+        m_calibrationState = CalibrationState::VhvRunning;
+        m_calibrationTimer.start();
+        break;
+
+    case CalibrationState::PhasePending:
+        if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0x02))
+            return false;
+        if(!startSingleRefCalibration(0x00))
+            return false;
+
+        m_calibrationState = CalibrationState::PhaseRunning;
+        m_calibrationTimer.start();
+        break;
+
+    default:
+        break;
+    }
+
+    return true;
+}
+
+// Non blocking like collectMeasurement(). pending is set while the calibration
+// is still running, the caller skips this poll and collects it on the next one
+bool QVL53L0XBackend::finishRecalibration(bool &pending)
+{
+    bool done = false;
+    pending = false;
+
+    if(!isRecalibrating())
+        return true;
+
+    if(!checkSingleRefCalibration(done))
+        return false;
+
+    if(!done)
+    {
+        if(!waitExpired(m_calibrationTimer))
+        {
+            pending = true;
+            return true;
+        }
+
+        reportError("RECALIBRATION TIMED OUT");
+        m_errno = ETIMEDOUT;
+        m_calibrationState = CalibrationState::Idle;
+        writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0xE8);
+        return false;
+    }
+
+    if(!writeRegisterByte((quint8)Register::SYSTEM_SEQUENCE_CONFIG, 0xE8))
+        return false;
+
+    if(m_calibrationState == CalibrationState::VhvRunning)
+        m_calibrationState = CalibrationState::PhasePending;
+    else
+    {
+        m_calibrationState = CalibrationState::Idle;
+        m_lastCalibrationTimer.start();
+
+        Event event;
+        event.type = Event::Calibrated;
+        queueEvent(event);
+    }
+
+    return true;
+}
+
+bool QVL53L0XBackend::isRecalibrating() const
+{
+    return m_calibrationState == CalibrationState::VhvRunning || m_calibrationState == CalibrationState::PhaseRunning;
+}
+
+// sensor thread, the bus thread restarts m_lastCalibrationTimer itself
+void QVL53L0XBackend::recalibrated()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+    QDateTime now = QDateTime::currentDateTime();
+
+    m_metrics.recordCalibration(now.toMSecsSinceEpoch());
+
+    if(sensor)
+        sensor->setLastCalibration(now);
+
+    reportEvent("REFERENCE CALIBRATION DONE");
+}
+
+// based on VL53L0X_perform_single_ref_calibration()
+bool QVL53L0XBackend::performSingleRefCalibration(quint8 vhvInitByte)
+{
+    if(!startSingleRefCalibration(vhvInitByte))
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool done = false;
+
+    while(!done)
+    {
+        if(waitExpired(timer))
+        {
+            m_errno = ETIMEDOUT;
+            return false;
+        }
+
+        if(!checkSingleRefCalibration(done))
+            return false;
+    }
+
+    return true;
+}
+
+bool QVL53L0XBackend::startSingleRefCalibration(quint8 vhvInitByte)
+{
+    // VL53L0X_REG_SYSRANGE_MODE_START_STOP
+    return writeRegisterByte((quint8)Register::SYSRANGE_START, 0x01 | vhvInitByte);
+}
+
+// non blocking, done is set once the calibration has finished and was acknowledged
+bool QVL53L0XBackend::checkSingleRefCalibration(bool &done)
+{
+    quint8 data = 0;
+    done = false;
+
+    if(!readRegisterByte((quint8)Register::RESULT_INTERRUPT_STATUS, &data))
+        return false;
+
+    if((data & 0x07) == 0)
+        return true;
+
+    if(!writeRegisterByte((quint8)Register::SYSTEM_INTERRUPT_CLEAR, 0x01))
+        return false;
+
+    if(!writeRegisterByte((quint8)Register::SYSRANGE_START, 0x00))
+        return false;
+
+    done = true;
+
+    return true;
+}
+
+// Decode sequence step timeout in MCLKs from register value
+// based on VL53L0X_decode_timeout()
+// Note: the original function returned a uint32_t, but the return value is
+// always stored in a uint16_t.
+quint16 QVL53L0XBackend::decodeTimeout(quint16 value)
+{
+    // format: "(LSByte * 2^MSByte) + 1"
+    return static_cast<quint16>((value & 0x00FF) << static_cast<quint16>((value & 0xFF00) >> 8)) + 1;
+}
+
+// Encode sequence step timeout register value from timeout in MCLKs
+// based on VL53L0X_encode_timeout()
+quint16 QVL53L0XBackend::encodeTimeout(quint32 timeoutMclks)
+{
+    // format: "(LSByte * 2^MSByte) + 1"
+    quint32 lsByte = 0;
+    quint16 msByte = 0;
+
+    if(timeoutMclks == 0)
+        return 0;
+
+    lsByte = timeoutMclks - 1;
+
+    while((lsByte & 0xFFFFFF00) > 0)
+    {
+        lsByte >>= 1;
+        msByte++;
+    }
+
+    return (msByte << 8) | (lsByte & 0xFF);
+}
+
+// Convert sequence step timeout from MCLKs to microseconds with given VCSEL period in PCLKs
+// based on VL53L0X_calc_timeout_us()
+quint32 QVL53L0XBackend::timeoutMclksToMicroseconds(quint16 timeoutMclks, quint8 vcselPeriodPclks)
+{
+    quint32 macroPeriod = calcMacroPeriod(vcselPeriodPclks);
+
+    return ((timeoutMclks * macroPeriod) + 500) / 1000;
+}
+
+// Convert sequence step timeout from microseconds to MCLKs with given VCSEL period in PCLKs
+// based on VL53L0X_calc_timeout_mclks()
+quint32 QVL53L0XBackend::timeoutMicrosecondsToMclks(quint32 timeoutMicroseconds, quint8 vcselPeriodPclks)
+{
+    quint32 macroPeriod = calcMacroPeriod(vcselPeriodPclks);
+
+    return (((timeoutMicroseconds * 1000) + (macroPeriod / 2)) / macroPeriod);
+}
+
+// based on VL53L0X_calc_sigma_estimate(), the VCSEL fires for 3 PLL periods
+// (2 with a final range period of 8 PCLKs) 2048 times per macro period of
+// the pre range and final range steps
+QVL53L0XBackend::SigmaTiming QVL53L0XBackend::sigmaTiming(const SequenceStepTimeouts &timeouts)
+{
+    const quint64 pllPeriod = 1655; //ps
+    quint64 vcselWidth = timeouts.finalRangeVcselPeriodPclks == 8 ? 2 : 3;
+
+    SigmaTiming timing;
+    timing.vcselDuration = static_cast<quint32>(vcselWidth * 2048 * (timeouts.preRangeMclks + timeouts.finalRangeMclks) * pllPeriod / 1000000);
+    timing.integrationTime = timeouts.preRangeMicroseconds + timeouts.finalRangeMicroseconds;
+
+    return timing;
 }
@@ -8,9 +8,22 @@
 #include <QTimer>
 #include <QThread>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSocketNotifier>
+
+#include <atomic>
+#include <vector>
 
 #include "qvl53l0x_global.h"
 #include "qvl53l0x.h"
+#include "qvl53l0xcapture.h"
+#include "qvl53l0xsharedmemory.h"
+#include "qvl53l0xringbuffer.h"
+#include "qvl53l0xsample.h"
+#include "qvl53l0xkinematics.h"
+#include "qvl53l0xtuning.h"
+#include "qvl53l0xmetrics.h"
 
 #include "fcntl.h"
 #include "i2c/smbus.h"
@@ -20,9 +33,14 @@
 
 QT_BEGIN_NAMESPACE
 
+class QVL53L0XBus;
+class QVL53L0XSimulator;
+
 class QVL53L_X_EXPORT QVL53L0XBackend : public QSensorBackend
 {
     Q_OBJECT
+    friend class QVL53L0XBus;
+    friend class QVL53L0XGroup;
 
     // register addresses from API vl53l0x_device.h (ordered as listed there)
     enum class Register : quint8
@@ -110,9 +128,107 @@ class QVL53L_X_EXPORT QVL53L0XBackend : public QSensorBackend
         ALGO_PHASECAL_CONFIG_TIMEOUT                = 0x30,
     };
 
+    enum class VcselPeriodType
+    {
+        PreRange,
+        FinalRange
+    };
+
+    enum class InitializationState
+    {
+        Static,
+        WaitVhvCalibration,
+        WaitPhaseCalibration,
+        Done
+    };
+
+    // background recalibration, see beginRecalibration()
+    enum class CalibrationState
+    {
+        Idle,
+        VhvRunning,
+        PhasePending,
+        PhaseRunning
+    };
+
+    // configuration the bus thread applies between measurements, see applyChanges()
+    enum Change : quint8
+    {
+        RangingModeChange = 0x01,       //signal rate limit, VCSEL periods and SYSTEM_RANGE_CONFIG
+        IntermeasurementChange = 0x02,  //SYSTEM_INTERMEASUREMENT_PERIOD of timed ranging
+        AddressChange = 0x04,           //I2C_SLAVE_DEVICE_ADDRESS
+        TimingBudgetChange = 0x08,      //final range timeout of the requested timing budget
+        TuningChange = 0x10             //registers of a tuning profile switch
+    };
+
+    enum class InitializationResult
+    {
+        Waiting,
+        Finished,
+        Failed
+    };
+
+public:
+    // VCSEL timing of the measurement sequence for the sigma estimate, see sigmaTiming()
+    struct SigmaTiming
+    {
+        quint32 vcselDuration = 0; //microseconds the VCSEL fires during the pre range and final range steps
+        quint32 integrationTime = 0; //microseconds, pre range and final range timeouts
+    };
+
+private:
+
+    // handed from the bus thread to the sensor thread, see queueEvent()
+    struct Event
+    {
+        enum Type : quint8
+        {
+            Result,
+            RangingModeChanged,
+            Calibrated,
+            Fault
+        };
+
+        Type type = Result;
+        bool longRange = false;
+        bool fractionalRanging = false; //ranging mode the result was taken with
+        int error = 0;
+        quint32 timingBudget = 0; //microseconds
+        SigmaTiming sigmaTiming;
+        quint64 timestamp = 0; //microseconds since epoch
+        quint8 result[12] = {}; //RESULT_RANGE_STATUS block
+    };
+
+    struct SequenceStepEnables
+    {
+        bool tcc;
+        bool msrc;
+        bool dss;
+        bool preRange;
+        bool finalRange;
+    };
+
+    struct SequenceStepTimeouts
+    {
+        quint16 preRangeVcselPeriodPclks;
+        quint16 finalRangeVcselPeriodPclks;
+
+        quint16 msrcDssTccMclks;
+        quint16 preRangeMclks;
+        quint16 finalRangeMclks;
+
+        quint32 msrcDssTccMicroseconds;
+        quint32 preRangeMicroseconds;
+        quint32 finalRangeMicroseconds;
+    };
+
 public:
     static inline const char* id = "QVL53L0X-Backend";
     static inline const quint8 m_chipId = 0xEE; //i2c chip id
+    static inline const int faultTolerance = 3; //failed polls in a row before the sensor is restarted
+    static inline const int maxRecoveryDelay = 5000; //ms between restarts that keep failing
+    static inline const quint32 defaultTimingBudget = 33000; //us, the API default until the device has been read
+    static inline const int adaptiveHoldTime = 2000; //ms the adaptive rate waits before it falls
 
     explicit QVL53L0XBackend(QSensor *sensor = nullptr);
     ~QVL53L0XBackend();
@@ -121,26 +237,98 @@ public:
     virtual void stop() override;
     virtual bool isFeatureSupported(QSensor::Feature feature) const override;
 
+    static void decodeResult(const quint8 *result, bool fractionalRanging, const SigmaTiming &timing, QVL53L0XReading *reading);
+    static qreal decodeRange(const quint8 *result, bool fractionalRanging);
+    static qreal decodeSignalRate(const quint8 *result);
+    static qreal decodeAmbientRate(const quint8 *result);
+    static qreal estimateSigma(qreal signalRate, qreal ambientRate, const SigmaTiming &timing);
+    static QVL53L0XReading::RangeStatus decodeRangeStatus(const quint8 *result);
+    static quint64 timestamp();
+    static quint32 timingBudgetPreset(int rate);
+
+    void recordSample(quint64 timestamp, const quint8 *result, bool fractionalRanging, const SigmaTiming &timing);
+    qsizetype copySamples(QVL53L0XSample *buffer, qsizetype count, quint64 *cursor) const;
+    const QVL53L0XMetrics &metrics() const;
+
 signals:
 
 protected slots:
-    void poll();
+    void drain();
+    void reportOversampling();
+    void recover();
 
 protected:
+    // bus thread
+    bool beginPolling();
+    void poll();
+    void pollContinuous();
+    void pollRecalibration();
+    void endPolling();
+    int pollInterval() const;
+    Qt::TimerType pollTimerType() const;
+    void queueEvent(const Event &event);
+    void queueResult();
+    void queueFault();
+
+    // state read by the bus thread is only changed on the bus thread
+    template<typename Functor>
+    void updateIO(Functor functor)
+    {
+        if(m_busController)
+            QMetaObject::invokeMethod(m_busController, functor, Qt::QueuedConnection);
+        else
+            functor();
+    }
+
+    bool configure();
     bool initialize();
+    bool initializeStatic();
+    InitializationResult initializeStep();
+    void reportInitialization(bool success);
+    void onInitializationFinished(bool success);
+    void startPolling();
     bool startI2C();
     bool endI2C();
+    void applyAdapterSettings();
+    quint32 waitBudget() const;
+    bool waitExpired(const QElapsedTimer &timer) const;
+    int transfer(struct i2c_rdwr_ioctl_data *payload);
     bool readRegisterByte(quint8 reg, quint8 *data);
     bool readRegisterWord(quint8 reg, quint16 *data);
     bool readRegisterData(quint8 reg, quint8 *data, quint8 length);
     bool writeRegisterByte(quint8 reg, quint8 data);
     bool writeRegisterWord(quint8 reg, quint16 data);
+    bool writeRegisterLong(quint8 reg, quint32 data);
     bool writeRegisterData(quint8 reg, quint8 *data, quint16 length);
     bool confirmChipID();
     bool getSpadInfo(quint8 &count, bool &isAperture);
-    bool readDistance();
+    bool startRanging();
+    bool collectMeasurement(int &wait);
+    quint64 busLoad(int rate) const;
+    int planDataRate(int rate);
+    bool startContinuous();
+    bool stopContinuous();
+    bool writeIntermeasurementPeriod();
+    bool readContinuous(bool &ready);
+    void publishReading();
+    void updateKinematics();
+    bool isDuplicate();
+    QVL53L0XReading::RangeStatus checkLimits(QVL53L0XReading::RangeStatus status, qreal sigma) const;
     void handleFault();
+    void adaptDataRate(quint64 timestamp, qreal range);
     bool setSignalRateLimit(qreal limit);
+    bool setMeasurementTimingBudget(quint32 budget);
+    bool getMeasurementTimingBudget(quint32 &budget);
+    bool setVcselPulsePeriod(VcselPeriodType type, quint8 periodPclks);
+    bool getVcselPulsePeriod(VcselPeriodType type, quint8 &periodPclks);
+    bool getSequenceStepEnables(SequenceStepEnables &enables);
+    bool getSequenceStepTimeouts(const SequenceStepEnables &enables, SequenceStepTimeouts &timeouts);
+    bool applyRangingMode(bool rewrite = false);
+    bool applyTuning();
+    bool writeTuning(QVL53L0XTuning &tuning);
+    void queueRangingModeChanged();
+    bool applyAddress();
+    bool applyChanges();
     void reportEvent(QString message);
     void reportError(QString message);
     void newLine();
@@ -148,22 +336,145 @@ protected:
     void onSensorBusChanged();
     void onSensorAddressChanged();
     void onSesnorDataRateChanged();
+    void onSensorRangingModeChanged();
+    void onSensorCaptureFileChanged();
+    void onSensorSharedMemoryNameChanged();
+    void onSensorOversamplingChanged();
+    void onSensorLowPowerChanged();
+    void onSensorCalibrationIntervalChanged();
+    void onSensorCalibrationRequested();
+    void onSensorDuplicateSuppressionChanged();
+    void onSensorLimitChecksChanged();
+    void onSensorAdapterSettingsChanged();
+    void onSensorSchedulingChanged();
+    void onSensorBusSpeedChanged();
+    void onBusOccupancyChanged(qreal occupancy);
+    void onSensorLockMemoryChanged();
+    void onSensorHistorySizeChanged();
+    void onSensorAdaptiveRateChanged();
+    void onSensorKinematicsChanged();
+    void onSensorTuningFileChanged();
+    void onSensorTuningProfileChanged();
+
+    void captureConfiguration(QVL53L0XCapture::ConfigurationKey key, quint32 value);
 
     bool performSingleRefCalibration(quint8 vhvInitByte);
+    bool startSingleRefCalibration(quint8 vhvInitByte);
+    bool checkSingleRefCalibration(bool &done);
+    bool beginRecalibration();
+    bool finishRecalibration(bool &pending);
+    bool isRecalibrating() const;
+    bool isRecalibrationDue() const;
+    void unlockMemory();
+    void recalibrated();
+
+    static quint64 transferBits(int written, int read);
+    static quint16 decodeTimeout(quint16 value);
+    static quint16 encodeTimeout(quint32 timeoutMclks);
+    static quint32 timeoutMclksToMicroseconds(quint16 timeoutMclks, quint8 vcselPeriodPclks);
+    static quint32 timeoutMicrosecondsToMclks(quint32 timeoutMicroseconds, quint8 vcselPeriodPclks);
+    static SigmaTiming sigmaTiming(const SequenceStepTimeouts &timeouts);
 
 private:
     int m_i2c = -1;
-    int m_errno;
+    QVL53L0XSimulator *m_simulator = nullptr; //set by startI2C() on simulated buses
+    int m_i2cTimeout = 0; //ms, 0 keeps the adapter default
+    int m_i2cRetries = -1; //-1 keeps the adapter default
+    int m_errno = 0;
     QString m_bus;
     quint8 m_address;
+    quint8 m_pendingAddress = 0; //bus thread, written to the device by applyAddress()
     quint8 m_stopByte;
 
+    bool m_configured = false;
     bool m_initialized = false;
+    bool m_initializing = false;
+    bool m_active = false;
+    bool m_polling = false; //polled by the bus thread
+    bool m_grouped = false; //triggered by a QVL53L0XGroup instead of polled, see QVL53L0XBus::startGroup()
+    InitializationState m_initializationState = InitializationState::Static;
+    QElapsedTimer m_calibrationTimer;
+    QVL53L0XBus *m_busController = nullptr;
     bool m_backendDebug = true;
-    QTimer *m_pollTimer = nullptr;
-
-    quint32 m_distance = 0;
+    QTimer *m_oversamplingTimer = nullptr; //reports the oversampled range, polling runs on the bus thread
+    int m_pollInterval = 0; //milliseconds
+    bool m_memoryLocked = false; //holds one of m_memoryLocks
+
+    static inline QMutex m_memoryLocksMutex;
+    static inline int m_memoryLocks = 0; //backends holding the process wide mlockall()
+
+    QTimer *m_recoveryTimer = nullptr;
+    int m_faultCount = 0; //faults since the last result
+    int m_recoveries = 0; //restarts since the last result
+    QElapsedTimer m_faultTimer; //since the first of m_faultCount
+
+    QVL53L0XRingBuffer<Event, 32> m_events;
+    std::atomic<quint32> m_droppedEvents = 0;
+    int m_eventFd = -1;
+    QSocketNotifier *m_eventNotifier = nullptr;
+
+    quint32 m_measurementTimingBudget = 0; //microseconds
+    SigmaTiming m_sigmaTiming; //bus thread, of the timeouts m_measurementTimingBudget was set with
+    quint32 m_requestedTimingBudget = 0; //microseconds, bus thread, applied with TimingBudgetChange
+    bool m_longRange = false;
+    bool m_fractionalRanging = false;
+    quint8 m_changes = 0; //bus thread, Change flags not applied yet
+
+    QVL53L0XTuning m_tuning = QVL53L0XTuning::defaultTuning(); //bus thread, last image written to the device
+    QVL53L0XTuning m_pendingTuning; //bus thread, profile the device is switched to, see TuningChange
+    QList<QVL53L0XTuning> m_tuningProfiles; //sensor thread, loaded from the tuning file
+    QVL53L0XTuning m_selectedTuning; //sensor thread, last profile handed to the bus thread
+
+    bool m_oversampling = false;
+    bool m_continuous = false;
+    bool m_lowPower = false;
+    bool m_rangeContinuously = false; //oversampling or low power, polled with pollContinuous()
+    bool m_measuring = false; //bus thread, single shot measurement in flight, see collectMeasurement()
+    QElapsedTimer m_measurementTimer; //bus thread, since the single shot measurement was started
+    quint32 m_intermeasurementPeriod = 0; //milliseconds, 0 ranges back to back
+    std::vector<qreal> m_samples; //valid ranges since the last report, allocated by start()
+    size_t m_sampleCount = 0;
+    QVL53L0XReading::RangeStatus m_lastRangeStatus = QVL53L0XReading::NoUpdate;
+
+    CalibrationState m_calibrationState = CalibrationState::Idle;
+    bool m_calibrationRequested = false;
+    qint64 m_calibrationInterval = 0; //milliseconds, 0 disables periodic recalibration
+    QElapsedTimer m_lastCalibrationTimer;
+
+    bool m_skipDuplicates = false;
+    qreal m_deadband = 0; //mm
+    quint64 m_heartbeat = 0; //microseconds
+    qreal m_lastEmittedDistance = 0;
+    QVL53L0XReading::RangeStatus m_lastEmittedRangeStatus = QVL53L0XReading::NoUpdate;
+    quint64 m_lastEmittedTimestamp = 0;
+
+    qreal m_sigmaLimit = 0; //mm, 0 disables the sigma check
+    qreal m_signalRateLimit = 0; //MCPS, bus thread, 0 keeps the ranging mode's default
+    bool m_rejectInvalidRanges = false;
+
+    bool m_adaptiveRate = false;
+    int m_minimumDataRate = 1; //Hz
+    int m_maximumDataRate = 30; //Hz
+    qreal m_motionThreshold = 100; //mm/s
+    int m_adaptiveTarget = 0; //Hz, last rate asked for, the planner may have lowered it
+    qreal m_smoothedRange = 0; //mm
+    qreal m_motion = 0; //mm/s, smoothed speed of the target
+    quint64 m_motionTimestamp = 0; //microseconds, of the last sample, 0 before the first
+    QElapsedTimer m_stillTimer; //since the target last asked for the current rate or more
+
+    bool m_kinematicsEnabled = false;
+    qreal m_approachThreshold = 50; //mm/s
+    QVL53L0XKinematics m_kinematics; //sensor thread, fed every valid range, see updateKinematics()
+
+    std::vector<QVL53L0XSample> m_history; //sensor thread, ring of the latest samples, see recordSample()
+    quint64 m_historyHead = 0; //samples recorded since the history was allocated
+
+    QVL53L0XMetrics m_metrics; //counted by both threads, read by QVL53L0XMetricsExporter
+
+    quint8 m_result[12] = {}; //RESULT_RANGE_STATUS block of the last measurement, bus thread only
     QVL53L0XReading m_reading;
+    QVL53L0XCaptureWriter m_capture;
+    QVL53L0XSharedMemoryWriter m_sharedMemory;
 };
 
 QT_END_NAMESPACE
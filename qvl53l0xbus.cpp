@@ -0,0 +1,466 @@
+#include "qvl53l0xbus.h"
+#include "qvl53l0xbackend.h"
+#include "qvl53l0xgroup.h"
+
+#include <QTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+#include <cstring>
+
+#include "pthread.h"
+#include "sched.h"
+#include "unistd.h"
+
+QVL53L0XBus::QVL53L0XBus(const QString &path) : QObject(nullptr)
+{
+    m_path = path;
+    m_speed = detectSpeed(path);
+
+    // moved to the bus thread along with the bus
+    m_collectTimer = new QTimer(this);
+    m_collectTimer->setTimerType(Qt::PreciseTimer);
+    m_collectTimer->setSingleShot(true);
+    QObject::connect(m_collectTimer, &QTimer::timeout, this, &QVL53L0XBus::collectMeasurements);
+
+    m_thread.setObjectName(QString("QVL53L0X@%1").arg(path));
+    moveToThread(&m_thread);
+    m_thread.start();
+}
+
+QVL53L0XBus::~QVL53L0XBus()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+QVL53L0XBus *QVL53L0XBus::acquire(const QString &path)
+{
+    QMutexLocker locker(&m_busesMutex);
+
+    QVL53L0XBus *bus = m_buses.value(path, nullptr);
+
+    if(!bus)
+    {
+        bus = new QVL53L0XBus(path);
+        m_buses.insert(path, bus);
+    }
+
+    bus->m_references++;
+
+    return bus;
+}
+
+void QVL53L0XBus::release(QVL53L0XBus *bus)
+{
+    if(!bus)
+        return;
+
+    QMutexLocker locker(&m_busesMutex);
+
+    if(--bus->m_references > 0)
+        return;
+
+    m_buses.remove(bus->m_path);
+
+    //stops and joins the bus thread before the object goes away
+    delete bus;
+}
+
+QString QVL53L0XBus::path() const
+{
+    return m_path;
+}
+
+// queues the backend for initialization, initializationFinished() is
+// reported back on the backend's own thread
+void QVL53L0XBus::initialize(QVL53L0XBackend *backend)
+{
+    QMetaObject::invokeMethod(this, [this, backend]()
+    {
+        if(m_initializing.contains(backend))
+            return;
+
+        m_initializing.append(backend);
+        schedule(0);
+    }, Qt::QueuedConnection);
+}
+
+// polls the backend on the bus thread until stopPolling(), at the interval
+// the backend asks for. Results are handed back through the backend's queue
+void QVL53L0XBus::startPolling(QVL53L0XBackend *backend)
+{
+    QMetaObject::invokeMethod(this, [this, backend]()
+    {
+        if(m_polling.contains(backend) || !backend->beginPolling())
+            return;
+
+        // grouped backends are triggered by their group, see startGroup()
+        if(backend->m_grouped)
+        {
+            m_polling.insert(backend, nullptr);
+            return;
+        }
+
+        QTimer *timer = new QTimer(this);
+        timer->setTimerType(backend->pollTimerType());
+        timer->setInterval(backend->pollInterval());
+
+        QObject::connect(timer, &QTimer::timeout, this, [backend]()
+        {
+            backend->poll();
+        });
+
+        m_polling.insert(backend, timer);
+        timer->start();
+    }, Qt::QueuedConnection);
+}
+
+// once this returns the bus thread has stopped ranging for the backend
+void QVL53L0XBus::stopPolling(QVL53L0XBackend *backend)
+{
+    if(QThread::currentThread() == &m_thread)
+    {
+        removePolling(backend);
+        return;
+    }
+
+    QMetaObject::invokeMethod(this, [this, backend]()
+    {
+        removePolling(backend);
+    }, Qt::BlockingQueuedConnection);
+}
+
+// bus thread only, false while the backend is being restarted
+bool QVL53L0XBus::isPolling(QVL53L0XBackend *backend) const
+{
+    return m_polling.contains(backend);
+}
+
+// bus thread only, retimes the backend's poll after its interval has changed
+void QVL53L0XBus::reschedule(QVL53L0XBackend *backend)
+{
+    QTimer *timer = m_polling.value(backend, nullptr);
+
+    if(!timer)
+        return;
+
+    // setInterval() restarts the running timer with the new interval
+    timer->setTimerType(backend->pollTimerType());
+    timer->setInterval(backend->pollInterval());
+}
+
+// bus thread only, the backend has started a single shot measurement,
+// collectMeasurements() picks the result up once it is due
+void QVL53L0XBus::collect(QVL53L0XBackend *backend)
+{
+    if(!m_measuring.contains(backend))
+        m_measuring.append(backend);
+
+    quint32 budget = backend->m_measurementTimingBudget > 0 ? backend->m_measurementTimingBudget : QVL53L0XBackend::defaultTimingBudget;
+    int delay = static_cast<int>((budget + 999) / 1000);
+
+    if(!m_collectTimer->isActive() || m_collectTimer->remainingTime() > delay)
+        m_collectTimer->start(delay);
+}
+
+// runs the group's phase schedule on the bus thread until stopGroup(). The
+// backends of the group have to be polling on this bus already
+void QVL53L0XBus::startGroup(QVL53L0XGroup *group)
+{
+    QMetaObject::invokeMethod(this, [this, group]()
+    {
+        if(m_groups.contains(group))
+            return;
+
+        // single shot, each step() returns the delay to the next one
+        QTimer *timer = new QTimer(this);
+        timer->setTimerType(Qt::PreciseTimer);
+        timer->setSingleShot(true);
+
+        QObject::connect(timer, &QTimer::timeout, this, [group, timer]()
+        {
+            timer->start(group->step());
+        });
+
+        m_groups.insert(group, timer);
+
+        group->beginSchedule();
+        timer->start(0);
+    }, Qt::QueuedConnection);
+}
+
+// once this returns the bus thread will not touch the group again
+void QVL53L0XBus::stopGroup(QVL53L0XGroup *group)
+{
+    if(QThread::currentThread() == &m_thread)
+    {
+        removeGroup(group);
+        return;
+    }
+
+    QMetaObject::invokeMethod(this, [this, group]()
+    {
+        removeGroup(group);
+    }, Qt::BlockingQueuedConnection);
+}
+
+// removes the backend from the bus, once this returns the bus thread
+// will not touch the backend again
+void QVL53L0XBus::cancel(QVL53L0XBackend *backend)
+{
+    if(QThread::currentThread() == &m_thread)
+    {
+        m_initializing.removeAll(backend);
+        removePolling(backend);
+        return;
+    }
+
+    QMetaObject::invokeMethod(this, [this, backend]()
+    {
+        m_initializing.removeAll(backend);
+        removePolling(backend);
+    }, Qt::BlockingQueuedConnection);
+}
+
+// The thread is shared by every sensor on the bus, the last settings applied win.
+// A priority above 0 selects SCHED_FIFO, which needs CAP_SYS_NICE or a matching
+// RLIMIT_RTPRIO. An empty cpu list allows every CPU.
+void QVL53L0XBus::setScheduling(int priority, const QList<int> &cpus)
+{
+    QMetaObject::invokeMethod(this, [this, priority, cpus]()
+    {
+        applyScheduling(priority, cpus);
+    }, Qt::QueuedConnection);
+}
+
+quint32 QVL53L0XBus::speed() const
+{
+    QMutexLocker locker(&m_planMutex);
+
+    return m_speed;
+}
+
+// 0 goes back to the detected speed, takes effect with the next planned data rate
+void QVL53L0XBus::setSpeed(quint32 speed)
+{
+    QMutexLocker locker(&m_planMutex);
+
+    m_speed = speed > 0 ? speed : detectSpeed(m_path);
+}
+
+// bits per second the other backends on the bus leave for this one
+quint64 QVL53L0XBus::available(QVL53L0XBackend *backend) const
+{
+    QMutexLocker locker(&m_planMutex);
+
+    quint64 capacity = static_cast<quint64>(m_speed * maxOccupancy);
+    quint64 used = 0;
+
+    for(auto load = m_loads.cbegin(); load != m_loads.cend(); ++load)
+    {
+        if(load.key() != backend)
+            used += load.value();
+    }
+
+    return used < capacity ? capacity - used : 0;
+}
+
+// replaces the backend's reservation, load is in bits per second
+void QVL53L0XBus::reserve(QVL53L0XBackend *backend, quint64 load)
+{
+    {
+        QMutexLocker locker(&m_planMutex);
+        m_loads.insert(backend, load);
+    }
+
+    emit occupancyChanged(occupancy());
+}
+
+void QVL53L0XBus::unreserve(QVL53L0XBackend *backend)
+{
+    {
+        QMutexLocker locker(&m_planMutex);
+
+        if(!m_loads.remove(backend))
+            return;
+    }
+
+    emit occupancyChanged(occupancy());
+}
+
+// reserved share of the bus speed, above 1 the bus is oversubscribed
+qreal QVL53L0XBus::occupancy() const
+{
+    QMutexLocker locker(&m_planMutex);
+
+    quint64 used = 0;
+
+    for(quint64 load : m_loads)
+        used += load;
+
+    return m_speed > 0 ? static_cast<qreal>(used) / m_speed : 0;
+}
+
+// The SCL clock of /dev/i2c-N from the adapter's device tree node
+// (clock-frequency, a big endian u32). Adapters without one are assumed to
+// run at the standard mode default
+quint32 QVL53L0XBus::detectSpeed(const QString &path)
+{
+    QFile file(QString("/sys/class/i2c-dev/%1/device/of_node/clock-frequency").arg(QFileInfo(path).fileName()));
+
+    if(!file.open(QIODevice::ReadOnly))
+        return defaultSpeed;
+
+    QByteArray data = file.read(4);
+
+    if(data.size() != 4)
+        return defaultSpeed;
+
+    quint32 speed = (static_cast<quint8>(data[0]) << 24) | (static_cast<quint8>(data[1]) << 16) |
+                    (static_cast<quint8>(data[2]) << 8) | static_cast<quint8>(data[3]);
+
+    return speed > 0 ? speed : defaultSpeed;
+}
+
+void QVL53L0XBus::step()
+{
+    m_stepScheduled = false;
+
+    bool waiting = true;
+
+    //each backend runs until its next calibration wait, then the bus moves on
+    for(qsizetype i = 0; i < m_initializing.count();)
+    {
+        QVL53L0XBackend *backend = m_initializing[i];
+
+        switch(backend->initializeStep())
+        {
+        case QVL53L0XBackend::InitializationResult::Waiting:
+            i++;
+            break;
+        case QVL53L0XBackend::InitializationResult::Finished:
+            m_initializing.removeAt(i);
+            backend->reportInitialization(true);
+            waiting = false;
+            break;
+        case QVL53L0XBackend::InitializationResult::Failed:
+            m_initializing.removeAt(i);
+            backend->reportInitialization(false);
+            waiting = false;
+            break;
+        }
+    }
+
+    //nothing but calibrations in flight, give the devices a moment
+    if(!m_initializing.isEmpty())
+        schedule(waiting ? 1 : 0);
+}
+
+void QVL53L0XBus::collectMeasurements()
+{
+    int delay = -1;
+
+    for(qsizetype i = 0; i < m_measuring.count();)
+    {
+        int wait = 0;
+
+        if(m_measuring[i]->collectMeasurement(wait))
+        {
+            m_measuring.removeAt(i);
+            continue;
+        }
+
+        delay = delay < 0 ? wait : qMin(delay, wait);
+        i++;
+    }
+
+    if(delay >= 0)
+        m_collectTimer->start(delay);
+}
+
+void QVL53L0XBus::schedule(int delay)
+{
+    if(m_stepScheduled)
+        return;
+
+    m_stepScheduled = true;
+    QTimer::singleShot(delay, Qt::PreciseTimer, this, &QVL53L0XBus::step);
+}
+
+void QVL53L0XBus::removePolling(QVL53L0XBackend *backend)
+{
+    // also left behind by a backend that failed to start polling
+    unreserve(backend);
+
+    if(!m_polling.contains(backend))
+        return;
+
+    m_measuring.removeAll(backend);
+
+    //grouped backends have no timer of their own
+    QTimer *timer = m_polling.take(backend);
+
+    if(timer)
+    {
+        timer->stop();
+        delete timer;
+    }
+
+    backend->endPolling();
+}
+
+void QVL53L0XBus::removeGroup(QVL53L0XGroup *group)
+{
+    QTimer *timer = m_groups.take(group);
+
+    if(!timer)
+        return;
+
+    timer->stop();
+    delete timer;
+
+    group->endSchedule();
+}
+
+// runs on the bus thread, so both calls apply to the calling thread
+void QVL53L0XBus::applyScheduling(int priority, const QList<int> &cpus)
+{
+    struct sched_param param = {};
+    param.sched_priority = priority;
+
+    int error = pthread_setschedparam(pthread_self(), priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param);
+
+    if(error != 0)
+        reportError(QString("COULD NOT SET SCHEDULING PRIORITY %1 (%2)").arg(priority).arg(strerror(error)));
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if(cpus.isEmpty())
+    {
+        long count = sysconf(_SC_NPROCESSORS_CONF);
+
+        for(long cpu = 0; cpu < count && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &set);
+    }
+    else
+    {
+        for(int cpu : cpus)
+        {
+            if(cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        }
+    }
+
+    error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    if(error != 0)
+        reportError(QString("COULD NOT SET CPU AFFINITY (%1)").arg(strerror(error)));
+}
+
+void QVL53L0XBus::reportError(QString message)
+{
+    qDebug() << QString("!! ERROR: %1 - (QVL53L0X@%2)").arg(message, m_path);
+}
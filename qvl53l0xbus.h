@@ -0,0 +1,116 @@
+#ifndef QVL53L_XBUS_H
+#define QVL53L_XBUS_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+
+#include "qvl53l0x_global.h"
+
+QT_BEGIN_NAMESPACE
+
+class QVL53L0XBackend;
+class QVL53L0XGroup;
+class QTimer;
+
+// One worker thread per physical I2C bus, shared by every backend on that bus.
+//
+// Sensors on different buses are brought up in parallel by their own bus
+// threads. Sensors on the same bus are interleaved: while one of them waits
+// for a reference calibration to finish on the device, the bus thread moves
+// on to the register writes of the next one.
+//
+// Once a sensor is up, its measurements are polled by the bus thread as well,
+// each backend with its own timer. Single shot measurements are pipelined the
+// same way: a poll only starts the measurement, and while the device ranges
+// the bus serves the other sensors. The results are collected once the timing
+// budget has passed. The thread can be given a real-time scheduling policy and
+// a CPU affinity, see setScheduling().
+//
+// Sensors of a QVL53L0XGroup are not polled on their own timers, the bus
+// thread triggers them by the group's phase schedule instead.
+//
+// The bus also keeps the books for the load planner: every polling backend
+// reserves the bits per second its poll path puts on the bus, see
+// QVL53L0XBackend::planDataRate(), and no more than maxOccupancy of the bus
+// speed is handed out.
+class QVL53L_X_EXPORT QVL53L0XBus : public QObject
+{
+    Q_OBJECT
+public:
+    static inline const quint32 defaultSpeed = 100000; //Hz, standard mode, when the device tree has no clock-frequency
+    static inline const qreal maxOccupancy = 0.8; //the rest is left for calibrations, retries and other devices on the bus
+
+    static QVL53L0XBus *acquire(const QString &path);
+    static void release(QVL53L0XBus *bus);
+
+    QString path() const;
+
+    void initialize(QVL53L0XBackend *backend);
+    void startPolling(QVL53L0XBackend *backend);
+    void stopPolling(QVL53L0XBackend *backend);
+    void cancel(QVL53L0XBackend *backend);
+
+    bool isPolling(QVL53L0XBackend *backend) const;
+    void reschedule(QVL53L0XBackend *backend);
+    void collect(QVL53L0XBackend *backend);
+
+    void startGroup(QVL53L0XGroup *group);
+    void stopGroup(QVL53L0XGroup *group);
+
+    void setScheduling(int priority, const QList<int> &cpus);
+
+    quint32 speed() const;
+    void setSpeed(quint32 speed);
+    quint64 available(QVL53L0XBackend *backend) const;
+    void reserve(QVL53L0XBackend *backend, quint64 load);
+    qreal occupancy() const;
+
+    static quint32 detectSpeed(const QString &path);
+
+signals:
+    void occupancyChanged(qreal occupancy);
+
+protected slots:
+    void step();
+    void collectMeasurements();
+
+protected:
+    void schedule(int delay);
+    void removePolling(QVL53L0XBackend *backend);
+    void unreserve(QVL53L0XBackend *backend);
+    void removeGroup(QVL53L0XGroup *group);
+    void applyScheduling(int priority, const QList<int> &cpus);
+    void reportError(QString message);
+
+private:
+    explicit QVL53L0XBus(const QString &path);
+    ~QVL53L0XBus();
+
+    QString m_path;
+    QThread m_thread;
+    int m_references = 0;
+
+    //only touched on the bus thread
+    QList<QVL53L0XBackend*> m_initializing;
+    QHash<QVL53L0XBackend*, QTimer*> m_polling;
+    QHash<QVL53L0XGroup*, QTimer*> m_groups;
+    QList<QVL53L0XBackend*> m_measuring; //single shot measurements in flight
+    QTimer *m_collectTimer = nullptr;
+    bool m_stepScheduled = false;
+
+    //load planner, used from the sensor threads
+    mutable QMutex m_planMutex;
+    quint32 m_speed = defaultSpeed; //Hz
+    QHash<QVL53L0XBackend*, quint64> m_loads; //bits per second
+
+    static inline QMutex m_busesMutex;
+    static inline QHash<QString, QVL53L0XBus*> m_buses;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XBUS_H
@@ -0,0 +1,250 @@
+#include "qvl53l0xcapture.h"
+
+#include <QDateTime>
+#include <QtEndian>
+
+#include <cstring>
+
+QVL53L0XCaptureWriter::~QVL53L0XCaptureWriter()
+{
+    close();
+}
+
+// Appends to an existing capture of this format. A record cut short by power
+// loss is dropped, so are the bytes of a header that was never completed.
+// Files of another format or version are left alone and fail to open
+bool QVL53L0XCaptureWriter::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+
+    if(!m_file.open(QIODevice::ReadWrite))
+        return false;
+
+    const qint64 headerSize = sizeof(QVL53L0XCapture::Header);
+    const qint64 recordSize = sizeof(QVL53L0XCapture::Record);
+    qint64 size = m_file.size();
+
+    QVL53L0XCapture::Header header;
+    memset(&header, 0, sizeof(header));
+
+    if(size > 0 && m_file.read(reinterpret_cast<char*>(&header), qMin(size, headerSize)) != qMin(size, headerSize))
+    {
+        m_file.close();
+        return false;
+    }
+
+    //a header cut short is only ours if what was written of the magic matches
+    if(size < headerSize)
+    {
+        if(memcmp(header.magic, QVL53L0XCapture::magic, qMin<qint64>(size, sizeof(header.magic))) != 0 || !m_file.resize(0))
+        {
+            m_file.close();
+            return false;
+        }
+
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, QVL53L0XCapture::magic, sizeof(header.magic));
+
+        header.version = qToLittleEndian(QVL53L0XCapture::version);
+        header.recordSize = qToLittleEndian<quint32>(sizeof(QVL53L0XCapture::Record));
+        header.created = qToLittleEndian<quint64>(QDateTime::currentMSecsSinceEpoch() * 1000);
+
+        if(!m_file.seek(0) || m_file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header))
+        {
+            m_file.close();
+            return false;
+        }
+
+        return m_file.flush();
+    }
+
+    if(memcmp(header.magic, QVL53L0XCapture::magic, sizeof(header.magic)) != 0 ||
+        qFromLittleEndian(header.version) != QVL53L0XCapture::version ||
+        qFromLittleEndian(header.recordSize) != sizeof(QVL53L0XCapture::Record))
+    {
+        m_file.close();
+        return false;
+    }
+
+    //only append whole records after a truncated write
+    qint64 whole = headerSize + (size - headerSize) / recordSize * recordSize;
+
+    if((whole != size && !m_file.resize(whole)) || !m_file.seek(whole))
+    {
+        m_file.close();
+        return false;
+    }
+
+    return m_file.flush();
+}
+
+void QVL53L0XCaptureWriter::close()
+{
+    if(m_file.isOpen())
+        m_file.close();
+}
+
+bool QVL53L0XCaptureWriter::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+QString QVL53L0XCaptureWriter::fileName() const
+{
+    return m_file.fileName();
+}
+
+bool QVL53L0XCaptureWriter::writeResult(quint64 timestamp, const quint8 *result)
+{
+    QVL53L0XCapture::Record record;
+    memset(&record, 0, sizeof(record));
+
+    record.timestamp = timestamp;
+    record.type = QVL53L0XCapture::Result;
+    memcpy(record.result, result, sizeof(record.result));
+
+    return writeRecord(record);
+}
+
+bool QVL53L0XCaptureWriter::writeConfiguration(quint64 timestamp, QVL53L0XCapture::ConfigurationKey key, quint32 value)
+{
+    QVL53L0XCapture::Record record;
+    memset(&record, 0, sizeof(record));
+
+    record.timestamp = timestamp;
+    record.type = QVL53L0XCapture::Configuration;
+    record.key = key;
+    record.value = value;
+
+    return writeRecord(record);
+}
+
+bool QVL53L0XCaptureWriter::writeRecord(const QVL53L0XCapture::Record &record)
+{
+    if(!m_file.isOpen())
+        return false;
+
+    QVL53L0XCapture::Record data = record;
+    data.timestamp = qToLittleEndian(record.timestamp);
+    data.key = qToLittleEndian(record.key);
+    data.value = qToLittleEndian(record.value);
+
+    if(m_file.write(reinterpret_cast<const char*>(&data), sizeof(data)) != sizeof(data))
+        return false;
+
+    //keep the capture usable if the device loses power
+    return m_file.flush();
+}
+
+QVL53L0XCaptureReader::~QVL53L0XCaptureReader()
+{
+    close();
+}
+
+bool QVL53L0XCaptureReader::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+
+    if(!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    if(m_file.size() < (qint64)sizeof(QVL53L0XCapture::Header))
+    {
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, m_file.size());
+
+    if(!m_data)
+    {
+        close();
+        return false;
+    }
+
+    QVL53L0XCapture::Header header;
+    memcpy(&header, m_data, sizeof(header));
+
+    if(memcmp(header.magic, QVL53L0XCapture::magic, sizeof(header.magic)) != 0 ||
+        qFromLittleEndian(header.version) != QVL53L0XCapture::version ||
+        qFromLittleEndian(header.recordSize) != sizeof(QVL53L0XCapture::Record))
+    {
+        close();
+        return false;
+    }
+
+    //a trailing partial record is ignored
+    m_count = (m_file.size() - sizeof(QVL53L0XCapture::Header)) / sizeof(QVL53L0XCapture::Record);
+
+    return true;
+}
+
+void QVL53L0XCaptureReader::close()
+{
+    if(m_data)
+        m_file.unmap(const_cast<uchar*>(m_data));
+
+    if(m_file.isOpen())
+        m_file.close();
+
+    m_data = nullptr;
+    m_count = 0;
+}
+
+bool QVL53L0XCaptureReader::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+qint64 QVL53L0XCaptureReader::count() const
+{
+    return m_count;
+}
+
+QVL53L0XCapture::Record QVL53L0XCaptureReader::record(qint64 index) const
+{
+    QVL53L0XCapture::Record record;
+    memset(&record, 0, sizeof(record));
+
+    if(index < 0 || index >= m_count)
+        return record;
+
+    memcpy(&record, m_data + sizeof(QVL53L0XCapture::Header) + index * sizeof(QVL53L0XCapture::Record), sizeof(record));
+
+    record.timestamp = qFromLittleEndian(record.timestamp);
+    record.key = qFromLittleEndian(record.key);
+    record.value = qFromLittleEndian(record.value);
+
+    return record;
+}
+
+quint64 QVL53L0XCaptureReader::timestamp(qint64 index) const
+{
+    if(index < 0 || index >= m_count)
+        return 0;
+
+    return qFromLittleEndian<quint64>(m_data + sizeof(QVL53L0XCapture::Header) + index * sizeof(QVL53L0XCapture::Record));
+}
+
+// index of the first record at or after timestamp, count() if there is none
+qint64 QVL53L0XCaptureReader::indexOf(quint64 timestamp) const
+{
+    qint64 first = 0;
+    qint64 last = m_count;
+
+    while(first < last)
+    {
+        qint64 middle = first + (last - first) / 2;
+
+        if(this->timestamp(middle) < timestamp)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    return first;
+}
@@ -0,0 +1,111 @@
+#ifndef QVL53L_XCAPTURE_H
+#define QVL53L_XCAPTURE_H
+
+#include <QFile>
+#include <QString>
+
+#include "qvl53l0x_global.h"
+
+QT_BEGIN_NAMESPACE
+
+// Capture file layout (little endian)
+//
+// [Header: 32 bytes][Record: 32 bytes][Record: 32 bytes]...
+//
+// Every record has the same size, so record N lives at
+// sizeof(Header) + N * sizeof(Record) and a mapped capture can be indexed
+// and searched by timestamp without parsing the records before it.
+// Files are only ever appended to, a capture cut short by power loss is
+// still readable up to the last complete record.
+class QVL53L_X_EXPORT QVL53L0XCapture
+{
+public:
+    static inline const char magic[8] = { 'V', 'L', '5', '3', 'L', '0', 'X', 'C' };
+    static inline const quint32 version = 1;
+
+    enum RecordType : quint8
+    {
+        Result = 1,         //raw 12 byte block read from RESULT_RANGE_STATUS
+        Configuration = 2   //configuration change, see ConfigurationKey
+    };
+
+    enum ConfigurationKey : quint16
+    {
+        Address = 1,
+        DataRate = 2,
+        LongRange = 3,
+        FractionalRanging = 4,
+        TimingBudget = 5,   //microseconds
+        VcselDuration = 6,  //microseconds the VCSEL fires per measurement, for the sigma estimate
+        IntegrationTime = 7 //microseconds, pre range and final range timeouts, for the sigma estimate
+    };
+
+    struct Header
+    {
+        char magic[8];
+        quint32 version;
+        quint32 recordSize;
+        quint64 created; //microseconds since epoch
+        quint8 reserved[8];
+    };
+
+    struct Record
+    {
+        quint64 timestamp; //microseconds since epoch
+        quint8 type;
+        quint8 reserved;
+        quint16 key; //configuration records only
+        quint32 value; //configuration records only
+        quint8 result[12]; //result records only
+        quint8 padding[4];
+    };
+
+    static_assert(sizeof(Header) == 32, "capture header must be 32 bytes");
+    static_assert(sizeof(Record) == 32, "capture record must be 32 bytes");
+};
+
+class QVL53L_X_EXPORT QVL53L0XCaptureWriter
+{
+public:
+    QVL53L0XCaptureWriter() = default;
+    ~QVL53L0XCaptureWriter();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+    QString fileName() const;
+
+    bool writeResult(quint64 timestamp, const quint8 *result);
+    bool writeConfiguration(quint64 timestamp, QVL53L0XCapture::ConfigurationKey key, quint32 value);
+
+private:
+    bool writeRecord(const QVL53L0XCapture::Record &record);
+
+    QFile m_file;
+};
+
+class QVL53L_X_EXPORT QVL53L0XCaptureReader
+{
+public:
+    QVL53L0XCaptureReader() = default;
+    ~QVL53L0XCaptureReader();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+
+    qint64 count() const;
+    QVL53L0XCapture::Record record(qint64 index) const;
+
+    quint64 timestamp(qint64 index) const;
+    qint64 indexOf(quint64 timestamp) const;
+
+private:
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_count = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XCAPTURE_H
@@ -0,0 +1,369 @@
+#include "qvl53l0xdiscovery.h"
+#include "qvl53l0xsimulator.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QThread>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDebug>
+
+#include <vector>
+
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/ioctl.h"
+#include "linux/i2c.h"
+#include "linux/i2c-dev.h"
+
+#define IDENTIFICATION_MODEL_ID     0xC0
+#define IDENTIFICATION_REVISION_ID  0xC2
+#define VL53L0X_MODEL_ID            0xEE
+
+QString QVL53L0XDiscovery::cacheFile() const
+{
+    return m_cacheFile;
+}
+
+void QVL53L0XDiscovery::setCacheFile(const QString &cacheFile)
+{
+    m_cacheFile = cacheFile;
+}
+
+quint8 QVL53L0XDiscovery::firstAddress() const
+{
+    return m_firstAddress;
+}
+
+quint8 QVL53L0XDiscovery::lastAddress() const
+{
+    return m_lastAddress;
+}
+
+// 7 bit addresses scanned when the cache does not cover a bus, clamped to
+// 0x08-0x77. Include 0x70-0x77 only on buses without a multiplexer
+void QVL53L0XDiscovery::setScanRange(quint8 firstAddress, quint8 lastAddress)
+{
+    m_firstAddress = qBound(defaultFirstAddress, firstAddress, maxAddress);
+    m_lastAddress = qBound(defaultFirstAddress, lastAddress, maxAddress);
+}
+
+// Blocking, probes every bus on its own thread and returns the devices found
+// on them. An empty list probes every /dev/i2c-* bus. rescan ignores the
+// cache and scans the whole address range of every bus
+QList<QVL53L0XDiscovery::Device> QVL53L0XDiscovery::discover(const QStringList &buses, bool rescan)
+{
+    QStringList paths = buses.isEmpty() ? QVL53L0XDiscovery::buses() : buses;
+
+    if(!m_cacheFile.isEmpty())
+        loadCache();
+
+    std::vector<QList<Device>> found(paths.count());
+    QList<QThread*> threads;
+
+    for(qsizetype i = 0; i < paths.count(); i++)
+    {
+        QList<Device> cached;
+
+        for(const Device &device : m_inventory)
+        {
+            if(!rescan && device.bus == paths[i])
+                cached.append(device);
+        }
+
+        QThread *thread = QThread::create([this, &found, i, bus = paths[i], cached]()
+        {
+            found[i] = discoverBus(bus, cached);
+        });
+
+        thread->setObjectName(QString("QVL53L0X-Discovery@%1").arg(paths[i]));
+        thread->start();
+        threads.append(thread);
+    }
+
+    for(QThread *thread : threads)
+    {
+        thread->wait();
+        delete thread;
+    }
+
+    // buses that were not probed keep their cached devices
+    QList<Device> devices;
+    QList<Device> inventory;
+
+    for(const Device &device : m_inventory)
+    {
+        if(!paths.contains(device.bus))
+            inventory.append(device);
+    }
+
+    for(const QList<Device> &bus : found)
+        devices.append(bus);
+
+    inventory.append(devices);
+    m_inventory = inventory;
+
+    if(!m_cacheFile.isEmpty() && !saveCache())
+        reportError(QString("COULD NOT WRITE CACHE %1").arg(m_cacheFile));
+
+    return devices;
+}
+
+// every device known from the cache or found by discover()
+QList<QVL53L0XDiscovery::Device> QVL53L0XDiscovery::inventory() const
+{
+    return m_inventory;
+}
+
+QStringList QVL53L0XDiscovery::buses()
+{
+    QDir dev("/dev");
+    QStringList buses;
+
+    for(const QString &name : dev.entryList({ "i2c-*" }, QDir::System))
+        buses.append(dev.filePath(name));
+
+    return buses;
+}
+
+// checks a single address, e.g. before a sensor is started on it
+bool QVL53L0XDiscovery::probe(const QString &bus, quint8 address, Device *device)
+{
+    int i2c = -1;
+
+    if(!bus.startsWith(QVL53L0XSimulator::busPrefix) && (i2c = open(bus.toStdString().c_str(), O_RDWR)) < 0)
+        return false;
+
+    Device found;
+    bool identified = identify(i2c, bus, address, &found);
+
+    if(i2c >= 0)
+        close(i2c);
+
+    if(identified && device)
+        *device = found;
+
+    return identified;
+}
+
+// Discovery thread. The cached addresses are verified first, the whole
+// address range is only scanned when there are none or one of them failed
+QList<QVL53L0XDiscovery::Device> QVL53L0XDiscovery::discoverBus(const QString &bus, const QList<Device> &cached) const
+{
+    int i2c = -1;
+
+    if(!bus.startsWith(QVL53L0XSimulator::busPrefix) && (i2c = open(bus.toStdString().c_str(), O_RDWR)) < 0)
+    {
+        reportError(QString("COULD NOT OPEN I2C BUS %1").arg(bus));
+        return {};
+    }
+
+    QList<Device> devices;
+    bool verified = !cached.isEmpty();
+
+    for(const Device &known : cached)
+    {
+        Device device;
+
+        if(!identify(i2c, bus, known.address, &device))
+        {
+            verified = false;
+            break;
+        }
+
+        devices.append(device);
+    }
+
+    if(!verified)
+    {
+        devices.clear();
+
+        for(int address = m_firstAddress; address <= m_lastAddress; address++)
+        {
+            Device device;
+
+            if(identify(i2c, bus, static_cast<quint8>(address), &device))
+                devices.append(device);
+        }
+    }
+
+    if(i2c >= 0)
+        close(i2c);
+
+    return devices;
+}
+
+// reads the identification registers of an address that acknowledges a
+// read, nothing is written to an address nobody answers on
+bool QVL53L0XDiscovery::identify(int i2c, const QString &bus, quint8 address, Device *device)
+{
+    quint8 modelId = 0;
+    quint8 revisionId = 0;
+
+    if(!acknowledges(i2c, bus, address))
+        return false;
+
+    if(!readRegister(i2c, bus, address, IDENTIFICATION_MODEL_ID, &modelId) || modelId != VL53L0X_MODEL_ID)
+        return false;
+
+    if(!readRegister(i2c, bus, address, IDENTIFICATION_REVISION_ID, &revisionId))
+        return false;
+
+    device->bus = bus;
+    device->address = address;
+    device->modelId = modelId;
+    device->revisionId = revisionId;
+
+    return true;
+}
+
+// a single byte read, like i2cdetect -r. Unlike the quick write probe it
+// can not change the state of a device that ignores its register pointer
+bool QVL53L0XDiscovery::acknowledges(int i2c, const QString &bus, quint8 address)
+{
+    quint8 data = 0;
+
+    struct i2c_msg messages[]
+    {
+        {
+            .addr = address,
+            .flags = I2C_M_RD,
+            .len = 1,
+            .buf = &data
+        }
+    };
+
+    struct i2c_rdwr_ioctl_data payload =
+    {
+        .msgs = messages,
+        .nmsgs = 1
+    };
+
+    return transfer(i2c, bus, address, &payload) >= 0;
+}
+
+bool QVL53L0XDiscovery::readRegister(int i2c, const QString &bus, quint8 address, quint8 reg, quint8 *data)
+{
+    struct i2c_msg messages[]
+    {
+        {
+            .addr = address,
+            .flags = 0,
+            .len = 1,
+            .buf = &reg
+        },
+        {
+            .addr = address,
+            .flags = I2C_M_RD,
+            .len = 1,
+            .buf = data
+        }
+    };
+
+    struct i2c_rdwr_ioctl_data payload =
+    {
+        .msgs = messages,
+        .nmsgs = 2
+    };
+
+    return transfer(i2c, bus, address, &payload) >= 0;
+}
+
+// simulated buses are served by the simulator registered for the address
+int QVL53L0XDiscovery::transfer(int i2c, const QString &bus, quint8 address, struct i2c_rdwr_ioctl_data *payload)
+{
+    if(bus.startsWith(QVL53L0XSimulator::busPrefix))
+    {
+        QVL53L0XSimulator *simulator = QVL53L0XSimulator::find(bus, address);
+
+        if(!simulator)
+        {
+            errno = ENXIO;
+            return -1;
+        }
+
+        return simulator->transfer(payload);
+    }
+
+    return ioctl(i2c, I2C_RDWR, payload);
+}
+
+// a missing cache is not an error, there is none before the first discovery
+bool QVL53L0XDiscovery::loadCache()
+{
+    QFile file(m_cacheFile);
+
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+
+    if(error.error != QJsonParseError::NoError || !document.isObject())
+    {
+        reportError(QString("COULD NOT READ CACHE %1 (%2)").arg(m_cacheFile, error.errorString()));
+        return false;
+    }
+
+    QJsonObject root = document.object();
+
+    if(root.value("version").toInt() != static_cast<int>(cacheVersion))
+    {
+        reportError(QString("CACHE %1 HAS AN UNKNOWN VERSION").arg(m_cacheFile));
+        return false;
+    }
+
+    m_inventory.clear();
+
+    for(const QJsonValue &value : root.value("devices").toArray())
+    {
+        QJsonObject object = value.toObject();
+
+        Device device;
+        device.bus = object.value("bus").toString();
+        device.address = static_cast<quint8>(object.value("address").toInt());
+        device.modelId = static_cast<quint8>(object.value("modelId").toInt());
+        device.revisionId = static_cast<quint8>(object.value("revisionId").toInt());
+
+        m_inventory.append(device);
+    }
+
+    return true;
+}
+
+// written to a temporary file first, a cache cut short by power loss is never read
+bool QVL53L0XDiscovery::saveCache() const
+{
+    QJsonArray devices;
+
+    for(const Device &device : m_inventory)
+    {
+        QJsonObject object;
+        object.insert("bus", device.bus);
+        object.insert("address", device.address);
+        object.insert("modelId", device.modelId);
+        object.insert("revisionId", device.revisionId);
+
+        devices.append(object);
+    }
+
+    QJsonObject root;
+    root.insert("version", static_cast<int>(cacheVersion));
+    root.insert("devices", devices);
+
+    QSaveFile file(m_cacheFile);
+
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+
+    return file.commit();
+}
+
+void QVL53L0XDiscovery::reportError(QString message)
+{
+    qDebug() << QString("!! ERROR: %1 - (QVL53L0X-Discovery)").arg(message);
+}
@@ -0,0 +1,82 @@
+#ifndef QVL53L_XDISCOVERY_H
+#define QVL53L_XDISCOVERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+#include "qvl53l0x_global.h"
+
+#include "linux/i2c.h"
+#include "linux/i2c-dev.h"
+
+QT_BEGIN_NAMESPACE
+
+// Finds the VL53L0X devices on one or more I2C buses.
+//
+// Every bus is probed on its own thread, so a rig with several buses takes
+// as long as its slowest bus. A device counts as found when it answers on
+// the address with the VL53L0X model ID (IDENTIFICATION_MODEL_ID 0xEE), the
+// revision ID is recorded along with it.
+//
+// Every address of the scan range is first checked with a read only
+// transfer, only addresses that acknowledge it get the register write of the
+// identification read. The range leaves out 0x70-0x77 by default, where
+// TCA/PCA954x multiplexers take any written byte as their channel selection.
+//
+// With a cache file set, the devices found are stored in it and the next
+// discover() only verifies the cached addresses of a bus. The whole scan
+// range of a bus is scanned again when it has no cached devices or one of
+// them stopped answering.
+class QVL53L_X_EXPORT QVL53L0XDiscovery
+{
+public:
+    static inline const quint8 defaultFirstAddress = 0x08; //the I2C reserved addresses below are never probed
+    static inline const quint8 defaultLastAddress = 0x6F; //I2C multiplexers above
+    static inline const quint8 maxAddress = 0x77; //the I2C reserved addresses above are never probed
+    static inline const quint32 cacheVersion = 1;
+
+    struct Device
+    {
+        QString bus;
+        quint8 address = 0; //as set on QVL53L0X::address
+        quint8 modelId = 0;
+        quint8 revisionId = 0;
+    };
+
+    QVL53L0XDiscovery() = default;
+
+    QString cacheFile() const;
+    void setCacheFile(const QString &cacheFile);
+
+    quint8 firstAddress() const;
+    quint8 lastAddress() const;
+    void setScanRange(quint8 firstAddress, quint8 lastAddress);
+
+    QList<Device> discover(const QStringList &buses = QStringList(), bool rescan = false);
+    QList<Device> inventory() const;
+
+    static QStringList buses();
+    static bool probe(const QString &bus, quint8 address, Device *device = nullptr);
+
+protected:
+    QList<Device> discoverBus(const QString &bus, const QList<Device> &cached) const;
+    bool loadCache();
+    bool saveCache() const;
+
+    static bool identify(int i2c, const QString &bus, quint8 address, Device *device);
+    static bool acknowledges(int i2c, const QString &bus, quint8 address);
+    static int transfer(int i2c, const QString &bus, quint8 address, struct i2c_rdwr_ioctl_data *payload);
+    static bool readRegister(int i2c, const QString &bus, quint8 address, quint8 reg, quint8 *data);
+    static void reportError(QString message);
+
+private:
+    QString m_cacheFile;
+    quint8 m_firstAddress = defaultFirstAddress;
+    quint8 m_lastAddress = defaultLastAddress;
+    QList<Device> m_inventory;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XDISCOVERY_H
@@ -0,0 +1,507 @@
+#include "qvl53l0xgroup.h"
+#include "qvl53l0xbackend.h"
+#include "qvl53l0xbus.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+
+#include "unistd.h"
+#include "sys/eventfd.h"
+
+QVL53L0XGroup::QVL53L0XGroup(QObject *parent) : QObject(parent)
+{
+    qRegisterMetaType<QVL53L0XFrame>();
+
+    // the bus thread signals finished cycles through the eventfd, see queueCycle()
+    m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(m_eventFd >= 0)
+    {
+        m_eventNotifier = new QSocketNotifier(m_eventFd, QSocketNotifier::Read, this);
+        QObject::connect(m_eventNotifier, &QSocketNotifier::activated, this, &QVL53L0XGroup::drain);
+    }
+    else
+        reportError("COULD NOT CREATE EVENT FD");
+}
+
+QVL53L0XGroup::~QVL53L0XGroup()
+{
+    //make sure the bus thread is done with the group
+    stop();
+
+    if(m_eventNotifier)
+        delete m_eventNotifier;
+
+    if(m_eventFd >= 0)
+        close(m_eventFd);
+}
+
+bool QVL53L0XGroup::addSensor(QVL53L0X *sensor)
+{
+    if(!sensor || m_sensors.contains(sensor))
+        return false;
+
+    if(m_active)
+    {
+        reportError("CANNOT ADD SENSORS WHILE ACTIVE");
+        return false;
+    }
+
+    if(m_sensors.count() >= maxSensors)
+    {
+        reportError(QString("A GROUP HOLDS AT MOST %1 SENSORS").arg(maxSensors));
+        return false;
+    }
+
+    m_sensors.append(sensor);
+    m_customPhases.append(0);
+
+    // queued, so the backend has started polling by the time the slot runs
+    QObject::connect(sensor, &QVL53L0X::initializationFinished, this, &QVL53L0XGroup::onSensorInitializationFinished, Qt::QueuedConnection);
+
+    return true;
+}
+
+void QVL53L0XGroup::removeSensor(QVL53L0X *sensor)
+{
+    qsizetype index = m_sensors.indexOf(sensor);
+
+    if(index < 0)
+        return;
+
+    stop();
+
+    QObject::disconnect(sensor, &QVL53L0X::initializationFinished, this, &QVL53L0XGroup::onSensorInitializationFinished);
+
+    m_sensors.removeAt(index);
+    m_customPhases.removeAt(index);
+}
+
+QList<QVL53L0X *> QVL53L0XGroup::sensors() const
+{
+    return m_sensors;
+}
+
+// the phase the sensor fires in with the current schedule
+int QVL53L0XGroup::phase(QVL53L0X *sensor) const
+{
+    qsizetype index = m_sensors.indexOf(sensor);
+
+    if(index < 0)
+        return -1;
+
+    switch(m_schedule)
+    {
+    case Staggered:
+        return index;
+    case Interleaved:
+        return index % 2;
+    case Simultaneous:
+        return 0;
+    case Custom:
+        return m_customPhases[index];
+    }
+
+    return 0;
+}
+
+// used by the Custom schedule, sensors sharing a phase fire together
+void QVL53L0XGroup::setPhase(QVL53L0X *sensor, int phase)
+{
+    qsizetype index = m_sensors.indexOf(sensor);
+
+    if(index < 0 || phase < 0)
+        return;
+
+    m_customPhases[index] = phase;
+}
+
+QVL53L0XGroup::Schedule QVL53L0XGroup::schedule() const
+{
+    return m_schedule;
+}
+
+// takes effect on the next start()
+void QVL53L0XGroup::setSchedule(Schedule schedule)
+{
+    if (m_schedule == schedule)
+        return;
+
+    m_schedule = schedule;
+    emit scheduleChanged();
+}
+
+int QVL53L0XGroup::phaseInterval() const
+{
+    return m_phaseInterval;
+}
+
+// takes effect on the next start()
+void QVL53L0XGroup::setPhaseInterval(int phaseInterval)
+{
+    phaseInterval = qMax(1, phaseInterval);
+
+    if (m_phaseInterval == phaseInterval)
+        return;
+
+    m_phaseInterval = phaseInterval;
+    emit phaseIntervalChanged();
+}
+
+int QVL53L0XGroup::cycleInterval() const
+{
+    return m_cycleInterval;
+}
+
+// takes effect on the next start(), cycles never get shorter than all phases
+void QVL53L0XGroup::setCycleInterval(int cycleInterval)
+{
+    cycleInterval = qMax(0, cycleInterval);
+
+    if (m_cycleInterval == cycleInterval)
+        return;
+
+    m_cycleInterval = cycleInterval;
+    emit cycleIntervalChanged();
+}
+
+bool QVL53L0XGroup::isActive() const
+{
+    return m_active;
+}
+
+// brings up the sensors, the schedule starts once all of them are polling
+void QVL53L0XGroup::start()
+{
+    if(m_active)
+        return;
+
+    if(m_sensors.isEmpty())
+    {
+        reportError("NO SENSORS IN GROUP");
+        return;
+    }
+
+    m_backends.clear();
+
+    for(QVL53L0X *sensor : m_sensors)
+    {
+        if(!sensor->isConnectedToBackend())
+            sensor->connectToBackend();
+
+        if(!sensor->m_backend)
+        {
+            reportError(QString("SENSOR 0x%1 IS NOT CONNECTED TO THE HARDWARE BACKEND").arg(sensor->address(), 2, 16, QChar('0')));
+            m_backends.clear();
+            return;
+        }
+
+        m_backends.append(sensor->m_backend);
+    }
+
+    m_active = true;
+    emit activeChanged();
+
+    for(qsizetype i = 0; i < m_sensors.count(); i++)
+    {
+        // sensors polling on their own are restarted as grouped sensors
+        if(m_sensors[i]->isActive())
+            m_sensors[i]->stop();
+
+        m_backends[i]->m_grouped = true;
+        m_sensors[i]->start();
+    }
+
+    startSchedule();
+}
+
+void QVL53L0XGroup::stop()
+{
+    if(!m_active)
+        return;
+
+    m_active = false;
+
+    // blocks until the bus thread has read the last phase
+    if(m_running)
+    {
+        m_bus->stopGroup(this);
+        QVL53L0XBus::release(m_bus);
+        m_bus = nullptr;
+        m_running = false;
+
+        drain();
+    }
+
+    for(qsizetype i = 0; i < m_sensors.count(); i++)
+    {
+        m_sensors[i]->stop();
+        m_backends[i]->m_grouped = false;
+    }
+
+    emit activeChanged();
+}
+
+void QVL53L0XGroup::onSensorInitializationFinished(bool success)
+{
+    if(!m_active)
+        return;
+
+    if(!success)
+    {
+        reportError("COULD NOT INITIALIZE GROUPED SENSOR");
+        stop();
+        return;
+    }
+
+    startSchedule();
+}
+
+// hands the schedule to the bus thread once every sensor is polling
+void QVL53L0XGroup::startSchedule()
+{
+    if(!m_active || m_running)
+        return;
+
+    for(QVL53L0XBackend *backend : m_backends)
+    {
+        if(!backend->m_polling)
+            return;
+    }
+
+    QVL53L0XBus *bus = m_backends.first()->m_busController;
+
+    for(QVL53L0XBackend *backend : m_backends)
+    {
+        if(backend->m_busController != bus)
+        {
+            reportError("GROUPED SENSORS HAVE TO SHARE ONE BUS");
+            stop();
+            return;
+        }
+    }
+
+    m_phases.clear();
+
+    for(QVL53L0X *sensor : m_sensors)
+    {
+        int sensorPhase = phase(sensor);
+
+        while(m_phases.count() <= sensorPhase)
+            m_phases.append(QList<int>());
+
+        m_phases[sensorPhase].append(m_sensors.indexOf(sensor));
+    }
+
+    // custom schedules may leave phases unused
+    for(qsizetype i = 0; i < m_phases.count();)
+    {
+        if(m_phases[i].isEmpty())
+            m_phases.removeAt(i);
+        else
+            i++;
+    }
+
+    m_schedulePhaseInterval = m_phaseInterval;
+    m_scheduleCycleInterval = m_cycleInterval;
+
+    // keeps the bus thread around while the schedule runs on it
+    m_bus = QVL53L0XBus::acquire(bus->path());
+    m_running = true;
+    m_bus->startGroup(this);
+
+    reportEvent(QString("RUNNING %1 SENSORS IN %2 PHASES").arg(m_sensors.count()).arg(m_phases.count()));
+}
+
+// bus thread, before the first step()
+void QVL53L0XGroup::beginSchedule()
+{
+    m_clock.start();
+    m_step = 0;
+    m_cycleNumber = 0;
+}
+
+// Runs on the bus thread. Reads the phase started by the last step and starts
+// the next one, returns the time in ms until the next step is due
+int QVL53L0XGroup::step()
+{
+    if(m_step == 0)
+    {
+        m_cycleStart = m_clock.elapsed();
+
+        m_cycle.number = m_cycleNumber++;
+        m_cycle.timestamp = QVL53L0XBackend::timestamp();
+        m_cycle.count = m_backends.count();
+        std::fill(std::begin(m_cycle.ready), std::end(m_cycle.ready), false);
+    }
+    else
+        collect(m_step - 1);
+
+    if(m_step < m_phases.count())
+    {
+        trigger(m_step++);
+        return qMax<qint64>(0, m_cycleStart + m_step * m_schedulePhaseInterval - m_clock.elapsed());
+    }
+
+    queueCycle();
+    m_step = 0;
+
+    qint64 cycleInterval = qMax<qint64>(m_scheduleCycleInterval, m_phases.count() * m_schedulePhaseInterval);
+
+    return qMax<qint64>(0, m_cycleStart + cycleInterval - m_clock.elapsed());
+}
+
+// bus thread, after the last step()
+void QVL53L0XGroup::endSchedule()
+{
+    // don't leave a result latched on the devices
+    if(m_step > 0)
+        collect(m_step - 1);
+
+    m_step = 0;
+}
+
+void QVL53L0XGroup::trigger(int phase)
+{
+    for(int index : m_phases[phase])
+    {
+        QVL53L0XBackend *backend = m_backends[index];
+
+        // restarted after a fault, rejoins the schedule once it is polling again
+        if(!m_bus->isPolling(backend))
+            continue;
+
+        bool calibrating = false;
+
+        // configuration changes and recalibrations are applied between
+        // measurements, as in QVL53L0XBackend::poll()
+        if(!backend->finishRecalibration(calibrating))
+        {
+            backend->queueFault();
+            continue;
+        }
+
+        // sits this cycle out, the calibration is collected by the next trigger
+        if(calibrating)
+            continue;
+
+        if((backend->m_changes && !backend->applyChanges()) || !backend->startRanging())
+            backend->queueFault();
+    }
+}
+
+void QVL53L0XGroup::collect(int phase)
+{
+    for(int index : m_phases[phase])
+    {
+        QVL53L0XBackend *backend = m_backends[index];
+        bool ready = false;
+
+        // not ranging, the interrupt belongs to the calibration
+        if(!m_bus->isPolling(backend) || backend->isRecalibrating())
+            continue;
+
+        if(!backend->readContinuous(ready))
+        {
+            backend->queueFault();
+            continue;
+        }
+
+        // still ranging, the phase interval is shorter than the timing budget
+        if(!ready)
+            continue;
+
+        m_cycle.ready[index] = true;
+        m_cycle.fractionalRanging[index] = backend->m_fractionalRanging;
+        m_cycle.sigmaTimings[index] = backend->m_sigmaTiming;
+        m_cycle.timestamps[index] = QVL53L0XBackend::timestamp();
+        memcpy(m_cycle.results[index], backend->m_result, sizeof(m_cycle.results[index]));
+
+        // as in QVL53L0XBackend::queueResult(), the group queues the cycle instead
+        backend->m_metrics.recordResult(QVL53L0XBackend::decodeRangeStatus(backend->m_result));
+
+        if(!backend->beginRecalibration())
+            backend->queueFault();
+    }
+}
+
+// hands the cycle to the group's thread without allocating or locking
+void QVL53L0XGroup::queueCycle()
+{
+    if(!m_cycles.push(m_cycle))
+    {
+        m_droppedCycles.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    quint64 one = 1;
+
+    // EAGAIN only when the counter is saturated, the group's thread is woken anyway
+    if(m_eventFd >= 0 && ::write(m_eventFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        reportError(QString("COULD NOT WAKE THE GROUP THREAD (%1)").arg(strerror(errno)));
+}
+
+// decodes every cycle queued since the last call into the frame and emits it
+void QVL53L0XGroup::drain()
+{
+    quint64 count = 0;
+
+    // EAGAIN when an earlier drain already took the cycles of this wakeup
+    if(m_eventFd >= 0 && ::read(m_eventFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        reportError(QString("COULD NOT READ THE CYCLE COUNTER (%1)").arg(strerror(errno)));
+
+    Cycle cycle;
+
+    while(m_cycles.pop(cycle))
+    {
+        m_frame.cycle = cycle.number;
+        m_frame.timestamp = cycle.timestamp;
+        m_frame.timestamps.resize(cycle.count);
+        m_frame.distances.resize(cycle.count);
+        m_frame.sigmas.resize(cycle.count);
+        m_frame.rangeStatus.resize(cycle.count);
+
+        for(quint32 i = 0; i < cycle.count; i++)
+        {
+            if(!cycle.ready[i])
+            {
+                m_frame.timestamps[i] = 0;
+                m_frame.distances[i] = 0;
+                m_frame.sigmas[i] = 0;
+                m_frame.rangeStatus[i] = QVL53L0XReading::NoUpdate;
+                continue;
+            }
+
+            const quint8 *result = cycle.results[i];
+            qreal sigma = QVL53L0XBackend::estimateSigma(QVL53L0XBackend::decodeSignalRate(result), QVL53L0XBackend::decodeAmbientRate(result), cycle.sigmaTimings[i]);
+
+            m_backends[i]->recordSample(cycle.timestamps[i], result, cycle.fractionalRanging[i], cycle.sigmaTimings[i]);
+
+            m_frame.timestamps[i] = cycle.timestamps[i];
+            m_frame.distances[i] = QVL53L0XBackend::decodeRange(result, cycle.fractionalRanging[i]);
+            m_frame.sigmas[i] = sigma;
+            m_frame.rangeStatus[i] = m_backends[i]->checkLimits(QVL53L0XBackend::decodeRangeStatus(result), sigma);
+        }
+
+        emit frameReady(m_frame);
+    }
+
+    quint32 dropped = m_droppedCycles.exchange(0, std::memory_order_relaxed);
+
+    if(dropped > 0)
+        reportError(QString("DROPPED %1 FRAMES").arg(dropped));
+}
+
+void QVL53L0XGroup::reportEvent(QString message)
+{
+    //report event if backendDebug is true
+    if(m_backendDebug)
+        qDebug() << QString("** %1 - (QVL53L0X-Group)").arg(message);
+}
+
+void QVL53L0XGroup::reportError(QString message)
+{
+    qDebug() << QString("!! ERROR: %1 - (QVL53L0X-Group)").arg(message);
+}
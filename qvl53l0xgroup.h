@@ -0,0 +1,164 @@
+#ifndef QVL53L_XGROUP_H
+#define QVL53L_XGROUP_H
+
+#include <QObject>
+#include <QList>
+#include <QElapsedTimer>
+#include <QSocketNotifier>
+
+#include <atomic>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0x.h"
+#include "qvl53l0xreading.h"
+#include "qvl53l0xringbuffer.h"
+#include "qvl53l0xbackend.h"
+
+QT_BEGIN_NAMESPACE
+
+class QVL53L0XBus;
+
+// One cycle of a QVL53L0XGroup as a structure of arrays, index i of every
+// list belongs to the i-th sensor of the group
+struct QVL53L_X_EXPORT QVL53L0XFrame
+{
+    quint64 cycle = 0;
+    quint64 timestamp = 0; //start of the cycle, microseconds since epoch
+    QList<quint64> timestamps; //when each result was read, 0 without a result
+    QList<qreal> distances; //mm
+    QList<qreal> sigmas; //mm, estimated range uncertainty
+    QList<QVL53L0XReading::RangeStatus> rangeStatus; //NoUpdate when a sensor had no result in time
+};
+
+// Triggers a set of sensors on one bus by a phase schedule and emits all of
+// their distances once per cycle.
+//
+// Every phase the bus thread reads the results of the previous phase and
+// starts single shot measurements on the sensors of the next one. Sensors
+// in the same phase fire together and are as close in time as the bus
+// allows, sensors in different phases never see each other's laser.
+//
+// The sensors are started and stopped by the group and do not emit readings
+// of their own while it is active. The group has to live on the thread of
+// its sensors, and all of them need to use the hardware backend on the
+// same bus.
+class QVL53L_X_EXPORT QVL53L0XGroup : public QObject
+{
+    Q_OBJECT
+    friend class QVL53L0XBus;
+public:
+    enum Schedule
+    {
+        Staggered,      //one sensor per phase
+        Interleaved,    //even and odd sensors alternate, neighbours never fire together
+        Simultaneous,   //every sensor in one phase
+        Custom          //phases set with setPhase()
+    };
+    Q_ENUM(Schedule)
+
+    static inline const int maxSensors = 16;
+
+    explicit QVL53L0XGroup(QObject *parent = nullptr);
+    ~QVL53L0XGroup();
+
+    bool addSensor(QVL53L0X *sensor);
+    void removeSensor(QVL53L0X *sensor);
+    QList<QVL53L0X*> sensors() const;
+
+    int phase(QVL53L0X *sensor) const;
+    void setPhase(QVL53L0X *sensor, int phase);
+
+    Schedule schedule() const;
+    void setSchedule(Schedule schedule);
+
+    int phaseInterval() const;
+    void setPhaseInterval(int phaseInterval);
+
+    int cycleInterval() const;
+    void setCycleInterval(int cycleInterval);
+
+    bool isActive() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void frameReady(const QVL53L0XFrame &frame);
+    void activeChanged();
+    void scheduleChanged();
+    void phaseIntervalChanged();
+    void cycleIntervalChanged();
+
+protected slots:
+    void onSensorInitializationFinished(bool success);
+    void drain();
+
+protected:
+    void startSchedule();
+
+    // bus thread
+    void beginSchedule();
+    int step();
+    void endSchedule();
+    void trigger(int phase);
+    void collect(int phase);
+    void queueCycle();
+
+    void reportEvent(QString message);
+    void reportError(QString message);
+
+private:
+    // handed from the bus thread to the group's thread, see queueCycle()
+    struct Cycle
+    {
+        quint64 number = 0;
+        quint64 timestamp = 0; //microseconds since epoch
+        quint32 count = 0;
+        bool ready[maxSensors] = {};
+        bool fractionalRanging[maxSensors] = {};
+        QVL53L0XBackend::SigmaTiming sigmaTimings[maxSensors] = {}; //for the sigma estimate
+        quint64 timestamps[maxSensors] = {};
+        quint8 results[maxSensors][12] = {}; //RESULT_RANGE_STATUS blocks
+    };
+
+    QList<QVL53L0X*> m_sensors;
+    QList<int> m_customPhases; //per sensor, used by the Custom schedule
+    Schedule m_schedule = Staggered;
+    int m_phaseInterval = 35; //ms, has to cover the measurement timing budget
+    int m_cycleInterval = 0; //ms, 0 starts the next cycle as soon as the last phase is read
+    bool m_active = false;
+    bool m_running = false; //schedule running on the bus thread
+    bool m_backendDebug = true;
+
+    // set up by startSchedule() before the bus thread takes over
+    QVL53L0XBus *m_bus = nullptr;
+    QList<QVL53L0XBackend*> m_backends;
+    QList<QList<int>> m_phases; //sensor indexes per phase
+    qint64 m_schedulePhaseInterval = 0;
+    qint64 m_scheduleCycleInterval = 0;
+
+    // bus thread only
+    QElapsedTimer m_clock;
+    qint64 m_cycleStart = 0;
+    int m_step = 0;
+    quint64 m_cycleNumber = 0;
+    Cycle m_cycle;
+
+    QVL53L0XRingBuffer<Cycle, 4> m_cycles;
+    std::atomic<quint32> m_droppedCycles = 0;
+    int m_eventFd = -1;
+    QSocketNotifier *m_eventNotifier = nullptr;
+    QVL53L0XFrame m_frame; //reused for every frameReady()
+
+    Q_PROPERTY(Schedule schedule READ schedule WRITE setSchedule NOTIFY scheduleChanged FINAL)
+    Q_PROPERTY(int phaseInterval READ phaseInterval WRITE setPhaseInterval NOTIFY phaseIntervalChanged FINAL)
+    Q_PROPERTY(int cycleInterval READ cycleInterval WRITE setCycleInterval NOTIFY cycleIntervalChanged FINAL)
+    Q_PROPERTY(bool active READ isActive NOTIFY activeChanged FINAL)
+};
+
+QT_END_NAMESPACE
+
+Q_DECLARE_METATYPE(QVL53L0XFrame)
+
+#endif // QVL53L_XGROUP_H
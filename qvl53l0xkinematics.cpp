@@ -0,0 +1,184 @@
+#include "qvl53l0xkinematics.h"
+
+#include <QtNumeric>
+
+QVL53L0XKinematics::QVL53L0XKinematics(int window)
+{
+    setWindow(window);
+}
+
+int QVL53L0XKinematics::window() const
+{
+    return m_window;
+}
+
+// ranges in the window, a new window starts over
+void QVL53L0XKinematics::setWindow(int window)
+{
+    m_window = qMax(minimumWindow, window);
+    m_ranges.resize(m_window);
+    m_velocities.resize(m_window);
+    reset();
+}
+
+// Sensor thread, ranges have to be valid and in timestamp order. A timestamp
+// before the previous one starts over
+void QVL53L0XKinematics::update(quint64 timestamp, qreal distance)
+{
+    if(m_start == 0 || timestamp < m_last)
+    {
+        reset();
+        m_start = timestamp;
+    }
+
+    m_last = timestamp;
+    m_ranges.add((m_last - m_start) / 1000000.0, distance);
+
+    if(m_ranges.count() >= minimumWindow)
+        m_velocities.add(m_ranges.centre(), m_ranges.slope());
+}
+
+void QVL53L0XKinematics::reset()
+{
+    m_start = 0;
+    m_last = 0;
+    m_ranges.clear();
+    m_velocities.clear();
+}
+
+// a velocity takes two ranges, an acceleration three
+bool QVL53L0XKinematics::isValid() const
+{
+    return m_ranges.count() >= minimumWindow;
+}
+
+qreal QVL53L0XKinematics::velocity() const
+{
+    return m_ranges.slope();
+}
+
+qreal QVL53L0XKinematics::acceleration() const
+{
+    return m_velocities.slope();
+}
+
+// first order, the distance of the fitted line now over the closing speed
+qreal QVL53L0XKinematics::timeToContact() const
+{
+    qreal velocity = m_ranges.slope();
+
+    if(!(velocity < 0))
+        return qInf();
+
+    return qMax<qreal>(0, m_ranges.valueAt((m_last - m_start) / 1000000.0)) / -velocity;
+}
+
+void QVL53L0XKinematics::Fit::resize(int window)
+{
+    m_points.assign(window, Point());
+    clear();
+}
+
+void QVL53L0XKinematics::Fit::clear()
+{
+    m_head = 0;
+    m_count = 0;
+    m_added = 0;
+    m_origin = 0;
+    m_sumX = 0;
+    m_sumY = 0;
+    m_sumXX = 0;
+    m_sumXY = 0;
+}
+
+void QVL53L0XKinematics::Fit::add(qreal x, qreal y)
+{
+    if(m_count == m_points.size())
+    {
+        const Point &oldest = m_points[m_head];
+        qreal dx = oldest.x - m_origin;
+
+        m_sumX -= dx;
+        m_sumY -= oldest.y;
+        m_sumXX -= dx * dx;
+        m_sumXY -= dx * oldest.y;
+
+        m_head = (m_head + 1) % m_points.size();
+        m_count--;
+    }
+    else if(m_count == 0)
+        m_origin = x;
+
+    m_points[(m_head + m_count) % m_points.size()] = { x, y };
+    m_count++;
+
+    qreal dx = x - m_origin;
+
+    m_sumX += dx;
+    m_sumY += y;
+    m_sumXX += dx * dx;
+    m_sumXY += dx * y;
+
+    // the subtractions leave rounding errors behind, once per window they
+    // are cleared out and the origin follows the window
+    if(++m_added >= m_points.size())
+        rebase();
+}
+
+int QVL53L0XKinematics::Fit::count() const
+{
+    return static_cast<int>(m_count);
+}
+
+// 0 until the window has two points at different x
+qreal QVL53L0XKinematics::Fit::slope() const
+{
+    if(m_count < 2)
+        return 0;
+
+    qreal divisor = m_count * m_sumXX - m_sumX * m_sumX;
+
+    if(divisor <= 0)
+        return 0;
+
+    return (m_count * m_sumXY - m_sumX * m_sumY) / divisor;
+}
+
+qreal QVL53L0XKinematics::Fit::valueAt(qreal x) const
+{
+    if(m_count == 0)
+        return 0;
+
+    return m_sumY / m_count + slope() * (x - centre());
+}
+
+// the mean x of the window, where the line is best determined
+qreal QVL53L0XKinematics::Fit::centre() const
+{
+    if(m_count == 0)
+        return m_origin;
+
+    return m_origin + m_sumX / m_count;
+}
+
+// O(window) once per window, O(1) per point
+void QVL53L0XKinematics::Fit::rebase()
+{
+    m_origin = m_points[m_head].x;
+    m_sumX = 0;
+    m_sumY = 0;
+    m_sumXX = 0;
+    m_sumXY = 0;
+    m_added = 0;
+
+    for(size_t i = 0; i < m_count; i++)
+    {
+        const Point &point = m_points[(m_head + i) % m_points.size()];
+        qreal dx = point.x - m_origin;
+
+        m_sumX += dx;
+        m_sumY += point.y;
+        m_sumXX += dx * dx;
+        m_sumXY += dx * point.y;
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef QVL53L_XKINEMATICS_H
+#define QVL53L_XKINEMATICS_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+#include "qvl53l0x_global.h"
+
+QT_BEGIN_NAMESPACE
+
+// Velocity, acceleration and time to contact of the target, O(1) per range.
+//
+// The velocity is the slope of a least squares line through the last window
+// ranges, the acceleration the slope of one through the last window
+// velocities. Both lines are kept as running sums, a range adds its terms and
+// the one leaving the window takes its terms back out. Each estimate is for
+// the middle of its window, so the velocity lags the target by half a window
+// and the acceleration by a whole one
+class QVL53L_X_EXPORT QVL53L0XKinematics
+{
+public:
+    static inline const int defaultWindow = 8;
+    static inline const int minimumWindow = 2;
+
+    explicit QVL53L0XKinematics(int window = defaultWindow);
+
+    int window() const;
+    void setWindow(int window);
+
+    void update(quint64 timestamp, qreal distance);
+    void reset();
+
+    bool isValid() const;
+    qreal velocity() const; //mm/s, negative while the target approaches
+    qreal acceleration() const; //mm/s^2
+    qreal timeToContact() const; //s, at the current velocity, infinite unless the target approaches
+
+private:
+    // least squares line through the last window points
+    class Fit
+    {
+    public:
+        void resize(int window);
+        void clear();
+        void add(qreal x, qreal y);
+
+        int count() const;
+        qreal slope() const;
+        qreal valueAt(qreal x) const;
+        qreal centre() const;
+
+    private:
+        void rebase();
+
+        struct Point
+        {
+            qreal x;
+            qreal y;
+        };
+
+        std::vector<Point> m_points; //ring, the oldest point at m_head once full
+        size_t m_head = 0;
+        size_t m_count = 0;
+        size_t m_added = 0; //points since the last rebase()
+
+        // sums over the window, with x relative to m_origin
+        qreal m_origin = 0;
+        qreal m_sumX = 0;
+        qreal m_sumY = 0;
+        qreal m_sumXX = 0;
+        qreal m_sumXY = 0;
+    };
+
+    int m_window = defaultWindow;
+    quint64 m_start = 0; //microseconds, timestamp of the first range since reset(), 0 before it
+    quint64 m_last = 0; //microseconds, timestamp of the last range
+    Fit m_ranges;
+    Fit m_velocities;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XKINEMATICS_H
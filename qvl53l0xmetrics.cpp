@@ -0,0 +1,133 @@
+#include "qvl53l0xmetrics.h"
+
+#include <QtNumeric>
+
+#include <bit>
+
+void QVL53L0XMetrics::recordPoll(qint64 nanoseconds)
+{
+    quint64 microseconds = static_cast<quint64>(qMax<qint64>(0, nanoseconds)) / 1000;
+    int bucket = qMin<int>(std::bit_width(microseconds), latencyBuckets - 1);
+
+    add(m_latency[bucket]);
+    add(m_pollNanoseconds, static_cast<quint64>(qMax<qint64>(0, nanoseconds)));
+}
+
+void QVL53L0XMetrics::recordResult(QVL53L0XReading::RangeStatus status)
+{
+    add(m_samples);
+    add(m_rangeStatus[rangeStatusIndex(status)]);
+}
+
+// bring up and address changes may fail on the sensor thread before the bus
+// thread has taken over, errors are rare enough for a locked add
+void QVL53L0XMetrics::recordError(int error)
+{
+    m_errors[error > 0 && error < errorCodes ? error : 0].fetch_add(1, std::memory_order_relaxed);
+}
+
+void QVL53L0XMetrics::recordTimeout()
+{
+    add(m_timeouts);
+}
+
+void QVL53L0XMetrics::recordRestart()
+{
+    add(m_restarts);
+}
+
+void QVL53L0XMetrics::recordRecovery()
+{
+    add(m_recoveries);
+}
+
+void QVL53L0XMetrics::recordCalibration(qint64 timestamp)
+{
+    m_lastCalibration.store(timestamp, std::memory_order_relaxed);
+}
+
+QVL53L0XMetrics::Snapshot QVL53L0XMetrics::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.samples = m_samples.load(std::memory_order_relaxed);
+    snapshot.pollNanoseconds = m_pollNanoseconds.load(std::memory_order_relaxed);
+    snapshot.timeouts = m_timeouts.load(std::memory_order_relaxed);
+    snapshot.restarts = m_restarts.load(std::memory_order_relaxed);
+    snapshot.recoveries = m_recoveries.load(std::memory_order_relaxed);
+    snapshot.lastCalibration = m_lastCalibration.load(std::memory_order_relaxed);
+
+    for(int i = 0; i < latencyBuckets; i++)
+        snapshot.latency[i] = m_latency[i].load(std::memory_order_relaxed);
+
+    for(int i = 0; i < errorCodes; i++)
+        snapshot.errors[i] = m_errors[i].load(std::memory_order_relaxed);
+
+    for(int i = 0; i < rangeStatuses; i++)
+        snapshot.rangeStatus[i] = m_rangeStatus[i].load(std::memory_order_relaxed);
+
+    return snapshot;
+}
+
+int QVL53L0XMetrics::rangeStatusIndex(QVL53L0XReading::RangeStatus status)
+{
+    if(status >= QVL53L0XReading::RangeValid && status <= QVL53L0XReading::HardwareFail)
+        return status;
+
+    return rangeStatuses - 1;
+}
+
+// a single writer needs no read-modify-write, the load and store are as
+// cheap as a plain increment
+void QVL53L0XMetrics::add(std::atomic<quint64> &counter, quint64 value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+quint64 QVL53L0XMetrics::Snapshot::polls() const
+{
+    quint64 polls = 0;
+
+    for(quint64 count : latency)
+        polls += count;
+
+    return polls;
+}
+
+// Seconds, interpolated within the bucket the quantile falls into. With since
+// only the polls after that snapshot count. NaN without polls, as Prometheus
+// expects of an empty summary
+qreal QVL53L0XMetrics::Snapshot::latencyQuantile(qreal quantile, const Snapshot *since) const
+{
+    std::array<quint64, latencyBuckets> counts = latency;
+    quint64 total = 0;
+
+    for(int i = 0; i < latencyBuckets; i++)
+    {
+        if(since)
+            counts[i] -= qMin(counts[i], since->latency[i]);
+
+        total += counts[i];
+    }
+
+    if(total == 0)
+        return qQNaN();
+
+    qreal rank = qBound<qreal>(0, quantile, 1) * total;
+    quint64 seen = 0;
+
+    for(int i = 0; i < latencyBuckets; i++)
+    {
+        if(counts[i] == 0 || seen + counts[i] < rank)
+        {
+            seen += counts[i];
+            continue;
+        }
+
+        qreal lower = i == 0 ? 0 : static_cast<qreal>(1ull << (i - 1));
+        qreal upper = static_cast<qreal>(1ull << i);
+
+        return (lower + (upper - lower) * (rank - seen) / counts[i]) / 1000000.0;
+    }
+
+    return static_cast<qreal>(1ull << (latencyBuckets - 1)) / 1000000.0;
+}
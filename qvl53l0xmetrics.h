@@ -0,0 +1,76 @@
+#ifndef QVL53L_XMETRICS_H
+#define QVL53L_XMETRICS_H
+
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0xreading.h"
+
+QT_BEGIN_NAMESPACE
+
+// Counters of one sensor for monitoring, exported by QVL53L0XMetricsExporter.
+//
+// Updated where the events happen, mostly on the bus thread, with relaxed
+// atomic stores and no locks or allocations. Every counter but the errors has
+// a single writer. A reader takes a snapshot() from any thread, its counters
+// may be a few events apart from each other.
+//
+// Poll latencies are counted in buckets of power of two microseconds, the
+// quantiles are estimated from them by the reader
+class QVL53L_X_EXPORT QVL53L0XMetrics
+{
+public:
+    static inline const int latencyBuckets = 24; //[0, 1us), [1us, 2us), ... the last one from 2^22us (4.2s) up
+    static inline const int errorCodes = 134; //errno values counted, larger ones are counted as 0
+    static inline const int rangeStatuses = 7; //QVL53L0XReading::RangeStatus, NoUpdate last
+
+    struct Snapshot
+    {
+        quint64 samples = 0;
+        quint64 pollNanoseconds = 0;
+        std::array<quint64, latencyBuckets> latency = {};
+        std::array<quint64, errorCodes> errors = {};
+        std::array<quint64, rangeStatuses> rangeStatus = {};
+        quint64 timeouts = 0;
+        quint64 restarts = 0;
+        quint64 recoveries = 0;
+        qint64 lastCalibration = 0; //ms since epoch, 0 before the first
+
+        quint64 polls() const;
+        qreal latencyQuantile(qreal quantile, const Snapshot *since = nullptr) const;
+    };
+
+    QVL53L0XMetrics() = default;
+
+    void recordPoll(qint64 nanoseconds);
+    void recordResult(QVL53L0XReading::RangeStatus status);
+    void recordError(int error);
+    void recordTimeout();
+    void recordRestart();
+    void recordRecovery();
+    void recordCalibration(qint64 timestamp);
+
+    Snapshot snapshot() const;
+
+    static int rangeStatusIndex(QVL53L0XReading::RangeStatus status);
+
+private:
+    static void add(std::atomic<quint64> &counter, quint64 value = 1);
+
+    std::atomic<quint64> m_samples = 0;
+    std::atomic<quint64> m_pollNanoseconds = 0;
+    std::array<std::atomic<quint64>, latencyBuckets> m_latency = {};
+    std::array<std::atomic<quint64>, errorCodes> m_errors = {};
+    std::array<std::atomic<quint64>, rangeStatuses> m_rangeStatus = {};
+    std::atomic<quint64> m_timeouts = 0;
+    std::atomic<quint64> m_restarts = 0;
+    std::atomic<quint64> m_recoveries = 0;
+    std::atomic<qint64> m_lastCalibration = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XMETRICS_H
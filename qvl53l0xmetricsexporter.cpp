@@ -0,0 +1,383 @@
+#include "qvl53l0xmetricsexporter.h"
+
+#include <QDebug>
+#include <QSaveFile>
+#include <QtNumeric>
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "unistd.h"
+#include "sys/socket.h"
+#include "sys/un.h"
+
+QVL53L0XMetricsExporter::QVL53L0XMetricsExporter(QObject *parent) : QObject(parent)
+{
+    m_fileTimer = new QTimer(this);
+    m_fileTimer->setTimerType(Qt::CoarseTimer);
+    QObject::connect(m_fileTimer, &QTimer::timeout, this, &QVL53L0XMetricsExporter::writeFile);
+}
+
+QVL53L0XMetricsExporter::~QVL53L0XMetricsExporter()
+{
+    close();
+}
+
+// Every client that connects gets the metrics and is disconnected, e.g.
+// socat - UNIX-CONNECT:/run/qvl53l0x-metrics.sock. A socket left behind by
+// an exporter that did not shut down is replaced, one still listening is not
+bool QVL53L0XMetricsExporter::listen(const QString &path)
+{
+    close();
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    QByteArray name = path.toLocal8Bit();
+
+    if(name.isEmpty() || static_cast<size_t>(name.size()) >= sizeof(address.sun_path))
+    {
+        reportError(QString("INVALID SOCKET PATH %1").arg(path));
+        return false;
+    }
+
+    memcpy(address.sun_path, name.constData(), name.size());
+
+    if((m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        reportError("COULD NOT CREATE SOCKET");
+        return false;
+    }
+
+    // only a socket nobody listens on refuses the connection, a full backlog
+    // still belongs to a listening one
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int error = probe >= 0 && ::connect(probe, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 ? errno : 0;
+
+    if(probe >= 0)
+        ::close(probe);
+
+    if(probe >= 0 && (error == 0 || error == EAGAIN))
+    {
+        reportError(QString("SOCKET %1 IN USE").arg(path));
+        ::close(m_fd);
+        m_fd = -1;
+
+        return false;
+    }
+
+    if(error == ECONNREFUSED)
+        unlink(address.sun_path);
+
+    if(bind(m_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 || ::listen(m_fd, 4) < 0)
+    {
+        reportError(QString("COULD NOT LISTEN ON %1").arg(path));
+        ::close(m_fd);
+        m_fd = -1;
+
+        return false;
+    }
+
+    m_path = path;
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    QObject::connect(m_notifier, &QSocketNotifier::activated, this, &QVL53L0XMetricsExporter::accept);
+
+    reportEvent(QString("SERVING METRICS ON %1").arg(m_path));
+
+    return true;
+}
+
+void QVL53L0XMetricsExporter::close()
+{
+    if(m_notifier)
+        delete m_notifier;
+
+    m_notifier = nullptr;
+
+    if(m_fd < 0)
+        return;
+
+    ::close(m_fd);
+    m_fd = -1;
+
+    unlink(m_path.toLocal8Bit().constData());
+}
+
+bool QVL53L0XMetricsExporter::isListening() const
+{
+    return m_fd >= 0;
+}
+
+QString QVL53L0XMetricsExporter::path() const
+{
+    return m_path;
+}
+
+QString QVL53L0XMetricsExporter::file() const
+{
+    return m_file;
+}
+
+// written every interval, an empty file name stops the writes
+void QVL53L0XMetricsExporter::setFile(const QString &file)
+{
+    if(m_file == file)
+        return;
+
+    m_file = file;
+    updateFileTimer();
+}
+
+int QVL53L0XMetricsExporter::interval() const
+{
+    return m_interval;
+}
+
+void QVL53L0XMetricsExporter::setInterval(int interval)
+{
+    if(m_interval == interval || interval <= 0)
+        return;
+
+    m_interval = interval;
+    updateFileTimer();
+}
+
+void QVL53L0XMetricsExporter::addSensor(QVL53L0X *sensor)
+{
+    for(const Source &source : m_sources)
+    {
+        if(source.sensor == sensor)
+            return;
+    }
+
+    Source source;
+    source.sensor = sensor;
+
+    m_sources.append(source);
+}
+
+void QVL53L0XMetricsExporter::removeSensor(QVL53L0X *sensor)
+{
+    for(qsizetype i = 0; i < m_sources.count(); i++)
+    {
+        if(m_sources[i].sensor == sensor)
+        {
+            m_sources.removeAt(i);
+            return;
+        }
+    }
+}
+
+// Takes a snapshot of every sensor with a hardware backend and renders them
+// one metric family at a time, as the text format requires. The window of
+// the rate and quantiles starts at the previous export to the same output
+QByteArray QVL53L0XMetricsExporter::render(Output output)
+{
+    struct Row
+    {
+        QByteArray labels;
+        QVL53L0XMetrics::Snapshot now;
+        QVL53L0XMetrics::Snapshot last;
+        qreal seconds = 0; //since the previous export, 0 on the first
+    };
+
+    std::vector<Row> rows;
+    rows.reserve(m_sources.count());
+
+    for(Source &source : m_sources)
+    {
+        const QVL53L0XMetrics *metrics = source.sensor->metrics();
+
+        if(!metrics)
+            continue;
+
+        Baseline &baseline = source.baselines[output];
+
+        Row row;
+        row.labels = labels(source.sensor);
+        row.now = metrics->snapshot();
+        row.last = baseline.last;
+        row.seconds = baseline.lastTimer.isValid() ? baseline.lastTimer.nsecsElapsed() / 1000000000.0 : 0;
+
+        baseline.last = row.now;
+        baseline.lastTimer.start();
+
+        rows.push_back(row);
+    }
+
+    QByteArray text;
+
+    auto family = [&text](const char *name, const char *type, const char *help)
+    {
+        text += QByteArray("# HELP ") + name + ' ' + help + '\n';
+        text += QByteArray("# TYPE ") + name + ' ' + type + '\n';
+    };
+
+    auto sample = [&text](const char *name, const QByteArray &labels, const QByteArray &value)
+    {
+        text += QByteArray(name) + '{' + labels + "} " + value + '\n';
+    };
+
+    family("qvl53l0x_samples_total", "counter", "Measurements read from the device.");
+
+    for(const Row &row : rows)
+        sample("qvl53l0x_samples_total", row.labels, QByteArray::number(row.now.samples));
+
+    family("qvl53l0x_sample_rate_hz", "gauge", "Measurements per second since the previous export.");
+
+    for(const Row &row : rows)
+    {
+        // a new backend starts counting from 0
+        quint64 samples = row.now.samples >= row.last.samples ? row.now.samples - row.last.samples : row.now.samples;
+        sample("qvl53l0x_sample_rate_hz", row.labels, number(row.seconds > 0 ? samples / row.seconds : qQNaN()));
+    }
+
+    family("qvl53l0x_poll_latency_seconds", "summary", "Time a poll of the result spends on the bus, quantiles since the previous export.");
+
+    for(const Row &row : rows)
+    {
+        for(qreal quantile : { 0.5, 0.9, 0.99 })
+        {
+            qreal value = row.now.latencyQuantile(quantile, &row.last);
+            sample("qvl53l0x_poll_latency_seconds", row.labels + ",quantile=\"" + QByteArray::number(quantile) + '"', number(value));
+        }
+
+        sample("qvl53l0x_poll_latency_seconds_sum", row.labels, number(row.now.pollNanoseconds / 1000000000.0));
+        sample("qvl53l0x_poll_latency_seconds_count", row.labels, QByteArray::number(row.now.polls()));
+    }
+
+    family("qvl53l0x_measurement_timeouts_total", "counter", "Measurements the device did not finish in time.");
+
+    for(const Row &row : rows)
+        sample("qvl53l0x_measurement_timeouts_total", row.labels, QByteArray::number(row.now.timeouts));
+
+    family("qvl53l0x_i2c_errors_total", "counter", "Failed I2C transfers by errno.");
+
+    for(const Row &row : rows)
+    {
+        for(int error = 0; error < QVL53L0XMetrics::errorCodes; error++)
+        {
+            if(row.now.errors[error] > 0)
+                sample("qvl53l0x_i2c_errors_total", row.labels + ",errno=\"" + errorName(error) + '"', QByteArray::number(row.now.errors[error]));
+        }
+    }
+
+    family("qvl53l0x_restarts_total", "counter", "Restarts of the sensor after repeated faults.");
+
+    for(const Row &row : rows)
+        sample("qvl53l0x_restarts_total", row.labels, QByteArray::number(row.now.restarts));
+
+    family("qvl53l0x_recoveries_total", "counter", "Fault streaks the sensor recovered from.");
+
+    for(const Row &row : rows)
+        sample("qvl53l0x_recoveries_total", row.labels, QByteArray::number(row.now.recoveries));
+
+    family("qvl53l0x_last_calibration_timestamp_seconds", "gauge", "Time of the last reference calibration, 0 before the first.");
+
+    for(const Row &row : rows)
+        sample("qvl53l0x_last_calibration_timestamp_seconds", row.labels, number(row.now.lastCalibration / 1000.0));
+
+    family("qvl53l0x_range_status_total", "counter", "Measurements by the range status reported by the device.");
+
+    static const char *statuses[QVL53L0XMetrics::rangeStatuses] =
+    {
+        "valid",
+        "sigma_fail",
+        "signal_fail",
+        "min_range_fail",
+        "phase_fail",
+        "hardware_fail",
+        "no_update"
+    };
+
+    for(const Row &row : rows)
+    {
+        for(int status = 0; status < QVL53L0XMetrics::rangeStatuses; status++)
+            sample("qvl53l0x_range_status_total", row.labels + ",status=\"" + statuses[status] + '"', QByteArray::number(row.now.rangeStatus[status]));
+    }
+
+    return text;
+}
+
+// A client that does not read in time gets what fits into the socket buffer,
+// the exporter never waits for one
+void QVL53L0XMetricsExporter::accept()
+{
+    int fd = -1;
+
+    while((fd = accept4(m_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        QByteArray text = render(SocketOutput);
+
+        if(send(fd, text.constData(), text.size(), MSG_NOSIGNAL) != text.size())
+            reportError("METRICS TRUNCATED, CLIENT TOO SLOW");
+
+        ::close(fd);
+    }
+}
+
+void QVL53L0XMetricsExporter::writeFile()
+{
+    if(m_file.isEmpty())
+        return;
+
+    // replaced in one go, a collector never reads half of it
+    QSaveFile file(m_file);
+
+    if(!file.open(QIODevice::WriteOnly) || file.write(render(FileOutput)) < 0 || !file.commit())
+        reportError(QString("COULD NOT WRITE %1").arg(m_file));
+}
+
+void QVL53L0XMetricsExporter::updateFileTimer()
+{
+    m_fileTimer->stop();
+
+    if(m_file.isEmpty())
+        return;
+
+    m_fileTimer->start(m_interval);
+    writeFile();
+}
+
+QByteArray QVL53L0XMetricsExporter::labels(const QVL53L0X *sensor)
+{
+    QByteArray bus = sensor->bus().toUtf8();
+    bus.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+
+    return "bus=\"" + bus + "\",address=\"0x" + QByteArray::number(sensor->address(), 16) + '"';
+}
+
+// errno names are stable across kernels and libcs, their numbers are not
+QByteArray QVL53L0XMetricsExporter::errorName(int error)
+{
+    if(error == 0)
+        return "other";
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 32))
+    if(const char *name = strerrorname_np(error))
+        return name;
+#endif
+
+    return QByteArray::number(error);
+}
+
+QByteArray QVL53L0XMetricsExporter::number(qreal value)
+{
+    if(qIsNaN(value))
+        return "NaN";
+
+    return QByteArray::number(value, 'g', 9);
+}
+
+void QVL53L0XMetricsExporter::reportEvent(QString message)
+{
+    //report event if backendDebug is true
+    if(m_backendDebug)
+        qDebug() << QString("** %1 - (QVL53L0X-Metrics)").arg(message);
+}
+
+void QVL53L0XMetricsExporter::reportError(QString message)
+{
+    qDebug() << QString("!! ERROR: %1 - (QVL53L0X-Metrics)").arg(message);
+}
@@ -0,0 +1,102 @@
+#ifndef QVL53L_XMETRICSEXPORTER_H
+#define QVL53L_XMETRICSEXPORTER_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSocketNotifier>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0x.h"
+#include "qvl53l0xmetrics.h"
+
+QT_BEGIN_NAMESPACE
+
+// Exports the QVL53L0XMetrics of sensors in the Prometheus text format, to a
+// file rewritten every interval (for the textfile collector of the node
+// exporter) and/or to every client connecting to a Unix domain socket.
+//
+// Only snapshots of the counters are taken, an export adds no work to the
+// bus threads. The sample rate and the poll latency quantiles cover the time
+// since the previous export of the same output, so the file and the socket
+// each get their own window. The other metrics count from the start of the
+// sensor's backend.
+//
+// Lives on the thread of the sensors
+class QVL53L_X_EXPORT QVL53L0XMetricsExporter : public QObject
+{
+    Q_OBJECT
+public:
+    static inline char const * const defaultPath = "/run/qvl53l0x-metrics.sock";
+    static inline const int defaultInterval = 15000; //ms
+
+    // each output keeps its own previous export for the rate and quantiles
+    enum Output
+    {
+        FileOutput,
+        SocketOutput,
+        Outputs
+    };
+
+    explicit QVL53L0XMetricsExporter(QObject *parent = nullptr);
+    ~QVL53L0XMetricsExporter();
+
+    bool listen(const QString &path = defaultPath);
+    void close();
+    bool isListening() const;
+    QString path() const;
+
+    QString file() const;
+    void setFile(const QString &file);
+
+    int interval() const;
+    void setInterval(int interval);
+
+    void addSensor(QVL53L0X *sensor);
+    void removeSensor(QVL53L0X *sensor);
+
+    QByteArray render(Output output = SocketOutput);
+
+protected slots:
+    void accept();
+    void writeFile();
+
+protected:
+    struct Baseline
+    {
+        QVL53L0XMetrics::Snapshot last; //of the previous export
+        QElapsedTimer lastTimer; //since the previous export, invalid before the first
+    };
+
+    struct Source
+    {
+        QVL53L0X *sensor = nullptr;
+        Baseline baselines[Outputs]; //per Output
+    };
+
+    void updateFileTimer();
+
+    static QByteArray labels(const QVL53L0X *sensor);
+    static QByteArray errorName(int error);
+    static QByteArray number(qreal value);
+
+    void reportEvent(QString message);
+    void reportError(QString message);
+
+private:
+    QString m_path;
+    int m_fd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QString m_file;
+    int m_interval = defaultInterval;
+    QTimer *m_fileTimer = nullptr;
+    QList<Source> m_sources;
+    bool m_backendDebug = true;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XMETRICSEXPORTER_H
@@ -8,6 +8,9 @@
 
 #include "qvl53l0x_global.h"
 #include "qvl53l0xbackend.h"
+#include "qvl53l0xreplaybackend.h"
+#include "qvl53l0xsharedmemorybackend.h"
+#include "qvl53l0xsocketbackend.h"
 #include "qvl53l0x.h"
 
 QT_BEGIN_NAMESPACE
@@ -22,6 +25,9 @@ public:
     {
         QSensor::defaultSensorForType(QVL53L0X::sensorType);
         QSensorManager::registerBackend(QVL53L0X::sensorType, QVL53L0XBackend::id, this);
+        QSensorManager::registerBackend(QVL53L0X::sensorType, QVL53L0XReplayBackend::id, this);
+        QSensorManager::registerBackend(QVL53L0X::sensorType, QVL53L0XSharedMemoryBackend::id, this);
+        QSensorManager::registerBackend(QVL53L0X::sensorType, QVL53L0XSocketBackend::id, this);
     }
 
     void sensorsChanged() override
@@ -29,6 +35,15 @@ public:
         //register backend on initial load
         if(!QSensorManager::isBackendRegistered(QVL53L0X::sensorType, QVL53L0XBackend::id))
             QSensorManager::registerBackend(QVL53L0X::sensorType, QVL53L0XBackend::id, this);
+
+        if(!QSensorManager::isBackendRegistered(QVL53L0X::sensorType, QVL53L0XReplayBackend::id))
+            QSensorManager::registerBackend(QVL53L0X::sensorType, QVL53L0XReplayBackend::id, this);
+
+        if(!QSensorManager::isBackendRegistered(QVL53L0X::sensorType, QVL53L0XSharedMemoryBackend::id))
+            QSensorManager::registerBackend(QVL53L0X::sensorType, QVL53L0XSharedMemoryBackend::id, this);
+
+        if(!QSensorManager::isBackendRegistered(QVL53L0X::sensorType, QVL53L0XSocketBackend::id))
+            QSensorManager::registerBackend(QVL53L0X::sensorType, QVL53L0XSocketBackend::id, this);
     }
 
     QSensorBackend *createBackend(QSensor *sensor) override
@@ -36,6 +51,15 @@ public:
         if (sensor->identifier() == QVL53L0XBackend::id)
             return new QVL53L0XBackend(sensor);
 
+        if (sensor->identifier() == QVL53L0XReplayBackend::id)
+            return new QVL53L0XReplayBackend(sensor);
+
+        if (sensor->identifier() == QVL53L0XSharedMemoryBackend::id)
+            return new QVL53L0XSharedMemoryBackend(sensor);
+
+        if (sensor->identifier() == QVL53L0XSocketBackend::id)
+            return new QVL53L0XSocketBackend(sensor);
+
         return 0;
     }
 };
@@ -10,3 +10,123 @@ void QVL53L0XReading::setDistance(quint32 distance)
 {
     d->distance = distance;
 }
+
+qreal QVL53L0XReading::preciseDistance() const
+{
+    return d->preciseDistance;
+}
+
+void QVL53L0XReading::setPreciseDistance(qreal preciseDistance)
+{
+    d->preciseDistance = preciseDistance;
+}
+
+QVL53L0XReading::RangeStatus QVL53L0XReading::rangeStatus() const
+{
+    return d->rangeStatus;
+}
+
+void QVL53L0XReading::setRangeStatus(RangeStatus rangeStatus)
+{
+    d->rangeStatus = rangeStatus;
+}
+
+qreal QVL53L0XReading::meanDistance() const
+{
+    return d->meanDistance;
+}
+
+void QVL53L0XReading::setMeanDistance(qreal meanDistance)
+{
+    d->meanDistance = meanDistance;
+}
+
+qreal QVL53L0XReading::medianDistance() const
+{
+    return d->medianDistance;
+}
+
+void QVL53L0XReading::setMedianDistance(qreal medianDistance)
+{
+    d->medianDistance = medianDistance;
+}
+
+qreal QVL53L0XReading::distanceVariance() const
+{
+    return d->distanceVariance;
+}
+
+void QVL53L0XReading::setDistanceVariance(qreal distanceVariance)
+{
+    d->distanceVariance = distanceVariance;
+}
+
+int QVL53L0XReading::sampleCount() const
+{
+    return d->sampleCount;
+}
+
+void QVL53L0XReading::setSampleCount(int sampleCount)
+{
+    d->sampleCount = sampleCount;
+}
+
+qreal QVL53L0XReading::signalRate() const
+{
+    return d->signalRate;
+}
+
+void QVL53L0XReading::setSignalRate(qreal signalRate)
+{
+    d->signalRate = signalRate;
+}
+
+qreal QVL53L0XReading::ambientRate() const
+{
+    return d->ambientRate;
+}
+
+void QVL53L0XReading::setAmbientRate(qreal ambientRate)
+{
+    d->ambientRate = ambientRate;
+}
+
+qreal QVL53L0XReading::sigma() const
+{
+    return d->sigma;
+}
+
+void QVL53L0XReading::setSigma(qreal sigma)
+{
+    d->sigma = sigma;
+}
+
+qreal QVL53L0XReading::velocity() const
+{
+    return d->velocity;
+}
+
+void QVL53L0XReading::setVelocity(qreal velocity)
+{
+    d->velocity = velocity;
+}
+
+qreal QVL53L0XReading::acceleration() const
+{
+    return d->acceleration;
+}
+
+void QVL53L0XReading::setAcceleration(qreal acceleration)
+{
+    d->acceleration = acceleration;
+}
+
+qreal QVL53L0XReading::timeToContact() const
+{
+    return d->timeToContact;
+}
+
+void QVL53L0XReading::setTimeToContact(qreal timeToContact)
+{
+    d->timeToContact = timeToContact;
+}
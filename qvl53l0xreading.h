@@ -14,10 +14,71 @@ class QVL53L_X_EXPORT QVL53L0XReading : public QSensorReading
 {
     Q_OBJECT
     Q_PROPERTY(quint32 distance READ distance)
+    Q_PROPERTY(qreal preciseDistance READ preciseDistance)
+    Q_PROPERTY(RangeStatus rangeStatus READ rangeStatus)
+    Q_PROPERTY(qreal meanDistance READ meanDistance)
+    Q_PROPERTY(qreal medianDistance READ medianDistance)
+    Q_PROPERTY(qreal distanceVariance READ distanceVariance)
+    Q_PROPERTY(int sampleCount READ sampleCount)
+    Q_PROPERTY(qreal signalRate READ signalRate)
+    Q_PROPERTY(qreal ambientRate READ ambientRate)
+    Q_PROPERTY(qreal sigma READ sigma)
+    Q_PROPERTY(qreal velocity READ velocity)
+    Q_PROPERTY(qreal acceleration READ acceleration)
+    Q_PROPERTY(qreal timeToContact READ timeToContact)
     DECLARE_READING(QVL53L0XReading)
 public:
+    // range status as reported by VL53L0X_GetRangingMeasurementData()
+    enum RangeStatus
+    {
+        RangeValid = 0,
+        SigmaFail = 1,
+        SignalFail = 2,
+        MinRangeFail = 3,
+        PhaseFail = 4,
+        HardwareFail = 5,
+        NoUpdate = 255
+    };
+    Q_ENUM(RangeStatus)
+
     quint32 distance() const;
     void setDistance(quint32 distance);
+
+    qreal preciseDistance() const;
+    void setPreciseDistance(qreal preciseDistance);
+
+    RangeStatus rangeStatus() const;
+    void setRangeStatus(RangeStatus rangeStatus);
+
+    qreal meanDistance() const;
+    void setMeanDistance(qreal meanDistance);
+
+    qreal medianDistance() const;
+    void setMedianDistance(qreal medianDistance);
+
+    qreal distanceVariance() const;
+    void setDistanceVariance(qreal distanceVariance);
+
+    int sampleCount() const;
+    void setSampleCount(int sampleCount);
+
+    qreal signalRate() const;
+    void setSignalRate(qreal signalRate);
+
+    qreal ambientRate() const;
+    void setAmbientRate(qreal ambientRate);
+
+    qreal sigma() const;
+    void setSigma(qreal sigma);
+
+    qreal velocity() const;
+    void setVelocity(qreal velocity);
+
+    qreal acceleration() const;
+    void setAcceleration(qreal acceleration);
+
+    qreal timeToContact() const;
+    void setTimeToContact(qreal timeToContact);
 };
 
 class QVL53L_X_EXPORT QVL53L0XFilter : public QSensorFilter
@@ -0,0 +1,143 @@
+#include "qvl53l0xreadingmodel.h"
+
+QVL53L0XReadingModel::QVL53L0XReadingModel(QObject *parent) : QAbstractListModel(parent)
+{
+    m_samples.resize(m_capacity);
+}
+
+int QVL53L0XReadingModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.isValid())
+        return 0;
+
+    return m_count;
+}
+
+QVariant QVL53L0XReadingModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row() < 0 || index.row() >= m_count)
+        return QVariant();
+
+    const Sample &value = sample(index.row());
+
+    switch(role)
+    {
+    case Qt::DisplayRole:
+    case PreciseDistanceRole:
+        return value.distance;
+    case TimestampRole:
+        return value.timestamp;
+    case DistanceRole:
+        return static_cast<quint32>(value.distance);
+    case RangeStatusRole:
+        return static_cast<int>(value.rangeStatus);
+    case SigmaRole:
+        return value.sigma;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> QVL53L0XReadingModel::roleNames() const
+{
+    return
+    {
+        { TimestampRole, "timestamp" },
+        { DistanceRole, "distance" },
+        { PreciseDistanceRole, "preciseDistance" },
+        { RangeStatusRole, "rangeStatus" },
+        { SigmaRole, "sigma" }
+    };
+}
+
+// row 0 is the oldest reading, the row has to exist
+const QVL53L0XReadingModel::Sample &QVL53L0XReadingModel::sample(int row) const
+{
+    return m_samples[(m_first + row) % m_capacity];
+}
+
+QVL53L0X *QVL53L0XReadingModel::sensor() const
+{
+    return m_sensor;
+}
+
+void QVL53L0XReadingModel::setSensor(QVL53L0X *sensor)
+{
+    if (m_sensor == sensor)
+        return;
+
+    if(m_sensor)
+        QObject::disconnect(m_sensor, &QSensor::readingChanged, this, &QVL53L0XReadingModel::onSensorReadingChanged);
+
+    m_sensor = sensor;
+
+    if(m_sensor)
+        QObject::connect(m_sensor, &QSensor::readingChanged, this, &QVL53L0XReadingModel::onSensorReadingChanged);
+
+    clear();
+
+    emit sensorChanged();
+}
+
+int QVL53L0XReadingModel::capacity() const
+{
+    return m_capacity;
+}
+
+// drops the history, the ring is only ever reallocated here
+void QVL53L0XReadingModel::setCapacity(int capacity)
+{
+    if (m_capacity == capacity || capacity < 1)
+        return;
+
+    clear();
+
+    m_capacity = capacity;
+    m_samples.assign(m_capacity, Sample());
+
+    emit capacityChanged();
+}
+
+void QVL53L0XReadingModel::clear()
+{
+    if(m_count == 0)
+        return;
+
+    beginResetModel();
+    m_first = 0;
+    m_count = 0;
+    endResetModel();
+}
+
+void QVL53L0XReadingModel::onSensorReadingChanged()
+{
+    QVL53L0XReading *reading = m_sensor ? m_sensor->reading() : nullptr;
+
+    if(!reading)
+        return;
+
+    Sample sample;
+    sample.timestamp = reading->timestamp();
+    sample.distance = reading->preciseDistance();
+    sample.sigma = reading->sigma();
+    sample.rangeStatus = reading->rangeStatus();
+
+    append(sample);
+}
+
+void QVL53L0XReadingModel::append(const Sample &sample)
+{
+    // full, the oldest row makes room
+    if(m_count == m_capacity)
+    {
+        beginRemoveRows(QModelIndex(), 0, 0);
+        m_first = (m_first + 1) % m_capacity;
+        m_count--;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_count, m_count);
+    m_samples[(m_first + m_count) % m_capacity] = sample;
+    m_count++;
+    endInsertRows();
+}
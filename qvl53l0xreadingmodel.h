@@ -0,0 +1,86 @@
+#ifndef QVL53L_XREADINGMODEL_H
+#define QVL53L_XREADINGMODEL_H
+
+#include <QObject>
+#include <QAbstractListModel>
+#include <QPointer>
+#include <QHash>
+#include <QByteArray>
+
+#include <vector>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0x.h"
+#include "qvl53l0xreading.h"
+
+QT_BEGIN_NAMESPACE
+
+// Recent readings of one sensor as a list model, oldest first.
+//
+// The history is a ring of fixed capacity, allocated when the capacity is
+// set. A new reading is appended with one row insertion, and once the ring is
+// full the oldest row is removed first, so views and charts only ever get row
+// notifications and nothing is copied or reallocated per reading.
+class QVL53L_X_EXPORT QVL53L0XReadingModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Role
+    {
+        TimestampRole = Qt::UserRole + 1,
+        DistanceRole,
+        PreciseDistanceRole,
+        RangeStatusRole,
+        SigmaRole
+    };
+    Q_ENUM(Role)
+
+    struct Sample
+    {
+        quint64 timestamp = 0; //microseconds since epoch
+        qreal distance = 0; //mm, preciseDistance of the reading
+        qreal sigma = 0; //mm
+        QVL53L0XReading::RangeStatus rangeStatus = QVL53L0XReading::NoUpdate;
+    };
+
+    explicit QVL53L0XReadingModel(QObject *parent = nullptr);
+
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    virtual QHash<int, QByteArray> roleNames() const override;
+
+    const Sample &sample(int row) const;
+
+    QVL53L0X *sensor() const;
+    void setSensor(QVL53L0X *sensor);
+
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    Q_INVOKABLE void clear();
+
+signals:
+    void sensorChanged();
+    void capacityChanged();
+
+protected slots:
+    void onSensorReadingChanged();
+
+protected:
+    void append(const Sample &sample);
+
+private:
+    QPointer<QVL53L0X> m_sensor;
+
+    std::vector<Sample> m_samples; //ring, sized to the capacity
+    int m_capacity = 256;
+    int m_first = 0; //ring index of row 0
+    int m_count = 0;
+
+    Q_PROPERTY(QVL53L0X *sensor READ sensor WRITE setSensor NOTIFY sensorChanged FINAL)
+    Q_PROPERTY(int capacity READ capacity WRITE setCapacity NOTIFY capacityChanged FINAL)
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XREADINGMODEL_H
@@ -0,0 +1,143 @@
+#include "qvl53l0xreplaybackend.h"
+#include "qvl53l0xbackend.h"
+
+#include <cerrno>
+
+QVL53L0XReplayBackend::QVL53L0XReplayBackend(QSensor *sensor) : QSensorBackend(sensor)
+{
+    m_replayTimer = new QTimer(this);
+    m_replayTimer->setSingleShot(true);
+    m_replayTimer->setTimerType(Qt::PreciseTimer);
+    QObject::connect(m_replayTimer, SIGNAL(timeout()), this, SLOT(replay()));
+
+    reportEvent("QVL53L0X REPLAY BACKEND CREATED");
+
+    setReading<QVL53L0XReading>(&m_reading);
+    reading();
+
+    addDataRate(1, 30);
+}
+
+QVL53L0XReplayBackend::~QVL53L0XReplayBackend()
+{
+    if(m_replayTimer && m_replayTimer->isActive())
+        m_replayTimer->stop();
+}
+
+void QVL53L0XReplayBackend::start()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor || m_replayTimer->isActive())
+        return;
+
+    if(!m_capture.isOpen())
+    {
+        if(!m_capture.open(sensor->replayFile()))
+        {
+            reportError(QString("COULD NOT OPEN CAPTURE %1").arg(sensor->replayFile()));
+            sensorError(EIO);
+            sensorStopped();
+            return;
+        }
+
+        m_position = 0;
+        reportEvent(QString("REPLAYING %1 RECORDS").arg(m_capture.count()));
+    }
+
+    //resume from the current position, or rewind a finished replay
+    if(m_position >= m_capture.count())
+        m_position = 0;
+
+    m_speed = sensor->replaySpeed();
+    m_startTimestamp = m_capture.timestamp(m_position);
+    m_elapsed.start();
+
+    m_replayTimer->start(0);
+}
+
+void QVL53L0XReplayBackend::stop()
+{
+    if(m_replayTimer->isActive())
+        m_replayTimer->stop();
+}
+
+bool QVL53L0XReplayBackend::isFeatureSupported(QSensor::Feature feature) const
+{
+    return false;
+}
+
+void QVL53L0XReplayBackend::replay()
+{
+    //capture time that has been replayed so far
+    quint64 replayed = m_speed > 0 ? m_startTimestamp + static_cast<quint64>(m_elapsed.nsecsElapsed() / 1000 * m_speed) : 0;
+
+    while(m_position < m_capture.count())
+    {
+        QVL53L0XCapture::Record record = m_capture.record(m_position);
+
+        //not due yet, wait for it
+        if(m_speed > 0 && record.timestamp > replayed)
+        {
+            m_replayTimer->start(static_cast<int>((record.timestamp - replayed) / 1000 / m_speed));
+            return;
+        }
+
+        m_position++;
+
+        if(record.type == QVL53L0XCapture::Configuration)
+        {
+            if(record.key == QVL53L0XCapture::FractionalRanging)
+                m_fractionalRanging = record.value;
+            else if(record.key == QVL53L0XCapture::TimingBudget)
+                m_sigmaTiming = sigmaTiming(record.value);
+            else if(record.key == QVL53L0XCapture::VcselDuration)
+                m_sigmaTiming.vcselDuration = record.value;
+            else if(record.key == QVL53L0XCapture::IntegrationTime)
+                m_sigmaTiming.integrationTime = record.value;
+
+            continue;
+        }
+
+        if(record.type != QVL53L0XCapture::Result)
+            continue;
+
+        m_reading.setTimestamp(record.timestamp);
+        QVL53L0XBackend::decodeResult(record.result, m_fractionalRanging, m_sigmaTiming, &m_reading);
+        newReadingAvailable();
+
+        //as fast as possible still returns to the event loop between readings
+        if(m_speed <= 0)
+        {
+            m_replayTimer->start(0);
+            return;
+        }
+    }
+
+    reportEvent("REPLAY FINISHED");
+    sensorStopped();
+}
+
+// captures taken before the VCSEL timing was recorded only have the timing
+// budget, as if the final range step at the default period of 10 PCLKs took
+// all of it: 3 PLL periods of VCSEL per 2304 * 10
+QVL53L0XBackend::SigmaTiming QVL53L0XReplayBackend::sigmaTiming(quint32 timingBudget)
+{
+    QVL53L0XBackend::SigmaTiming timing;
+    timing.vcselDuration = static_cast<quint32>(static_cast<quint64>(timingBudget) * 3 * 2048 / (2304 * 10));
+    timing.integrationTime = timingBudget;
+
+    return timing;
+}
+
+void QVL53L0XReplayBackend::reportEvent(QString message)
+{
+    //report event if backendDebug is true
+    if(m_backendDebug)
+        qDebug() << QString("** %1 - (QVL53L0X-Replay)").arg(message);
+}
+
+void QVL53L0XReplayBackend::reportError(QString message)
+{
+    qDebug() << QString("!! ERROR: %1 - (QVL53L0X-Replay)").arg(message);
+}
@@ -0,0 +1,58 @@
+#ifndef QVL53L_XREPLAYBACKEND_H
+#define QVL53L_XREPLAYBACKEND_H
+
+#include <QObject>
+#include <QString>
+#include <QSensorBackend>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0x.h"
+#include "qvl53l0xcapture.h"
+#include "qvl53l0xbackend.h"
+
+QT_BEGIN_NAMESPACE
+
+// Plays a capture recorded through QVL53L0X::captureFile back as readings,
+// paced by the recorded timestamps divided by QVL53L0X::replaySpeed
+class QVL53L_X_EXPORT QVL53L0XReplayBackend : public QSensorBackend
+{
+    Q_OBJECT
+public:
+    static inline const char* id = "QVL53L0X-Replay";
+
+    explicit QVL53L0XReplayBackend(QSensor *sensor = nullptr);
+    ~QVL53L0XReplayBackend();
+
+    virtual void start() override;
+    virtual void stop() override;
+    virtual bool isFeatureSupported(QSensor::Feature feature) const override;
+
+protected slots:
+    void replay();
+
+protected:
+    void reportEvent(QString message);
+    void reportError(QString message);
+
+private:
+    QVL53L0XCaptureReader m_capture;
+    QTimer *m_replayTimer = nullptr;
+    QElapsedTimer m_elapsed;
+
+    qint64 m_position = 0; //next record
+    quint64 m_startTimestamp = 0; //capture time of the record replay started from
+    qreal m_speed = 1.0;
+    bool m_fractionalRanging = false;
+    QVL53L0XBackend::SigmaTiming m_sigmaTiming = sigmaTiming(QVL53L0XBackend::defaultTimingBudget); //until the capture says otherwise
+    bool m_backendDebug = true;
+
+    QVL53L0XReading m_reading;
+
+    static QVL53L0XBackend::SigmaTiming sigmaTiming(quint32 timingBudget);
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XREPLAYBACKEND_H
@@ -0,0 +1,61 @@
+#ifndef QVL53L_XRINGBUFFER_H
+#define QVL53L_XRINGBUFFER_H
+
+#include <QtGlobal>
+
+#include <atomic>
+
+#include "qvl53l0x_global.h"
+
+QT_BEGIN_NAMESPACE
+
+// Fixed capacity queue between one producer and one consumer thread.
+//
+// push() and pop() never allocate, lock or make a system call, so the
+// producer can be a real-time thread. push() fails when the queue is full,
+// the consumer is never overtaken.
+template<typename T, quint32 Capacity>
+class QVL53L0XRingBuffer
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    // producer side
+    bool push(const T &value)
+    {
+        quint32 head = m_head.load(std::memory_order_relaxed);
+
+        if(head - m_tail.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        m_items[head & (Capacity - 1)] = value;
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // consumer side
+    bool pop(T &value)
+    {
+        quint32 tail = m_tail.load(std::memory_order_relaxed);
+
+        if(tail == m_head.load(std::memory_order_acquire))
+            return false;
+
+        value = m_items[tail & (Capacity - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+private:
+    T m_items[Capacity] = {};
+
+    //on separate cache lines, each is written by one thread only
+    alignas(64) std::atomic<quint32> m_head = 0;
+    alignas(64) std::atomic<quint32> m_tail = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XRINGBUFFER_H
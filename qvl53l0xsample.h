@@ -0,0 +1,38 @@
+#ifndef QVL53L_XSAMPLE_H
+#define QVL53L_XSAMPLE_H
+
+#include <QtGlobal>
+
+#include <type_traits>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0xreading.h"
+
+QT_BEGIN_NAMESPACE
+
+// One measurement in 16 bytes, four to a cache line.
+//
+// Kept in the device's own fixed point formats so the backend can fill the
+// history without converting, the accessors convert on the way out. Copied
+// in bulk with QVL53L0X::samples(), see QVL53L0XBackend::recordSample()
+struct QVL53L0XSample
+{
+    quint64 timestamp; //microseconds since epoch
+    quint16 range; //quarter mm, with or without fractional ranging
+    quint16 signalRate; //MCPS, Q9.7 fixed point
+    quint16 ambientRate; //MCPS, Q9.7 fixed point
+    quint8 rangeStatus; //QVL53L0XReading::RangeStatus, after the limit checks
+    quint8 reserved;
+
+    qreal distance() const { return range / 4.0; }
+    qreal signalRateMcps() const { return signalRate / 128.0; }
+    qreal ambientRateMcps() const { return ambientRate / 128.0; }
+    QVL53L0XReading::RangeStatus status() const { return static_cast<QVL53L0XReading::RangeStatus>(rangeStatus); }
+};
+
+static_assert(sizeof(QVL53L0XSample) == 16, "sample must be 16 bytes");
+static_assert(std::is_trivially_copyable_v<QVL53L0XSample>, "samples are copied with memcpy");
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XSAMPLE_H
@@ -0,0 +1,443 @@
+#include "qvl53l0xserver.h"
+
+#include <QDebug>
+
+#include <cstring>
+#include <limits>
+
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/socket.h"
+#include "sys/stat.h"
+#include "sys/un.h"
+
+QVL53L0XServer::QVL53L0XServer(QObject *parent) : QObject(parent)
+{
+    m_samples.resize(QVL53L0XSocket::maximumBatch);
+
+    m_drainTimer = new QTimer(this);
+    QObject::connect(m_drainTimer, &QTimer::timeout, this, &QVL53L0XServer::drain);
+}
+
+QVL53L0XServer::~QVL53L0XServer()
+{
+    close();
+}
+
+// Replaces a socket left behind by a server that did not shut down, fails
+// while another server is listening on it. Clients only need write access to
+// the socket, its mode decides who may subscribe
+bool QVL53L0XServer::listen(const QString &path)
+{
+    close();
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    QByteArray name = path.toLocal8Bit();
+
+    if(name.isEmpty() || static_cast<size_t>(name.size()) >= sizeof(address.sun_path))
+    {
+        reportError(QString("INVALID SOCKET PATH %1").arg(path));
+        return false;
+    }
+
+    memcpy(address.sun_path, name.constData(), name.size());
+
+    if((m_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        reportError("COULD NOT CREATE SOCKET");
+        return false;
+    }
+
+    // only a socket nobody listens on refuses the connection, a full backlog
+    // still belongs to a listening one
+    int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int error = probe >= 0 && ::connect(probe, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 ? errno : 0;
+
+    if(probe >= 0)
+        ::close(probe);
+
+    if(probe >= 0 && (error == 0 || error == EAGAIN))
+    {
+        reportError(QString("SOCKET %1 IN USE").arg(path));
+        ::close(m_fd);
+        m_fd = -1;
+
+        return false;
+    }
+
+    if(error == ECONNREFUSED)
+        unlink(address.sun_path);
+
+    if(bind(m_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 || ::listen(m_fd, 16) < 0)
+    {
+        reportError(QString("COULD NOT LISTEN ON %1").arg(path));
+        ::close(m_fd);
+        m_fd = -1;
+
+        return false;
+    }
+
+    m_path = path;
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    QObject::connect(m_notifier, &QSocketNotifier::activated, this, &QVL53L0XServer::accept);
+
+    reportEvent(QString("LISTENING ON %1").arg(m_path));
+
+    return true;
+}
+
+// disconnects every client and removes the socket
+void QVL53L0XServer::close()
+{
+    while(!m_clients.isEmpty())
+        removeClient(m_clients.first());
+
+    if(m_notifier)
+        delete m_notifier;
+
+    m_notifier = nullptr;
+
+    if(m_fd < 0)
+        return;
+
+    ::close(m_fd);
+    m_fd = -1;
+
+    unlink(m_path.toLocal8Bit().constData());
+}
+
+bool QVL53L0XServer::isListening() const
+{
+    return m_fd >= 0;
+}
+
+QString QVL53L0XServer::path() const
+{
+    return m_path;
+}
+
+// the sensor has to be connected to the hardware backend, clients find it
+// by its bus and address
+void QVL53L0XServer::addSensor(QVL53L0X *sensor)
+{
+    for(const Source &source : m_sources)
+    {
+        if(source.sensor == sensor)
+            return;
+    }
+
+    Source source;
+    source.sensor = sensor;
+    source.cursor = std::numeric_limits<quint64>::max();
+
+    // a cursor past the history moves to its end, only samples taken from
+    // now on are served
+    QVL53L0XSample sample;
+    sensor->samples(&sample, 1, &source.cursor);
+
+    m_sources.append(source);
+
+    // the drain interval of subscriptions to every sample follows the data rate
+    QObject::connect(sensor, &QSensor::dataRateChanged, this, &QVL53L0XServer::updateDrainInterval);
+}
+
+// its clients stay connected without samples until they subscribe again
+void QVL53L0XServer::removeSensor(QVL53L0X *sensor)
+{
+    for(qsizetype i = 0; i < m_sources.count(); i++)
+    {
+        if(m_sources[i].sensor == sensor)
+        {
+            m_sources.removeAt(i);
+            break;
+        }
+    }
+
+    for(Client *client : m_clients)
+    {
+        if(client->sensor == sensor)
+            client->sensor = nullptr;
+    }
+
+    QObject::disconnect(sensor, &QSensor::dataRateChanged, this, &QVL53L0XServer::updateDrainInterval);
+
+    updateDrainInterval();
+}
+
+int QVL53L0XServer::clientCount() const
+{
+    return static_cast<int>(m_clients.count());
+}
+
+void QVL53L0XServer::accept()
+{
+    int fd = -1;
+
+    while((fd = accept4(m_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        Client *client = new Client;
+        client->fd = fd;
+        client->pending.reserve(QVL53L0XSocket::maximumBatch);
+
+        client->notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        QObject::connect(client->notifier, &QSocketNotifier::activated, this, [this, client]()
+        {
+            receive(client);
+        });
+
+        client->batchTimer = new QTimer(this);
+        client->batchTimer->setSingleShot(true);
+        QObject::connect(client->batchTimer, &QTimer::timeout, this, [this, client]()
+        {
+            if(!flush(client))
+                removeClient(client);
+        });
+
+        m_clients.append(client);
+
+        reportEvent(QString("CLIENT CONNECTED (%1 CLIENTS)").arg(m_clients.count()));
+    }
+}
+
+void QVL53L0XServer::drain()
+{
+    for(Source &source : m_sources)
+        drainSource(source);
+}
+
+// Hands the samples the sensor has taken since the last drain to the clients
+// subscribed to it, thinned out to the rate of each
+void QVL53L0XServer::drainSource(Source &source)
+{
+    QVL53L0X *sensor = source.sensor;
+    qsizetype count = 0;
+
+    while((count = sensor->samples(m_samples.data(), m_samples.size(), &source.cursor)) > 0)
+    {
+        // a client is removed while this loops over a copy
+        const QList<Client*> clients = m_clients;
+
+        for(Client *client : clients)
+        {
+            if(client->sensor != sensor)
+                continue;
+
+            bool connected = true;
+
+            for(qsizetype i = 0; i < count && connected; i++)
+            {
+                const QVL53L0XSample &sample = m_samples[i];
+
+                if(sample.timestamp < client->next)
+                    continue;
+
+                // on the grid of the client's rate, so jitter does not lower the
+                // rate, but not behind the sample after a gap
+                client->next += client->interval;
+
+                if(client->next <= sample.timestamp)
+                    client->next = sample.timestamp + client->interval;
+
+                client->pending.push_back(sample);
+
+                if(client->batchInterval == 0 || client->pending.size() >= QVL53L0XSocket::maximumBatch)
+                    connected = flush(client);
+                else if(!client->batchTimer->isActive())
+                    client->batchTimer->start(client->batchInterval);
+            }
+
+            if(!connected)
+                removeClient(client);
+        }
+
+        if(static_cast<size_t>(count) < m_samples.size())
+            break;
+    }
+}
+
+// Drains at the rate of the fastest subscription, so every subscription takes
+// at most one sample per drain from the history. Subscriptions to every sample
+// are drained at the data rate of their sensor, the history keeps the samples
+// that arrive in between
+void QVL53L0XServer::updateDrainInterval()
+{
+    int interval = std::numeric_limits<int>::max();
+
+    for(const Client *client : m_clients)
+    {
+        if(!client->sensor)
+            continue;
+
+        if(client->interval > 0)
+            interval = qMin(interval, static_cast<int>(client->interval / 1000));
+        else
+            interval = qMin(interval, 1000 / qMax(1, client->sensor->dataRate()));
+    }
+
+    if(interval == std::numeric_limits<int>::max())
+    {
+        m_drainTimer->stop();
+        return;
+    }
+
+    interval = qMax(1, interval);
+
+    if(!m_drainTimer->isActive() || m_drainTimer->interval() != interval)
+        m_drainTimer->start(interval);
+}
+
+void QVL53L0XServer::receive(Client *client)
+{
+    QVL53L0XSocket::SubscribeMessage message;
+    ssize_t length = recv(client->fd, &message, sizeof(message), MSG_DONTWAIT);
+
+    if(length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+
+    // 0 is an orderly shutdown by the client
+    if(length <= 0)
+    {
+        removeClient(client);
+        return;
+    }
+
+    if(static_cast<size_t>(length) != sizeof(message) || message.type != QVL53L0XSocket::Subscribe)
+    {
+        reportError("INVALID MESSAGE FROM CLIENT");
+        removeClient(client);
+        return;
+    }
+
+    subscribe(client, message);
+}
+
+void QVL53L0XServer::subscribe(Client *client, const QVL53L0XSocket::SubscribeMessage &message)
+{
+    QVL53L0XSocket::SubscribedMessage reply = {};
+    reply.type = QVL53L0XSocket::Subscribed;
+    reply.status = QVL53L0XSocket::Ok;
+
+    QString bus = QString::fromLocal8Bit(message.bus, strnlen(message.bus, sizeof(message.bus)));
+
+    client->sensor = nullptr;
+    client->pending.clear();
+    client->batchTimer->stop();
+
+    if(message.version != QVL53L0XSocket::version)
+        reply.status = QVL53L0XSocket::UnsupportedVersion;
+    else
+    {
+        reply.status = QVL53L0XSocket::UnknownSensor;
+
+        for(Source &source : m_sources)
+        {
+            if(source.sensor->bus() == bus && source.sensor->address() == message.address)
+            {
+                // the samples taken so far go to the other subscribers, this
+                // one starts with the next
+                drainSource(source);
+
+                client->sensor = source.sensor;
+                reply.status = QVL53L0XSocket::Ok;
+                reply.dataRate = static_cast<quint32>(source.sensor->dataRate());
+            }
+        }
+    }
+
+    client->interval = message.dataRate > 0 ? 1000000 / message.dataRate : 0;
+    client->next = 0;
+    client->batchInterval = static_cast<int>(message.batchInterval);
+    client->dropped = 0;
+
+    updateDrainInterval();
+
+    if(send(client->fd, &reply, sizeof(reply), MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+    {
+        removeClient(client);
+        return;
+    }
+
+    if(reply.status == QVL53L0XSocket::Ok)
+        reportEvent(QString("CLIENT SUBSCRIBED TO %1:0x%2 (%3 HZ, %4 MS BATCHES)").arg(bus).arg(message.address, 2, 16, '0').arg(message.dataRate).arg(message.batchInterval));
+    else
+        reportError(QString("CLIENT SUBSCRIPTION TO %1:0x%2 FAILED (%3)").arg(bus).arg(message.address, 2, 16, '0').arg(reply.status));
+}
+
+// Sends the pending samples as one frame, straight from the pending buffer.
+// Returns false when the client is gone, a full socket only drops the frame
+bool QVL53L0XServer::flush(Client *client)
+{
+    if(client->pending.empty())
+        return true;
+
+    QVL53L0XSocket::FrameHeader header = {};
+    header.type = QVL53L0XSocket::Frame;
+    header.count = static_cast<quint32>(client->pending.size());
+    header.dropped = client->dropped;
+
+    struct iovec parts[]
+    {
+        {
+            .iov_base = &header,
+            .iov_len = sizeof(header)
+        },
+        {
+            .iov_base = client->pending.data(),
+            .iov_len = client->pending.size() * sizeof(QVL53L0XSample)
+        }
+    };
+
+    struct msghdr message = {};
+    message.msg_iov = parts;
+    message.msg_iovlen = 2;
+
+    ssize_t sent = sendmsg(client->fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if(sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        return false;
+
+    if(sent < 0)
+        client->dropped += header.count;
+    else
+        client->dropped = 0;
+
+    client->pending.clear();
+
+    return true;
+}
+
+void QVL53L0XServer::removeClient(Client *client)
+{
+    if(!m_clients.removeOne(client))
+        return;
+
+    // may be called from a signal of either of them
+    QObject::disconnect(client->notifier, nullptr, this, nullptr);
+    QObject::disconnect(client->batchTimer, nullptr, this, nullptr);
+
+    client->notifier->setEnabled(false);
+    client->notifier->deleteLater();
+    client->batchTimer->stop();
+    client->batchTimer->deleteLater();
+
+    ::close(client->fd);
+    delete client;
+
+    updateDrainInterval();
+
+    reportEvent(QString("CLIENT DISCONNECTED (%1 CLIENTS)").arg(m_clients.count()));
+}
+
+void QVL53L0XServer::reportEvent(QString message)
+{
+    //report event if backendDebug is true
+    if(m_backendDebug)
+        qDebug() << QString("** %1 - (QVL53L0X-Server)").arg(message);
+}
+
+void QVL53L0XServer::reportError(QString message)
+{
+    qDebug() << QString("!! ERROR: %1 - (QVL53L0X-Server)").arg(message);
+}
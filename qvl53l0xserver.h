@@ -0,0 +1,94 @@
+#ifndef QVL53L_XSERVER_H
+#define QVL53L_XSERVER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QTimer>
+#include <QSocketNotifier>
+
+#include <vector>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0x.h"
+#include "qvl53l0xsocket.h"
+
+QT_BEGIN_NAMESPACE
+
+// Serves the samples of the sensors of this process to other processes over
+// a Unix domain socket, see QVL53L0XSocket.
+//
+// Every subscription gets the samples of one sensor at its own rate and
+// batching. The samples are thinned out from the ones the sensor takes anyway,
+// so a subscription never adds bus load. They are copied from the sensor's
+// history (QVL53L0X::samples()) at the rate of the fastest subscription, which
+// also catches the samples a sensor does not emit, e.g. duplicates, ranges
+// inside the deadband or the measurements of a group. Sends never block: a
+// frame a slow client has no room for is dropped and counted in the next.
+//
+// Lives on the thread of the sensors
+class QVL53L_X_EXPORT QVL53L0XServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QVL53L0XServer(QObject *parent = nullptr);
+    ~QVL53L0XServer();
+
+    bool listen(const QString &path = QVL53L0XSocket::defaultPath);
+    void close();
+    bool isListening() const;
+    QString path() const;
+
+    void addSensor(QVL53L0X *sensor);
+    void removeSensor(QVL53L0X *sensor);
+
+    int clientCount() const;
+
+protected slots:
+    void accept();
+    void drain();
+    void updateDrainInterval();
+
+protected:
+    struct Source
+    {
+        QVL53L0X *sensor = nullptr;
+        quint64 cursor = 0; //history position of the next sample
+    };
+
+    struct Client
+    {
+        int fd = -1;
+        QSocketNotifier *notifier = nullptr;
+        QTimer *batchTimer = nullptr;
+        QVL53L0X *sensor = nullptr; //set once subscribed
+        quint64 interval = 0; //microseconds between samples passed on, 0 passes every sample
+        quint64 next = 0; //microseconds, timestamp the next sample is due at
+        int batchInterval = 0; //ms
+        std::vector<QVL53L0XSample> pending; //samples of the next frame
+        quint32 dropped = 0; //samples dropped since the last frame
+    };
+
+    void drainSource(Source &source);
+    void receive(Client *client);
+    void subscribe(Client *client, const QVL53L0XSocket::SubscribeMessage &message);
+    bool flush(Client *client);
+    void removeClient(Client *client);
+
+    void reportEvent(QString message);
+    void reportError(QString message);
+
+private:
+    QString m_path;
+    int m_fd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QTimer *m_drainTimer = nullptr; //runs while a client is subscribed
+    QList<Source> m_sources;
+    QList<Client*> m_clients;
+    std::vector<QVL53L0XSample> m_samples; //copied from a sensor's history, shared by the sources
+    bool m_backendDebug = true;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XSERVER_H
@@ -0,0 +1,282 @@
+#include "qvl53l0xsharedmemory.h"
+
+#include <cstring>
+#include <new>
+
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+
+QString QVL53L0XSharedMemory::objectName(const QString &name)
+{
+    //POSIX shared memory object names start with a single slash
+    return name.startsWith('/') ? name : QString("/%1").arg(name);
+}
+
+QVL53L0XSharedMemoryWriter::~QVL53L0XSharedMemoryWriter()
+{
+    close();
+}
+
+bool QVL53L0XSharedMemoryWriter::open(const QString &name, quint32 capacity)
+{
+    close();
+
+    if(capacity == 0 || (capacity & (capacity - 1)) != 0)
+        return false;
+
+    m_name = QVL53L0XSharedMemory::objectName(name);
+    m_size = sizeof(QVL53L0XSharedMemory::Header) + capacity * sizeof(QVL53L0XSharedMemory::Slot);
+
+    int fd = shm_open(m_name.toStdString().c_str(), O_RDWR, 0);
+    struct stat info = {};
+
+    //a ring of another capacity is never resized under its readers, a
+    //reader touching a page past the new end would be killed by SIGBUS.
+    //It is retired and a new object takes over the name
+    if(fd >= 0 && (fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) != m_size))
+    {
+        if(info.st_size >= (off_t)sizeof(QVL53L0XSharedMemory::Header))
+        {
+            void *old = mmap(nullptr, sizeof(QVL53L0XSharedMemory::Header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+            if(old != MAP_FAILED)
+            {
+                static_cast<QVL53L0XSharedMemory::Header*>(old)->retired.store(1, std::memory_order_release);
+                munmap(old, sizeof(QVL53L0XSharedMemory::Header));
+            }
+        }
+
+        ::close(fd);
+        fd = -1;
+
+        shm_unlink(m_name.toStdString().c_str());
+    }
+
+    //a new object is sized once, before anyone can map it
+    if(fd < 0)
+    {
+        fd = shm_open(m_name.toStdString().c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+
+        if(fd < 0)
+            return false;
+
+        if(ftruncate(fd, m_size) < 0)
+        {
+            ::close(fd);
+            shm_unlink(m_name.toStdString().c_str());
+            return false;
+        }
+    }
+
+    void *data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if(data == MAP_FAILED)
+        return false;
+
+    //readers keep their mapping when the writer restarts, so the
+    //sequence of a ring with the same layout is continued
+    m_header = static_cast<QVL53L0XSharedMemory::Header*>(data);
+    m_slots = reinterpret_cast<QVL53L0XSharedMemory::Slot*>(m_header + 1);
+
+    if(memcmp(m_header->magic, QVL53L0XSharedMemory::magic, sizeof(m_header->magic)) != 0 ||
+        m_header->version != QVL53L0XSharedMemory::version ||
+        m_header->capacity != capacity)
+    {
+        memset(data, 0, m_size);
+
+        new (m_header) QVL53L0XSharedMemory::Header();
+
+        for(quint32 i = 0; i < capacity; i++)
+            new (&m_slots[i]) QVL53L0XSharedMemory::Slot();
+
+        m_header->version = QVL53L0XSharedMemory::version;
+        m_header->capacity = capacity;
+        m_header->head.store(0, std::memory_order_relaxed);
+        m_header->retired.store(0, std::memory_order_relaxed);
+
+        //readers check the magic last
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(m_header->magic, QVL53L0XSharedMemory::magic, sizeof(m_header->magic));
+    }
+    else
+    {
+        //a writer that died inside publish() left its slot odd, the
+        //readers would skip it for good and publish() would keep it odd
+        for(quint32 i = 0; i < capacity; i++)
+        {
+            quint32 sequence = m_slots[i].sequence.load(std::memory_order_relaxed);
+
+            if(sequence & 0x01)
+                m_slots[i].sequence.store(sequence + 1, std::memory_order_release);
+        }
+    }
+
+    m_header->writerPid = getpid();
+
+    return true;
+}
+
+void QVL53L0XSharedMemoryWriter::close()
+{
+    if(m_header)
+        munmap(m_header, m_size);
+
+    //the object is left in place for the readers, it is
+    //reused by the next writer opening the same name
+    m_header = nullptr;
+    m_slots = nullptr;
+    m_size = 0;
+}
+
+bool QVL53L0XSharedMemoryWriter::isOpen() const
+{
+    return m_header != nullptr;
+}
+
+void QVL53L0XSharedMemoryWriter::publish(const QVL53L0XReading *reading)
+{
+    if(!m_header)
+        return;
+
+    quint32 head = m_header->head.load(std::memory_order_relaxed);
+    QVL53L0XSharedMemory::Slot &slot = m_slots[head & (m_header->capacity - 1)];
+    quint32 sequence = slot.sequence.load(std::memory_order_relaxed);
+
+    //odd while the slot is being written
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.index = head;
+    slot.sample.timestamp = reading->timestamp();
+    slot.sample.preciseDistance = reading->preciseDistance();
+    slot.sample.distance = reading->distance();
+    slot.sample.rangeStatus = reading->rangeStatus();
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    m_header->head.store(head + 1, std::memory_order_release);
+}
+
+QVL53L0XSharedMemoryReader::~QVL53L0XSharedMemoryReader()
+{
+    close();
+}
+
+bool QVL53L0XSharedMemoryReader::open(const QString &name)
+{
+    close();
+
+    int fd = shm_open(QVL53L0XSharedMemory::objectName(name).toStdString().c_str(), O_RDONLY, 0);
+
+    if(fd < 0)
+        return false;
+
+    struct stat info = {};
+
+    if(fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(QVL53L0XSharedMemory::Header))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if(data == MAP_FAILED)
+        return false;
+
+    m_header = static_cast<const QVL53L0XSharedMemory::Header*>(data);
+    m_slots = reinterpret_cast<const QVL53L0XSharedMemory::Slot*>(m_header + 1);
+    m_size = info.st_size;
+
+    if(memcmp(m_header->magic, QVL53L0XSharedMemory::magic, sizeof(m_header->magic)) != 0 ||
+        m_header->version != QVL53L0XSharedMemory::version ||
+        m_size < sizeof(QVL53L0XSharedMemory::Header) + m_header->capacity * sizeof(QVL53L0XSharedMemory::Slot))
+    {
+        close();
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    //start with the latest sample
+    quint32 head = m_header->head.load(std::memory_order_acquire);
+    m_tail = head > 0 ? head - 1 : 0;
+
+    return true;
+}
+
+void QVL53L0XSharedMemoryReader::close()
+{
+    if(m_header)
+        munmap(const_cast<QVL53L0XSharedMemory::Header*>(m_header), m_size);
+
+    m_header = nullptr;
+    m_slots = nullptr;
+    m_size = 0;
+    m_tail = 0;
+}
+
+bool QVL53L0XSharedMemoryReader::isOpen() const
+{
+    return m_header != nullptr;
+}
+
+quint32 QVL53L0XSharedMemoryReader::available() const
+{
+    if(!m_header)
+        return 0;
+
+    return qMin(m_header->head.load(std::memory_order_acquire) - m_tail, m_header->capacity);
+}
+
+// the writer moved to a new object of the same name, the ring is not
+// written anymore and the reader has to be opened again
+bool QVL53L0XSharedMemoryReader::isRetired() const
+{
+    return m_header && m_header->retired.load(std::memory_order_acquire) != 0;
+}
+
+// copies the next unread sample, skipping samples the writer has already overwritten
+bool QVL53L0XSharedMemoryReader::read(QVL53L0XSharedMemory::Sample &sample)
+{
+    if(!m_header)
+        return false;
+
+    const quint32 capacity = m_header->capacity;
+
+    //bounded, the writer holds a slot for a few stores only
+    for(int attempt = 0; attempt < 16; attempt++)
+    {
+        quint32 head = m_header->head.load(std::memory_order_acquire);
+
+        if(head == m_tail)
+            return false;
+
+        //overrun, continue with the oldest sample still in the ring
+        if(head - m_tail > capacity)
+            m_tail = head - capacity;
+
+        const QVL53L0XSharedMemory::Slot &slot = m_slots[m_tail & (capacity - 1)];
+        quint32 before = slot.sequence.load(std::memory_order_acquire);
+
+        if(before & 0x01)
+            continue;
+
+        quint32 index = slot.index;
+        memcpy(&sample, &slot.sample, sizeof(sample));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if(slot.sequence.load(std::memory_order_relaxed) != before || index != m_tail)
+            continue;
+
+        m_tail++;
+
+        return true;
+    }
+
+    return false;
+}
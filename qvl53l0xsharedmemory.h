@@ -0,0 +1,104 @@
+#ifndef QVL53L_XSHAREDMEMORY_H
+#define QVL53L_XSHAREDMEMORY_H
+
+#include <QString>
+
+#include <atomic>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0xreading.h"
+
+QT_BEGIN_NAMESPACE
+
+// POSIX shared memory ring of readings
+//
+// [Header: 64 bytes][Slot: 32 bytes] * capacity
+//
+// One writer (the backend that owns the sensor) and any number of readers.
+// Each slot is guarded by its own sequence counter (seqlock): the writer makes
+// it odd before touching the sample and even again afterwards, readers retry
+// when the counter was odd or changed while they copied the sample. Readers
+// never write to the ring, so a stalled reader can not block the writer.
+class QVL53L_X_EXPORT QVL53L0XSharedMemory
+{
+public:
+    static inline const char magic[8] = { 'V', 'L', '5', '3', 'L', '0', 'X', 'S' };
+    static inline const quint32 version = 1;
+    static inline const quint32 defaultCapacity = 256; //must be a power of two
+
+    struct Sample
+    {
+        quint64 timestamp; //microseconds since epoch
+        double preciseDistance;
+        quint32 distance;
+        quint32 rangeStatus;
+    };
+
+    struct Slot
+    {
+        std::atomic<quint32> sequence;
+        quint32 index; //sample number held by the slot
+        Sample sample;
+    };
+
+    struct Header
+    {
+        char magic[8];
+        quint32 version;
+        quint32 capacity;
+        std::atomic<quint32> head; //number of samples written, wraps
+        quint32 writerPid;
+        std::atomic<quint32> retired; //set when a writer replaced the object, readers open the name again
+        quint8 reserved[36];
+    };
+
+    static_assert(std::atomic<quint32>::is_always_lock_free, "shared memory ring needs lock free 32 bit atomics");
+    static_assert(sizeof(Slot) == 32, "shared memory slot must be 32 bytes");
+    static_assert(sizeof(Header) == 64, "shared memory header must be 64 bytes");
+
+    static QString objectName(const QString &name);
+};
+
+class QVL53L_X_EXPORT QVL53L0XSharedMemoryWriter
+{
+public:
+    QVL53L0XSharedMemoryWriter() = default;
+    ~QVL53L0XSharedMemoryWriter();
+
+    bool open(const QString &name, quint32 capacity = QVL53L0XSharedMemory::defaultCapacity);
+    void close();
+    bool isOpen() const;
+
+    void publish(const QVL53L0XReading *reading);
+
+private:
+    QString m_name;
+    QVL53L0XSharedMemory::Header *m_header = nullptr;
+    QVL53L0XSharedMemory::Slot *m_slots = nullptr;
+    size_t m_size = 0;
+};
+
+class QVL53L_X_EXPORT QVL53L0XSharedMemoryReader
+{
+public:
+    QVL53L0XSharedMemoryReader() = default;
+    ~QVL53L0XSharedMemoryReader();
+
+    bool open(const QString &name);
+    void close();
+    bool isOpen() const;
+
+    quint32 available() const;
+    bool isRetired() const;
+    bool read(QVL53L0XSharedMemory::Sample &sample);
+
+private:
+    const QVL53L0XSharedMemory::Header *m_header = nullptr;
+    const QVL53L0XSharedMemory::Slot *m_slots = nullptr;
+    size_t m_size = 0;
+    quint32 m_tail = 0; //next sample to read
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XSHAREDMEMORY_H
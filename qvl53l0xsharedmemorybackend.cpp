@@ -0,0 +1,92 @@
+#include "qvl53l0xsharedmemorybackend.h"
+
+QVL53L0XSharedMemoryBackend::QVL53L0XSharedMemoryBackend(QSensor *sensor) : QSensorBackend(sensor)
+{
+    m_pollTimer = new QTimer(this);
+    QObject::connect(m_pollTimer, SIGNAL(timeout()), this, SLOT(poll()));
+
+    reportEvent("QVL53L0X SHARED MEMORY BACKEND CREATED");
+
+    setReading<QVL53L0XReading>(&m_reading);
+    reading();
+
+    addDataRate(1, defaultDataRate);
+}
+
+QVL53L0XSharedMemoryBackend::~QVL53L0XSharedMemoryBackend()
+{
+    if(m_pollTimer && m_pollTimer->isActive())
+        m_pollTimer->stop();
+}
+
+void QVL53L0XSharedMemoryBackend::start()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor || m_pollTimer->isActive())
+        return;
+
+    if(m_name != sensor->sharedMemoryName())
+    {
+        m_sharedMemory.close();
+        m_name = sensor->sharedMemoryName();
+    }
+
+    //the publisher may not be running yet, poll() keeps trying to attach
+    int rate = sensor->dataRate() > 0 ? sensor->dataRate() : defaultDataRate;
+    m_pollTimer->setInterval(1000 / rate);
+    m_pollTimer->start();
+}
+
+void QVL53L0XSharedMemoryBackend::stop()
+{
+    if(m_pollTimer->isActive())
+        m_pollTimer->stop();
+}
+
+bool QVL53L0XSharedMemoryBackend::isFeatureSupported(QSensor::Feature feature) const
+{
+    return false;
+}
+
+void QVL53L0XSharedMemoryBackend::poll()
+{
+    //the remaining samples of a retired ring are still delivered first
+    if(m_sharedMemory.isRetired() && m_sharedMemory.available() == 0)
+    {
+        m_sharedMemory.close();
+        reportEvent(QString("RING OF %1 REPLACED").arg(m_name));
+    }
+
+    if(!m_sharedMemory.isOpen())
+    {
+        if(!m_sharedMemory.open(m_name))
+            return;
+
+        reportEvent(QString("ATTACHED TO %1").arg(m_name));
+    }
+
+    QVL53L0XSharedMemory::Sample sample;
+
+    //hand every sample published since the last poll to the sensor
+    while(m_sharedMemory.read(sample))
+    {
+        m_reading.setTimestamp(sample.timestamp);
+        m_reading.setDistance(sample.distance);
+        m_reading.setPreciseDistance(sample.preciseDistance);
+        m_reading.setRangeStatus(static_cast<QVL53L0XReading::RangeStatus>(sample.rangeStatus));
+        newReadingAvailable();
+    }
+}
+
+void QVL53L0XSharedMemoryBackend::reportEvent(QString message)
+{
+    //report event if backendDebug is true
+    if(m_backendDebug)
+        qDebug() << QString("** %1 - (QVL53L0X-SharedMemory)").arg(message);
+}
+
+void QVL53L0XSharedMemoryBackend::reportError(QString message)
+{
+    qDebug() << QString("!! ERROR: %1 - (QVL53L0X-SharedMemory)").arg(message);
+}
@@ -0,0 +1,49 @@
+#ifndef QVL53L_XSHAREDMEMORYBACKEND_H
+#define QVL53L_XSHAREDMEMORYBACKEND_H
+
+#include <QObject>
+#include <QString>
+#include <QSensorBackend>
+#include <QTimer>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0x.h"
+#include "qvl53l0xsharedmemory.h"
+
+QT_BEGIN_NAMESPACE
+
+// Consumes the readings another process publishes through
+// QVL53L0X::sharedMemoryName, without touching the I2C bus
+class QVL53L_X_EXPORT QVL53L0XSharedMemoryBackend : public QSensorBackend
+{
+    Q_OBJECT
+public:
+    static inline const char* id = "QVL53L0X-SharedMemory";
+    static inline const int defaultDataRate = 30; //Hz, polled at when the sensor has no data rate set
+
+    explicit QVL53L0XSharedMemoryBackend(QSensor *sensor = nullptr);
+    ~QVL53L0XSharedMemoryBackend();
+
+    virtual void start() override;
+    virtual void stop() override;
+    virtual bool isFeatureSupported(QSensor::Feature feature) const override;
+
+protected slots:
+    void poll();
+
+protected:
+    void reportEvent(QString message);
+    void reportError(QString message);
+
+private:
+    QVL53L0XSharedMemoryReader m_sharedMemory;
+    QString m_name;
+    QTimer *m_pollTimer = nullptr;
+    bool m_backendDebug = true;
+
+    QVL53L0XReading m_reading;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XSHAREDMEMORYBACKEND_H
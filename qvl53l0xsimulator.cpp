@@ -0,0 +1,363 @@
+#include "qvl53l0xsimulator.h"
+
+#include <QMutexLocker>
+
+#include <cerrno>
+
+#include "unistd.h"
+
+// registers the simulator models beyond plain storage, all on page 0
+#define SYSRANGE_START                  0x00
+#define SYSTEM_SEQUENCE_CONFIG          0x01
+#define SYSTEM_INTERMEASUREMENT_PERIOD  0x04
+#define SYSTEM_RANGE_CONFIG             0x09
+#define SYSTEM_INTERRUPT_CLEAR          0x0B
+#define I2C_SLAVE_DEVICE_ADDRESS        0x8A
+#define RESULT_INTERRUPT_STATUS         0x13
+#define RESULT_RANGE_STATUS             0x14
+#define OSC_CALIBRATE_VAL               0xF8
+#define PAGE_SELECT                     0xFF
+
+QVL53L0XSimulator::QVL53L0XSimulator(const QString &bus, quint8 address)
+{
+    m_bus = bus;
+    m_address = address;
+
+    // values read during bring up, everything else reads 0 until written
+    m_registers[0][0xC0] = 0xEE; //IDENTIFICATION_MODEL_ID
+    m_registers[0][0xC2] = 0x10; //IDENTIFICATION_REVISION_ID
+    m_registers[0][0x84] = 0x01; //GPIO_HV_MUX_ACTIVE_HIGH
+
+    for(int i = 0xB0; i <= 0xB5; i++)
+        m_registers[0][i] = 0xFF; //GLOBAL_CONFIG_SPAD_ENABLES_REF_0 to _5
+
+    m_registers[0][OSC_CALIBRATE_VAL + 1] = 0x30;
+    m_registers[1][0x91] = 0x3C; //stop variable
+    m_registers[7][0x92] = 0x85; //5 aperture reference SPADs
+
+    m_clock.start();
+
+    QMutexLocker locker(&m_simulatorsMutex);
+    m_simulators.insert(QString("%1@%2").arg(m_bus).arg(m_address), this);
+}
+
+QVL53L0XSimulator::~QVL53L0XSimulator()
+{
+    QMutexLocker locker(&m_simulatorsMutex);
+    m_simulators.remove(QString("%1@%2").arg(m_bus).arg(m_address));
+}
+
+QVL53L0XSimulator *QVL53L0XSimulator::find(const QString &bus, quint8 address)
+{
+    QMutexLocker locker(&m_simulatorsMutex);
+
+    return m_simulators.value(QString("%1@%2").arg(bus).arg(address), nullptr);
+}
+
+QString QVL53L0XSimulator::bus() const
+{
+    return m_bus;
+}
+
+quint8 QVL53L0XSimulator::address() const
+{
+    return m_address;
+}
+
+// mm, reported by the following measurements
+void QVL53L0XSimulator::setDistance(qreal distance)
+{
+    QMutexLocker locker(&m_mutex);
+    m_distance = qBound<qreal>(0, distance, 8190);
+}
+
+// MCPS
+void QVL53L0XSimulator::setSignalRate(qreal signalRate)
+{
+    QMutexLocker locker(&m_mutex);
+    m_signalRate = qBound<qreal>(0, signalRate, 511.99);
+}
+
+// MCPS
+void QVL53L0XSimulator::setAmbientRate(qreal ambientRate)
+{
+    QMutexLocker locker(&m_mutex);
+    m_ambientRate = qBound<qreal>(0, ambientRate, 511.99);
+}
+
+// time from SYSRANGE_START to a latched result, a short time lets soak runs
+// take many more samples than the device would
+void QVL53L0XSimulator::setMeasurementTime(int microseconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_measurementTime = qMax(0, microseconds);
+}
+
+void QVL53L0XSimulator::setResponseDelay(int microseconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_responseDelay = qMax(0, microseconds);
+}
+
+// the next transfers fail (or, for StuckInterrupt, the next interrupt status reads)
+void QVL53L0XSimulator::injectFault(Fault fault, int transfers)
+{
+    QMutexLocker locker(&m_mutex);
+    m_pending[fault] += qMax(0, transfers);
+}
+
+// probability of the fault per transfer, 0 disables it
+void QVL53L0XSimulator::setFaultRate(Fault fault, qreal rate)
+{
+    QMutexLocker locker(&m_mutex);
+    m_rates[fault] = qBound<qreal>(0, rate, 1);
+}
+
+void QVL53L0XSimulator::setSeed(quint32 seed)
+{
+    QMutexLocker locker(&m_mutex);
+    m_random.seed(seed);
+}
+
+quint64 QVL53L0XSimulator::transfers() const
+{
+    return m_transfers.load(std::memory_order_relaxed);
+}
+
+quint64 QVL53L0XSimulator::faults() const
+{
+    return m_faults.load(std::memory_order_relaxed);
+}
+
+quint64 QVL53L0XSimulator::measurements() const
+{
+    return m_measurements.load(std::memory_order_relaxed);
+}
+
+// Stands in for ioctl(I2C_RDWR): a write message sets the register pointer
+// and writes the bytes after it, a read message reads from the pointer on.
+// Both auto increment like the device
+int QVL53L0XSimulator::transfer(struct i2c_rdwr_ioctl_data *payload)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_transfers.fetch_add(1, std::memory_order_relaxed);
+
+    if(injectedFault(Nack))
+    {
+        errno = ENXIO;
+        return -1;
+    }
+
+    if(injectedFault(RemoteIO))
+    {
+        errno = EREMOTEIO;
+        return -1;
+    }
+
+    if(injectedFault(SlowResponse))
+        usleep(m_responseDelay);
+
+    update();
+
+    quint8 reg = 0;
+
+    for(quint32 i = 0; i < payload->nmsgs; i++)
+    {
+        struct i2c_msg &message = payload->msgs[i];
+
+        if(message.flags & I2C_M_RD)
+        {
+            for(quint16 j = 0; j < message.len; j++)
+                message.buf[j] = readRegister(reg++);
+        }
+        else if(message.len > 0)
+        {
+            reg = message.buf[0];
+
+            for(quint16 j = 1; j < message.len; j++)
+                writeRegister(reg++, message.buf[j]);
+        }
+    }
+
+    return static_cast<int>(payload->nmsgs);
+}
+
+bool QVL53L0XSimulator::injectedFault(Fault fault)
+{
+    bool injected = false;
+
+    if(m_pending[fault] > 0)
+    {
+        m_pending[fault]--;
+        injected = true;
+    }
+    else if(m_rates[fault] > 0)
+        injected = std::uniform_real_distribution<qreal>(0, 1)(m_random) < m_rates[fault];
+
+    if(injected)
+        m_faults.fetch_add(1, std::memory_order_relaxed);
+
+    return injected;
+}
+
+quint8 QVL53L0XSimulator::readRegister(quint8 reg)
+{
+    if(m_page == 0)
+    {
+        switch(reg)
+        {
+        case SYSRANGE_START:
+            // the start bit clears as soon as the device has started
+            return m_registers[0][reg] & ~0x01;
+
+        case RESULT_INTERRUPT_STATUS:
+            if(!m_latched || injectedFault(StuckInterrupt))
+                return 0x00;
+
+            return 0x04; //new sample ready
+
+        default:
+            break;
+        }
+    }
+
+    return m_registers[m_page][reg];
+}
+
+void QVL53L0XSimulator::writeRegister(quint8 reg, quint8 value)
+{
+    m_registers[m_page][reg] = value;
+
+    if(reg == PAGE_SELECT)
+    {
+        // every page shares the page select register
+        m_page = value & 0x07;
+
+        for(int page = 0; page < 8; page++)
+            m_registers[page][PAGE_SELECT] = value;
+
+        return;
+    }
+
+    // SPAD info is ready as soon as it is requested
+    if(m_page == 7 && reg == 0x83 && value == 0x00)
+    {
+        m_registers[7][0x83] = 0x10;
+        return;
+    }
+
+    if(m_page != 0)
+        return;
+
+    switch(reg)
+    {
+    case SYSRANGE_START:
+        startMeasurement(value);
+        break;
+
+    case SYSTEM_INTERRUPT_CLEAR:
+        if(value & 0x01)
+            m_latched = false;
+        break;
+
+    case I2C_SLAVE_DEVICE_ADDRESS:
+        readdress(value & 0x7F);
+        break;
+
+    default:
+        break;
+    }
+}
+
+// the register holds the 7 bit address, the one the sensor is configured
+// with and the simulator is registered under
+void QVL53L0XSimulator::readdress(quint8 address)
+{
+    QMutexLocker locker(&m_simulatorsMutex);
+
+    m_simulators.remove(QString("%1@%2").arg(m_bus).arg(m_address));
+    m_address = address;
+    m_simulators.insert(QString("%1@%2").arg(m_bus).arg(m_address), this);
+}
+
+void QVL53L0XSimulator::startMeasurement(quint8 mode)
+{
+    m_mode = mode;
+
+    if((mode & 0x07) == 0)
+    {
+        m_due = -1;
+        return;
+    }
+
+    // SYSTEM_SEQUENCE_CONFIG selects the VHV (0x01) or phase (0x02) calibration
+    quint8 sequence = m_registers[0][SYSTEM_SEQUENCE_CONFIG];
+    m_calibrating = (mode & 0x01) && (sequence == 0x01 || sequence == 0x02);
+
+    m_due = m_clock.nsecsElapsed() / 1000 + (m_calibrating ? 1000 : m_measurementTime);
+}
+
+void QVL53L0XSimulator::latchResult()
+{
+    m_latched = true;
+
+    if(m_calibrating)
+        return;
+
+    m_measurements.fetch_add(1, std::memory_order_relaxed);
+
+    quint8 *result = &m_registers[0][RESULT_RANGE_STATUS];
+
+    // with fractional ranging the range is reported in quarter mm
+    quint16 range = static_cast<quint16>((m_registers[0][SYSTEM_RANGE_CONFIG] & 0x01) ? m_distance * 4 : m_distance);
+    quint16 signalRate = static_cast<quint16>(m_signalRate * 128);
+    quint16 ambientRate = static_cast<quint16>(m_ambientRate * 128);
+
+    result[0] = 11 << 3; //range valid
+    result[6] = signalRate >> 8;
+    result[7] = signalRate & 0xFF;
+    result[8] = ambientRate >> 8;
+    result[9] = ambientRate & 0xFF;
+    result[10] = range >> 8;
+    result[11] = range & 0xFF;
+}
+
+// latches the results that are due, continuous modes keep ranging
+void QVL53L0XSimulator::update()
+{
+    if(m_due < 0)
+        return;
+
+    qint64 now = m_clock.nsecsElapsed() / 1000;
+
+    if(now < m_due)
+        return;
+
+    latchResult();
+
+    if(m_calibrating || !(m_mode & 0x06))
+    {
+        m_due = -1;
+        return;
+    }
+
+    // timed ranging waits the intermeasurement period (in OSC_CALIBRATE_VAL
+    // units of 1 ms) between measurements, back to back ranging does not
+    qint64 period = m_measurementTime;
+
+    if(m_mode & 0x04)
+    {
+        quint32 intermeasurement = (m_registers[0][SYSTEM_INTERMEASUREMENT_PERIOD] << 24) |
+                                   (m_registers[0][SYSTEM_INTERMEASUREMENT_PERIOD + 1] << 16) |
+                                   (m_registers[0][SYSTEM_INTERMEASUREMENT_PERIOD + 2] << 8) |
+                                   m_registers[0][SYSTEM_INTERMEASUREMENT_PERIOD + 3];
+        quint16 oscillator = (m_registers[0][OSC_CALIBRATE_VAL] << 8) | m_registers[0][OSC_CALIBRATE_VAL + 1];
+
+        if(oscillator > 0)
+            period = qMax<qint64>(period, static_cast<qint64>(intermeasurement) * 1000 / oscillator);
+    }
+
+    // results nobody collected in time are overwritten
+    m_due += qMax<qint64>(1, period) * ((now - m_due) / qMax<qint64>(1, period) + 1);
+}
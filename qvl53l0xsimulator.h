@@ -0,0 +1,113 @@
+#ifndef QVL53L_XSIMULATOR_H
+#define QVL53L_XSIMULATOR_H
+
+#include <QString>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <random>
+
+#include "qvl53l0x_global.h"
+
+#include "linux/i2c.h"
+#include "linux/i2c-dev.h"
+
+QT_BEGIN_NAMESPACE
+
+// Register level model of a VL53L0X on a simulated bus.
+//
+// Sensors whose bus path starts with "sim:" talk to the simulator registered
+// for that bus and address instead of i2c-dev, so the backend can be run
+// without hardware. The register file is paged like the device's, single
+// shot, back to back and timed ranging as well as the reference calibrations
+// complete after a fixed time and latch RESULT_INTERRUPT_STATUS. Writing
+// I2C_SLAVE_DEVICE_ADDRESS moves the simulator to the new address.
+//
+// Faults can be injected for the next transfers or at random with a given
+// rate, the random sequence is seeded so runs can be repeated.
+//
+// The simulator has to outlive the sensors using it. transfer() is called on
+// the bus thread, everything else may be called from any thread.
+class QVL53L_X_EXPORT QVL53L0XSimulator
+{
+public:
+    static inline const char *busPrefix = "sim:";
+
+    enum Fault
+    {
+        Nack,               //transfer fails with ENXIO, no device acknowledged
+        RemoteIO,           //transfer fails with EREMOTEIO, the device stopped acknowledging mid transfer
+        StuckInterrupt,     //RESULT_INTERRUPT_STATUS reads 0 even with a result latched
+        SlowResponse        //transfer succeeds after the response delay
+    };
+
+    explicit QVL53L0XSimulator(const QString &bus = "sim:0", quint8 address = 0x29);
+    ~QVL53L0XSimulator();
+
+    static QVL53L0XSimulator *find(const QString &bus, quint8 address);
+
+    QString bus() const;
+    quint8 address() const;
+
+    void setDistance(qreal distance);
+    void setSignalRate(qreal signalRate);
+    void setAmbientRate(qreal ambientRate);
+    void setMeasurementTime(int microseconds);
+    void setResponseDelay(int microseconds);
+
+    void injectFault(Fault fault, int transfers = 1);
+    void setFaultRate(Fault fault, qreal rate);
+    void setSeed(quint32 seed);
+
+    quint64 transfers() const;
+    quint64 faults() const;
+    quint64 measurements() const;
+
+    int transfer(struct i2c_rdwr_ioctl_data *payload);
+
+protected:
+    bool injectedFault(Fault fault);
+    quint8 readRegister(quint8 reg);
+    void writeRegister(quint8 reg, quint8 value);
+    void readdress(quint8 address);
+    void startMeasurement(quint8 mode);
+    void latchResult();
+    void update();
+
+private:
+    QString m_bus;
+    quint8 m_address;
+
+    QMutex m_mutex;
+    quint8 m_registers[8][256] = {}; //register pages, selected by writing 0xFF
+    quint8 m_page = 0;
+
+    QElapsedTimer m_clock;
+    qint64 m_due = -1; //microseconds on m_clock the running measurement finishes, -1 when idle
+    quint8 m_mode = 0; //last SYSRANGE_START mode
+    bool m_calibrating = false;
+    bool m_latched = false;
+
+    qreal m_distance = 500; //mm
+    qreal m_signalRate = 10; //MCPS
+    qreal m_ambientRate = 0.5; //MCPS
+    int m_measurementTime = 33000; //microseconds
+    int m_responseDelay = 5000; //microseconds, SlowResponse
+
+    int m_pending[4] = {}; //injected faults left, per Fault
+    qreal m_rates[4] = {}; //random fault rates, per Fault
+    std::minstd_rand m_random;
+
+    std::atomic<quint64> m_transfers = 0;
+    std::atomic<quint64> m_faults = 0;
+    std::atomic<quint64> m_measurements = 0;
+
+    static inline QMutex m_simulatorsMutex;
+    static inline QHash<QString, QVL53L0XSimulator*> m_simulators;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XSIMULATOR_H
@@ -0,0 +1,79 @@
+#ifndef QVL53L_XSOCKET_H
+#define QVL53L_XSOCKET_H
+
+#include <QtGlobal>
+
+#include <type_traits>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0xsample.h"
+
+QT_BEGIN_NAMESPACE
+
+// Messages between the sensor daemon (QVL53L0XServer) and its clients
+// (QVL53L0XSocketBackend)
+//
+// The socket is a SOCK_SEQPACKET Unix domain socket, every message is one
+// packet and arrives whole. A client sends Subscribe, the server answers with
+// Subscribed and from then on sends frames:
+//
+// [FrameHeader: 16 bytes][QVL53L0XSample: 16 bytes] * count
+//
+// A client subscribes again to change its rate or batching. Both sides run on
+// the same device, the messages are in host byte order
+class QVL53L_X_EXPORT QVL53L0XSocket
+{
+public:
+    static inline const quint32 version = 1;
+    static inline char const * const defaultPath = "/run/qvl53l0x.sock";
+    static inline const quint32 maximumBatch = 256; //samples per frame
+
+    enum Type : quint32
+    {
+        Subscribe = 1,
+        Subscribed = 2,
+        Frame = 3
+    };
+
+    enum Status : quint32
+    {
+        Ok = 0,
+        UnknownSensor = 1,
+        UnsupportedVersion = 2
+    };
+
+    struct SubscribeMessage
+    {
+        quint32 type; //Subscribe
+        quint32 version;
+        char bus[64]; //as set on QVL53L0X::bus, NUL terminated
+        quint32 address; //as set on QVL53L0X::address
+        quint32 dataRate; //Hz, samples passed on, 0 passes every sample
+        quint32 batchInterval; //ms a sample may wait for others, 0 sends every sample on its own
+    };
+
+    struct SubscribedMessage
+    {
+        quint32 type; //Subscribed
+        quint32 status;
+        quint32 dataRate; //Hz, of the sensor
+        quint32 reserved;
+    };
+
+    struct FrameHeader
+    {
+        quint32 type; //Frame
+        quint32 count; //samples following the header
+        quint32 dropped; //samples the client had no room for since the last frame
+        quint32 reserved;
+    };
+
+    static_assert(sizeof(SubscribeMessage) == 84, "subscribe message must be 84 bytes");
+    static_assert(sizeof(SubscribedMessage) == 16, "subscribed message must be 16 bytes");
+    static_assert(sizeof(FrameHeader) == 16, "frame header must be 16 bytes");
+    static_assert(std::is_trivially_copyable_v<SubscribeMessage>, "messages are sent as they are");
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XSOCKET_H
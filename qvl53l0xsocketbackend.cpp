@@ -0,0 +1,220 @@
+#include "qvl53l0xsocketbackend.h"
+
+#include <QDebug>
+
+#include <cstring>
+
+#include "unistd.h"
+#include "sys/socket.h"
+#include "sys/un.h"
+
+QVL53L0XSocketBackend::QVL53L0XSocketBackend(QSensor *sensor) : QSensorBackend(sensor)
+{
+    m_frame.resize(sizeof(QVL53L0XSocket::FrameHeader) + QVL53L0XSocket::maximumBatch * sizeof(QVL53L0XSample));
+
+    m_reconnectTimer = new QTimer(this);
+    m_reconnectTimer->setInterval(reconnectInterval);
+    QObject::connect(m_reconnectTimer, SIGNAL(timeout()), this, SLOT(connectToServer()));
+
+    reportEvent("QVL53L0X SOCKET BACKEND CREATED");
+
+    setReading<QVL53L0XReading>(&m_reading);
+    reading();
+
+    addDataRate(1, 30);
+}
+
+QVL53L0XSocketBackend::~QVL53L0XSocketBackend()
+{
+    if(m_reconnectTimer && m_reconnectTimer->isActive())
+        m_reconnectTimer->stop();
+
+    disconnectFromServer();
+}
+
+void QVL53L0XSocketBackend::start()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor || m_fd >= 0 || m_reconnectTimer->isActive())
+        return;
+
+    m_path = sensor->socketPath();
+
+    //the daemon may not be running yet, the timer keeps trying to connect
+    connectToServer();
+}
+
+void QVL53L0XSocketBackend::stop()
+{
+    if(m_reconnectTimer->isActive())
+        m_reconnectTimer->stop();
+
+    disconnectFromServer();
+}
+
+bool QVL53L0XSocketBackend::isFeatureSupported(QSensor::Feature feature) const
+{
+    return false;
+}
+
+// Connects and subscribes, the answer is handled by receive()
+void QVL53L0XSocketBackend::connectToServer()
+{
+    QVL53L0X *sensor = qobject_cast<QVL53L0X*>(this->sensor());
+
+    if(!sensor || m_fd >= 0)
+        return;
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    QByteArray name = m_path.toLocal8Bit();
+    QByteArray bus = sensor->bus().toLocal8Bit();
+
+    QVL53L0XSocket::SubscribeMessage message = {};
+
+    if(name.isEmpty() || static_cast<size_t>(name.size()) >= sizeof(address.sun_path) || static_cast<size_t>(bus.size()) >= sizeof(message.bus))
+    {
+        reportError(QString("INVALID SOCKET PATH %1 OR BUS %2").arg(m_path, sensor->bus()));
+        return;
+    }
+
+    memcpy(address.sun_path, name.constData(), name.size());
+
+    if((m_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        reportError("COULD NOT CREATE SOCKET");
+        return;
+    }
+
+    // a local connect either succeeds or fails right away
+    if(::connect(m_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        disconnectFromServer();
+
+        if(!m_reconnectTimer->isActive())
+        {
+            reportEvent(QString("WAITING FOR %1").arg(m_path));
+            m_reconnectTimer->start();
+        }
+
+        return;
+    }
+
+    m_reconnectTimer->stop();
+
+    message.type = QVL53L0XSocket::Subscribe;
+    message.version = QVL53L0XSocket::version;
+    memcpy(message.bus, bus.constData(), bus.size());
+    message.address = sensor->address();
+    message.dataRate = static_cast<quint32>(qMax(sensor->dataRate(), 0));
+    message.batchInterval = static_cast<quint32>(qMax(sensor->batchInterval(), 0));
+
+    if(send(m_fd, &message, sizeof(message), MSG_NOSIGNAL) != sizeof(message))
+    {
+        reportError(QString("COULD NOT SUBSCRIBE TO %1").arg(m_path));
+        disconnectFromServer();
+        m_reconnectTimer->start();
+
+        return;
+    }
+
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    QObject::connect(m_notifier, &QSocketNotifier::activated, this, &QVL53L0XSocketBackend::receive);
+
+    reportEvent(QString("CONNECTED TO %1").arg(m_path));
+}
+
+void QVL53L0XSocketBackend::receive()
+{
+    ssize_t length = 0;
+
+    while((length = recv(m_fd, m_frame.data(), m_frame.size(), MSG_DONTWAIT)) > 0)
+    {
+        quint32 type = 0;
+
+        if(static_cast<size_t>(length) < sizeof(type))
+            continue;
+
+        memcpy(&type, m_frame.data(), sizeof(type));
+
+        if(type == QVL53L0XSocket::Subscribed && static_cast<size_t>(length) == sizeof(QVL53L0XSocket::SubscribedMessage))
+        {
+            QVL53L0XSocket::SubscribedMessage reply;
+            memcpy(&reply, m_frame.data(), sizeof(reply));
+
+            m_subscribed = reply.status == QVL53L0XSocket::Ok;
+
+            if(m_subscribed)
+                reportEvent(QString("SUBSCRIBED, SENSOR RANGING AT %1 HZ").arg(reply.dataRate));
+            else
+                reportError(QString("SUBSCRIPTION REJECTED (%1)").arg(reply.status));
+        }
+        else if(type == QVL53L0XSocket::Frame && m_subscribed && static_cast<size_t>(length) >= sizeof(QVL53L0XSocket::FrameHeader))
+        {
+            QVL53L0XSocket::FrameHeader header;
+            memcpy(&header, m_frame.data(), sizeof(header));
+
+            size_t count = (length - sizeof(header)) / sizeof(QVL53L0XSample);
+
+            if(header.dropped)
+                reportError(QString("%1 SAMPLES DROPPED BY THE DAEMON").arg(header.dropped));
+
+            //hand every sample of the frame to the sensor
+            for(size_t i = 0; i < count && i < header.count; i++)
+            {
+                QVL53L0XSample sample;
+                memcpy(&sample, m_frame.data() + sizeof(header) + i * sizeof(sample), sizeof(sample));
+
+                m_reading.setTimestamp(sample.timestamp);
+                m_reading.setDistance(static_cast<quint32>(sample.range / 4));
+                m_reading.setPreciseDistance(sample.distance());
+                m_reading.setRangeStatus(sample.status());
+                m_reading.setSignalRate(sample.signalRateMcps());
+                m_reading.setAmbientRate(sample.ambientRateMcps());
+                newReadingAvailable();
+            }
+        }
+    }
+
+    if(length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+
+    //the daemon went away, wait for it to come back
+    reportError(QString("DISCONNECTED FROM %1").arg(m_path));
+    disconnectFromServer();
+    m_reconnectTimer->start();
+}
+
+void QVL53L0XSocketBackend::disconnectFromServer()
+{
+    // may be called from the notifier's own signal
+    if(m_notifier)
+    {
+        QObject::disconnect(m_notifier, nullptr, this, nullptr);
+        m_notifier->setEnabled(false);
+        m_notifier->deleteLater();
+    }
+
+    m_notifier = nullptr;
+    m_subscribed = false;
+
+    if(m_fd < 0)
+        return;
+
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+void QVL53L0XSocketBackend::reportEvent(QString message)
+{
+    //report event if backendDebug is true
+    if(m_backendDebug)
+        qDebug() << QString("** %1 - (QVL53L0X-Socket)").arg(message);
+}
+
+void QVL53L0XSocketBackend::reportError(QString message)
+{
+    qDebug() << QString("!! ERROR: %1 - (QVL53L0X-Socket)").arg(message);
+}
@@ -0,0 +1,59 @@
+#ifndef QVL53L_XSOCKETBACKEND_H
+#define QVL53L_XSOCKETBACKEND_H
+
+#include <QObject>
+#include <QString>
+#include <QSensorBackend>
+#include <QTimer>
+#include <QSocketNotifier>
+
+#include <vector>
+
+#include "qvl53l0x_global.h"
+#include "qvl53l0x.h"
+#include "qvl53l0xsocket.h"
+
+QT_BEGIN_NAMESPACE
+
+// Gets the samples of the sensor at QVL53L0X::bus and QVL53L0X::address from
+// the sensor daemon at QVL53L0X::socketPath instead of the I2C bus. The daemon
+// thins them out to dataRate() and sends them in frames of up to
+// QVL53L0X::batchInterval, they are emitted one reading per sample
+class QVL53L_X_EXPORT QVL53L0XSocketBackend : public QSensorBackend
+{
+    Q_OBJECT
+public:
+    static inline const char* id = "QVL53L0X-Socket";
+    static inline const int reconnectInterval = 1000; //ms
+
+    explicit QVL53L0XSocketBackend(QSensor *sensor = nullptr);
+    ~QVL53L0XSocketBackend();
+
+    virtual void start() override;
+    virtual void stop() override;
+    virtual bool isFeatureSupported(QSensor::Feature feature) const override;
+
+protected slots:
+    void connectToServer();
+    void receive();
+
+protected:
+    void disconnectFromServer();
+    void reportEvent(QString message);
+    void reportError(QString message);
+
+private:
+    int m_fd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QTimer *m_reconnectTimer = nullptr;
+    QString m_path;
+    bool m_subscribed = false;
+    bool m_backendDebug = true;
+
+    std::vector<quint8> m_frame; //one frame at most, allocated by the constructor
+    QVL53L0XReading m_reading;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XSOCKETBACKEND_H
@@ -0,0 +1,367 @@
+#include "qvl53l0xtuning.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+// DefaultTuningSettings from vl53l0x_tuning.h, in its layout
+static const quint8 defaultSettings[] =
+{
+    0x01, 0xFF, 0x01,
+    0x01, 0x00, 0x00,
+    0x01, 0xFF, 0x00,
+    0x01, 0x09, 0x00,
+    0x01, 0x10, 0x00,
+    0x01, 0x11, 0x00,
+    0x01, 0x24, 0x01,
+    0x01, 0x25, 0xFF,
+    0x01, 0x75, 0x00,
+    0x01, 0xFF, 0x01,
+    0x01, 0x4E, 0x2C,
+    0x01, 0x48, 0x00,
+    0x01, 0x30, 0x20,
+    0x01, 0xFF, 0x00,
+    0x01, 0x30, 0x09,
+    0x01, 0x54, 0x00,
+    0x01, 0x31, 0x04,
+    0x01, 0x32, 0x03,
+    0x01, 0x40, 0x83,
+    0x01, 0x46, 0x25,
+    0x01, 0x60, 0x00,
+    0x01, 0x27, 0x00,
+    0x01, 0x50, 0x06,
+    0x01, 0x51, 0x00,
+    0x01, 0x52, 0x96,
+    0x01, 0x56, 0x08,
+    0x01, 0x57, 0x30,
+    0x01, 0x61, 0x00,
+    0x01, 0x62, 0x00,
+    0x01, 0x64, 0x00,
+    0x01, 0x65, 0x00,
+    0x01, 0x66, 0xA0,
+    0x01, 0xFF, 0x01,
+    0x01, 0x22, 0x32,
+    0x01, 0x47, 0x14,
+    0x01, 0x49, 0xFF,
+    0x01, 0x4A, 0x00,
+    0x01, 0xFF, 0x00,
+    0x01, 0x7A, 0x0A,
+    0x01, 0x7B, 0x00,
+    0x01, 0x78, 0x21,
+    0x01, 0xFF, 0x01,
+    0x01, 0x23, 0x34,
+    0x01, 0x42, 0x00,
+    0x01, 0x44, 0xFF,
+    0x01, 0x45, 0x26,
+    0x01, 0x46, 0x05,
+    0x01, 0x40, 0x40,
+    0x01, 0x0E, 0x06,
+    0x01, 0x20, 0x1A,
+    0x01, 0x43, 0x40,
+    0x01, 0xFF, 0x00,
+    0x01, 0x34, 0x03,
+    0x01, 0x35, 0x44,
+    0x01, 0xFF, 0x01,
+    0x01, 0x31, 0x04,
+    0x01, 0x4B, 0x09,
+    0x01, 0x4C, 0x05,
+    0x01, 0x4D, 0x04,
+    0x01, 0xFF, 0x00,
+    0x01, 0x44, 0x00,
+    0x01, 0x45, 0x20,
+    0x01, 0x47, 0x08,
+    0x01, 0x48, 0x28,
+    0x01, 0x67, 0x00,
+    0x01, 0x70, 0x04,
+    0x01, 0x71, 0x01,
+    0x01, 0x72, 0xFE,
+    0x01, 0x76, 0x00,
+    0x01, 0x77, 0x00,
+    0x01, 0xFF, 0x01,
+    0x01, 0x0D, 0x01,
+    0x01, 0xFF, 0x00,
+    0x01, 0x80, 0x01,
+    0x01, 0x01, 0xF8,
+    0x01, 0xFF, 0x01,
+    0x01, 0x8E, 0x01,
+    0x01, 0x00, 0x01,
+    0x01, 0xFF, 0x00,
+    0x01, 0x80, 0x00,
+    0x00, 0x00
+};
+
+QVL53L0XTuning::QVL53L0XTuning()
+{
+    m_registers.fill(-1);
+    m_privileged.fill(false);
+}
+
+QString QVL53L0XTuning::name() const
+{
+    return m_name;
+}
+
+// an empty image writes nothing, e.g. the difference of two equal profiles
+bool QVL53L0XTuning::isEmpty() const
+{
+    return m_blocks.empty();
+}
+
+const std::vector<QVL53L0XTuning::Block> &QVL53L0XTuning::blocks() const
+{
+    return m_blocks;
+}
+
+// the register byte followed by the data, ready to be sent as a message
+quint8 *QVL53L0XTuning::data(const Block &block)
+{
+    return m_data.data() + block.offset;
+}
+
+// Writes the registers that end up with another value than in from. The
+// privileged registers are only written by the unlock sequences of the
+// profiles, if one of them differs the whole image is returned instead.
+// Registers that only from writes keep their value
+QVL53L0XTuning QVL53L0XTuning::difference(const QVL53L0XTuning &from) const
+{
+    if(from.isEmpty())
+        return *this;
+
+    for(size_t i = 0; i < m_registers.size(); i++)
+    {
+        bool sequenced = m_privileged[i] || from.m_privileged[i] || isControlRegister(i % 256);
+
+        if(sequenced && m_registers[i] != from.m_registers[i])
+            return *this;
+    }
+
+    QVL53L0XTuning image;
+    image.m_name = m_name;
+
+    // register order, so the writes of a page end up next to each other
+    for(size_t i = 0; i < m_registers.size(); i++)
+    {
+        if(m_registers[i] < 0 || m_registers[i] == from.m_registers[i])
+            continue;
+
+        image.append(0xFF, static_cast<quint8>(i / 256));
+        image.append(static_cast<quint8>(i % 256), static_cast<quint8>(m_registers[i]));
+    }
+
+    image.append(0xFF, 0x00);
+
+    image.m_registers = m_registers;
+    image.m_privileged = m_privileged;
+
+    return image;
+}
+
+QVL53L0XTuning QVL53L0XTuning::defaultTuning()
+{
+    static const QVL53L0XTuning tuning = compile("default", QByteArray(reinterpret_cast<const char*>(defaultSettings), sizeof(defaultSettings)));
+    return tuning;
+}
+
+// Validates the settings and compiles them. Entries with a count of 0xFF set
+// API parameters instead of registers and are rejected, as are pages other
+// than 0 and 1 and settings that leave page 1 selected or 0x80 set
+QVL53L0XTuning QVL53L0XTuning::compile(const QString &name, const QByteArray &settings, QString *error)
+{
+    QVL53L0XTuning tuning;
+    tuning.m_name = name;
+
+    auto fail = [&](const QString &message, qsizetype index)
+    {
+        if(error)
+            *error = QString("TUNING %1: %2 AT BYTE %3").arg(name, message).arg(index);
+
+        return QVL53L0XTuning();
+    };
+
+    qsizetype index = 0;
+
+    forever
+    {
+        if(index >= settings.size())
+            return fail("MISSING END", index);
+
+        quint8 count = static_cast<quint8>(settings[index]);
+
+        if(count == 0)
+            break;
+
+        if(count == 0xFF)
+            return fail("API PARAMETERS ARE NOT SUPPORTED", index);
+
+        if(index + 2 + count > settings.size())
+            return fail("TRUNCATED ENTRY", index);
+
+        quint8 reg = static_cast<quint8>(settings[index + 1]);
+
+        if(reg + count > 0x100)
+            return fail("ENTRY PAST REGISTER 0xFF", index);
+
+        for(quint8 i = 0; i < count; i++)
+        {
+            quint8 value = static_cast<quint8>(settings[index + 2 + i]);
+
+            if(reg + i == 0xFF && value > 0x01)
+                return fail(QString("INVALID PAGE %1").arg(value), index);
+
+            tuning.append(static_cast<quint8>(reg + i), value);
+        }
+
+        index += 2 + count;
+    }
+
+    if(tuning.m_page != 0 || tuning.m_unlocked)
+        return fail("DOES NOT END ON PAGE 0 WITH 0x80 CLEARED", index);
+
+    return tuning;
+}
+
+// Reads the profiles of a tuning file:
+//
+// { "version": 1, "profiles": [ { "name": "cover glass", "settings": "0x01, 0xFF, 0x01, ..." } ] }
+//
+// Invalid profiles are left out and reported in errors
+QList<QVL53L0XTuning> QVL53L0XTuning::load(const QString &file, QStringList *errors)
+{
+    QList<QVL53L0XTuning> profiles;
+    QFile input(file);
+
+    auto fail = [&](const QString &message)
+    {
+        if(errors)
+            errors->append(message);
+    };
+
+    if(!input.open(QIODevice::ReadOnly))
+    {
+        fail(QString("COULD NOT OPEN TUNING FILE %1").arg(file));
+        return profiles;
+    }
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(input.readAll(), &error);
+
+    if(error.error != QJsonParseError::NoError || !document.isObject())
+    {
+        fail(QString("COULD NOT READ TUNING FILE %1 (%2)").arg(file, error.errorString()));
+        return profiles;
+    }
+
+    QJsonObject root = document.object();
+
+    if(root.value("version").toInt() != static_cast<int>(fileVersion))
+    {
+        fail(QString("TUNING FILE %1 HAS AN UNKNOWN VERSION").arg(file));
+        return profiles;
+    }
+
+    for(const QJsonValue &value : root.value("profiles").toArray())
+    {
+        QJsonObject object = value.toObject();
+        QString name = object.value("name").toString();
+        bool ok = false;
+        QByteArray settings = parseSettings(object.value("settings").toString(), &ok);
+
+        if(name.isEmpty() || !ok)
+        {
+            fail(QString("TUNING %1: INVALID SETTINGS").arg(name));
+            continue;
+        }
+
+        QString message;
+        QVL53L0XTuning tuning = compile(name, settings, &message);
+
+        if(tuning.isEmpty())
+        {
+            fail(message);
+            continue;
+        }
+
+        profiles.append(tuning);
+    }
+
+    return profiles;
+}
+
+// bytes separated by commas or white space, with or without 0x, so the
+// arrays of ST's tuning headers can be pasted as they are
+QByteArray QVL53L0XTuning::parseSettings(const QString &settings, bool *ok)
+{
+    QByteArray bytes;
+    QString text = settings;
+
+    if(ok)
+        *ok = false;
+
+    for(const QString &token : text.replace(',', ' ').simplified().split(' ', Qt::SkipEmptyParts))
+    {
+        bool valid = false;
+        uint value = (token.startsWith("0x", Qt::CaseInsensitive) ? token.mid(2) : token).toUInt(&valid, 16);
+
+        if(!valid || value > 0xFF)
+            return QByteArray();
+
+        bytes.append(static_cast<char>(value));
+    }
+
+    if(ok)
+        *ok = true;
+
+    return bytes;
+}
+
+// Adds one write at the end of the image, merged into the last block when it
+// writes the next register of the same page
+void QVL53L0XTuning::append(quint8 reg, quint8 value)
+{
+    // the page is already selected
+    if(reg == 0xFF && value == m_page)
+        return;
+
+    if(reg == 0xFF)
+        m_page = value;
+    else
+    {
+        m_registers[m_page * 256 + reg] = value;
+        m_privileged[m_page * 256 + reg] = m_unlocked;
+    }
+
+    if(reg == 0x80)
+        m_unlocked = value != 0;
+
+    if(m_mergeable && !isControlRegister(reg))
+    {
+        Block &last = m_blocks.back();
+
+        if(m_data[last.offset] + last.length - 1 == reg)
+        {
+            m_data.push_back(value);
+            last.length++;
+
+            m_mergeable = last.length - 1 < maximumBlockLength;
+            return;
+        }
+    }
+
+    Block block;
+    block.offset = static_cast<quint32>(m_data.size());
+    block.length = 2;
+
+    m_data.push_back(reg);
+    m_data.push_back(value);
+    m_blocks.push_back(block);
+
+    m_mergeable = !isControlRegister(reg);
+}
+
+// page select, the privileged mode switch and SYSRANGE_START, always written
+// on their own
+bool QVL53L0XTuning::isControlRegister(quint8 reg)
+{
+    return reg == 0xFF || reg == 0x80 || reg == 0x00;
+}
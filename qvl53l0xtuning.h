@@ -0,0 +1,79 @@
+#ifndef QVL53L_XTUNING_H
+#define QVL53L_XTUNING_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+
+#include <array>
+#include <vector>
+
+#include "qvl53l0x_global.h"
+
+QT_BEGIN_NAMESPACE
+
+// A tuning profile compiled into the register image the backend writes.
+//
+// Profiles are given in the layout of ST's DefaultTuningSettings: entries of
+// a write count, a register and count data bytes, ended by a count of 0. The
+// entries are validated and compiled once. Writes to consecutive registers of
+// a page are merged into one block, page selects (0xFF) that select the page
+// already selected are dropped. The order of the writes is kept, the tunings
+// unlock registers with ordered sequences.
+//
+// Every block is stored with its register in front of its data, so a block
+// is an i2c message as it is and the backend sends a whole image in a few
+// I2C_RDWR transfers.
+//
+// The image also records the value each register ends up with. difference()
+// uses it to write only the registers that differ from another profile
+class QVL53L_X_EXPORT QVL53L0XTuning
+{
+public:
+    static inline const quint32 fileVersion = 1;
+    static inline const int maximumBlockLength = 32; //data bytes of a merged write
+
+    struct Block
+    {
+        quint32 offset = 0; //of the register byte in the image data
+        quint16 length = 0; //register byte included
+    };
+
+    QVL53L0XTuning();
+
+    QString name() const;
+    bool isEmpty() const;
+
+    const std::vector<Block> &blocks() const;
+    quint8 *data(const Block &block);
+
+    QVL53L0XTuning difference(const QVL53L0XTuning &from) const;
+
+    static QVL53L0XTuning defaultTuning();
+    static QVL53L0XTuning compile(const QString &name, const QByteArray &settings, QString *error = nullptr);
+    static QList<QVL53L0XTuning> load(const QString &file, QStringList *errors = nullptr);
+    static QByteArray parseSettings(const QString &settings, bool *ok = nullptr);
+
+protected:
+    void append(quint8 reg, quint8 value);
+
+    static bool isControlRegister(quint8 reg);
+
+private:
+    QString m_name;
+    std::vector<Block> m_blocks;
+    std::vector<quint8> m_data;
+    quint8 m_page = 0; //selected at the end of the image
+    bool m_unlocked = false; //0x80 set at the end of the image
+    bool m_mergeable = false; //the last block can take the next register
+
+    // value of every register at the end of the image, -1 if not written.
+    // Privileged registers are written while 0x80 is set
+    std::array<qint16, 512> m_registers;
+    std::array<bool, 512> m_privileged;
+};
+
+QT_END_NAMESPACE
+
+#endif // QVL53L_XTUNING_H
@@ -0,0 +1,294 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QSensorManager>
+#include <QSensorBackendFactory>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QDebug>
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "unistd.h"
+
+#include "qvl53l0x.h"
+#include "qvl53l0xbackend.h"
+#include "qvl53l0xmetrics.h"
+#include "qvl53l0xsimulator.h"
+
+// Runs sensors on simulated buses for a long time while injecting faults, and
+// fails when the process keeps growing, a sensor takes too long to recover
+// from a fault or the sensors fall behind their data rate.
+//
+// qvl53l0xsoak [--duration s] [--sensors n] [--rate hz] [--seed n]
+//              [--fault-interval s] [--max-rss-growth kib] [--max-recovery ms]
+//              [--min-throughput ratio]
+//
+// Every sensor has its own bus, so its own bus thread. Nack, RemoteIO and
+// SlowResponse faults hit random transfers all the time, on top of that a
+// burst of one kind of fault is injected into every sensor each fault
+// interval, cycling through all four. The recovery time of a burst is the
+// time from the injection to the first valid reading once the simulator has
+// served the whole burst.
+//
+// The resident set size is sampled every second, growth is measured against
+// the size at the end of the warm up.
+
+// the plugin is not loaded by the soak test, the hardware backend is
+// registered directly
+class BackendFactory : public QSensorBackendFactory
+{
+public:
+    QSensorBackend *createBackend(QSensor *sensor) override
+    {
+        if (sensor->identifier() == QVL53L0XBackend::id)
+            return new QVL53L0XBackend(sensor);
+
+        return 0;
+    }
+};
+
+struct Soak
+{
+    std::unique_ptr<QVL53L0XSimulator> simulator;
+    QVL53L0X *sensor = nullptr;
+
+    quint64 readings = 0; //after the warm up
+    quint64 burstFaults = 0; //simulator faults() once the pending burst has been served
+    qint64 burstStart = -1; //ms on the soak clock, -1 without a pending burst
+    qint64 maxRecovery = 0; //ms
+    int bursts = 0;
+};
+
+static qint64 residentSetSize()
+{
+    //size and resident pages
+    long pages[2] = {};
+    FILE *statm = fopen("/proc/self/statm", "r");
+
+    if(!statm)
+        return -1;
+
+    bool ok = fscanf(statm, "%ld %ld", &pages[0], &pages[1]) == 2;
+    fclose(statm);
+
+    return ok ? static_cast<qint64>(pages[1]) * sysconf(_SC_PAGESIZE) : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qvl53l0xsoak");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Soak test of the VL53L0X backend on simulated buses");
+    parser.addHelpOption();
+
+    QCommandLineOption durationOption("duration", "Length of the run after the warm up, in seconds.", "s", "3600");
+    QCommandLineOption sensorsOption("sensors", "Number of simulated sensors, each on its own bus.", "n", "4");
+    QCommandLineOption rateOption("rate", "Data rate of the sensors, in Hz.", "hz", "30");
+    QCommandLineOption seedOption("seed", "Seed of the random faults.", "n", "1");
+    QCommandLineOption faultIntervalOption("fault-interval", "Time between two fault bursts, in seconds.", "s", "20");
+    QCommandLineOption rssOption("max-rss-growth", "Allowed growth of the resident set size, in KiB.", "kib", "4096");
+    QCommandLineOption recoveryOption("max-recovery", "Allowed recovery time from a fault burst, in ms.", "ms", "8000");
+    QCommandLineOption throughputOption("min-throughput", "Readings required per sensor, as a ratio of the data rate.", "ratio", "0.8");
+
+    parser.addOption(durationOption);
+    parser.addOption(sensorsOption);
+    parser.addOption(rateOption);
+    parser.addOption(seedOption);
+    parser.addOption(faultIntervalOption);
+    parser.addOption(rssOption);
+    parser.addOption(recoveryOption);
+    parser.addOption(throughputOption);
+    parser.process(app);
+
+    const int warmUp = 10000; //ms
+    qint64 duration = parser.value(durationOption).toLongLong() * 1000;
+    int count = parser.value(sensorsOption).toInt();
+    int rate = parser.value(rateOption).toInt();
+    quint32 seed = parser.value(seedOption).toUInt();
+    int faultInterval = parser.value(faultIntervalOption).toInt() * 1000;
+    qint64 maxRssGrowth = parser.value(rssOption).toLongLong() * 1024;
+    qint64 maxRecovery = parser.value(recoveryOption).toLongLong();
+    qreal minThroughput = parser.value(throughputOption).toDouble();
+
+    if(duration <= 0 || count <= 0 || rate <= 0 || faultInterval <= 0)
+    {
+        qCritical() << "invalid duration, sensors, rate or fault interval";
+        return 1;
+    }
+
+    BackendFactory factory;
+
+    if(!QSensorManager::isBackendRegistered(QVL53L0X::sensorType, QVL53L0XBackend::id))
+        QSensorManager::registerBackend(QVL53L0X::sensorType, QVL53L0XBackend::id, &factory);
+
+    // the simulators outlive the sensors, which are deleted at the end
+    std::vector<Soak> soaks(count);
+    QElapsedTimer clock;
+    clock.start();
+
+    for(int i = 0; i < count; i++)
+    {
+        Soak &soak = soaks[i];
+        soak.simulator = std::make_unique<QVL53L0XSimulator>(QString("%1%2").arg(QVL53L0XSimulator::busPrefix).arg(i));
+        soak.simulator->setSeed(seed + i);
+        soak.simulator->setMeasurementTime(2000);
+        soak.simulator->setFaultRate(QVL53L0XSimulator::Nack, 0.0001);
+        soak.simulator->setFaultRate(QVL53L0XSimulator::RemoteIO, 0.0001);
+        soak.simulator->setFaultRate(QVL53L0XSimulator::SlowResponse, 0.001);
+
+        soak.sensor = new QVL53L0X;
+        soak.sensor->setIdentifier(QVL53L0XBackend::id);
+        soak.sensor->setBus(soak.simulator->bus());
+        soak.sensor->setAddress(soak.simulator->address());
+
+        if(!soak.sensor->connectToBackend())
+        {
+            qCritical() << "could not connect to the backend";
+            return 1;
+        }
+
+        soak.sensor->setDataRate(rate);
+
+        QObject::connect(soak.sensor, &QSensor::readingChanged, [&soak, &clock, warmUp]()
+        {
+            qint64 now = clock.elapsed();
+
+            if(now >= warmUp)
+                soak.readings++;
+
+            if(soak.burstStart < 0 || soak.sensor->reading()->rangeStatus() != QVL53L0XReading::RangeValid)
+                return;
+
+            // still serving the burst, the reading was taken before it
+            if(soak.simulator->faults() < soak.burstFaults)
+                return;
+
+            soak.maxRecovery = qMax(soak.maxRecovery, now - soak.burstStart);
+            soak.burstStart = -1;
+        });
+
+        soak.sensor->start();
+    }
+
+    // a burst of each fault in turn, sized to exhaust the backend's retries
+    struct Burst
+    {
+        QVL53L0XSimulator::Fault fault;
+        int transfers;
+        const char *name;
+    };
+
+    static const Burst bursts[] =
+    {
+        { QVL53L0XSimulator::Nack, 8, "nack" },
+        { QVL53L0XSimulator::RemoteIO, 8, "remote io" },
+        { QVL53L0XSimulator::StuckInterrupt, 30, "stuck interrupt" },
+        { QVL53L0XSimulator::SlowResponse, 20, "slow response" }
+    };
+
+    int burst = 0;
+    bool failed = false;
+
+    QTimer faultTimer;
+    QObject::connect(&faultTimer, &QTimer::timeout, [&]()
+    {
+        const Burst &next = bursts[burst++ % (sizeof(bursts) / sizeof(bursts[0]))];
+
+        for(Soak &soak : soaks)
+        {
+            // the previous burst never ended in a valid reading
+            if(soak.burstStart >= 0)
+            {
+                qCritical() << soak.simulator->bus() << "did not recover within" << faultInterval << "ms";
+                failed = true;
+                app.exit(1);
+                return;
+            }
+
+            soak.burstFaults = soak.simulator->faults() + next.transfers;
+            soak.burstStart = clock.elapsed();
+            soak.bursts++;
+            soak.simulator->injectFault(next.fault, next.transfers);
+        }
+
+        qInfo() << "injected" << next.name << "burst" << burst;
+    });
+
+    qint64 baseline = -1;
+    qint64 maxRss = 0;
+
+    QTimer rssTimer;
+    QObject::connect(&rssTimer, &QTimer::timeout, [&]()
+    {
+        qint64 rss = residentSetSize();
+
+        if(clock.elapsed() < warmUp)
+            return;
+
+        if(baseline < 0)
+        {
+            baseline = rss;
+            faultTimer.start(faultInterval);
+            qInfo() << "warmed up, resident set size" << baseline / 1024 << "KiB";
+        }
+
+        maxRss = qMax(maxRss, rss);
+
+        if(clock.elapsed() >= warmUp + duration)
+            app.quit();
+    });
+
+    rssTimer.start(1000);
+
+    int result = app.exec();
+    qreal seconds = (clock.elapsed() - warmUp) / 1000.0;
+
+    if(result != 0 || failed)
+        result = 1;
+
+    if(baseline < 0 || maxRss - baseline > maxRssGrowth)
+    {
+        qCritical() << "resident set size grew by" << (maxRss - baseline) / 1024 << "KiB, allowed" << maxRssGrowth / 1024 << "KiB";
+        result = 1;
+    }
+
+    for(const Soak &soak : soaks)
+    {
+        const QVL53L0XMetrics *metrics = soak.sensor->metrics();
+        QVL53L0XMetrics::Snapshot snapshot = metrics ? metrics->snapshot() : QVL53L0XMetrics::Snapshot();
+        qreal throughput = seconds > 0 ? soak.readings / seconds : 0;
+
+        qInfo() << soak.simulator->bus()
+                << "readings" << soak.readings
+                << "rate" << throughput << "Hz"
+                << "transfers" << soak.simulator->transfers()
+                << "faults" << soak.simulator->faults()
+                << "bursts" << soak.bursts
+                << "restarts" << snapshot.restarts
+                << "max recovery" << soak.maxRecovery << "ms";
+
+        if(soak.maxRecovery > maxRecovery)
+        {
+            qCritical() << soak.simulator->bus() << "took" << soak.maxRecovery << "ms to recover, allowed" << maxRecovery << "ms";
+            result = 1;
+        }
+
+        if(throughput < minThroughput * soak.sensor->dataRate())
+        {
+            qCritical() << soak.simulator->bus() << "delivered" << throughput << "Hz, required" << minThroughput * soak.sensor->dataRate() << "Hz";
+            result = 1;
+        }
+    }
+
+    // the sensors stop their bus threads before the simulators go away
+    for(Soak &soak : soaks)
+        delete soak.sensor;
+
+    qInfo() << (result == 0 ? "passed" : "failed");
+
+    return result;
+}